@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Times reading of a panel config file with config_read_file_checked().
+ * The file is generated with given number of plugins (10000 by default),
+ * each of them with the settings a real plugin of that type has. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "conf.h"
+
+#define N_PLUGINS 10000
+
+/* minimal time to spend reading, microseconds */
+#define BENCH_TIME 1000000
+
+static const char global[] =
+    "# lxpanel <profile> config file. Manually editing is not recommended.\n"
+    "# Use preference dialog in lxpanel to adjust config when you can.\n"
+    "\n"
+    "Global {\n"
+    "  edge=bottom\n"
+    "  align=left\n"
+    "  margin=0\n"
+    "  widthtype=percent\n"
+    "  width=100\n"
+    "  height=26\n"
+    "  transparent=0\n"
+    "  tintcolor=#000000\n"
+    "  alpha=0\n"
+    "  setdocktype=1\n"
+    "  setpartialstrut=1\n"
+    "  usefontcolor=1\n"
+    "  fontcolor=#ffffff\n"
+    "  background=1\n"
+    "  backgroundfile=/usr/share/lxpanel/images/background.png\n"
+    "}\n";
+
+static const char *plugins[] = {
+    "Plugin {\n"
+    "  type=space\n"
+    "  Config {\n"
+    "    Size=2\n"
+    "  }\n"
+    "}\n",
+
+    "Plugin {\n"
+    "  type=menu\n"
+    "  Config {\n"
+    "    image=/usr/share/lxpanel/images/my-computer.png\n"
+    "    system {\n"
+    "    }\n"
+    "    separator {\n"
+    "    }\n"
+    "    item {\n"
+    "      command=run\n"
+    "    }\n"
+    "    separator {\n"
+    "    }\n"
+    "    item {\n"
+    "      image=gnome-logout\n"
+    "      command=logout\n"
+    "    }\n"
+    "  }\n"
+    "}\n",
+
+    "Plugin {\n"
+    "  type=launchbar\n"
+    "  Config {\n"
+    "    Button {\n"
+    "      id=pcmanfm.desktop\n"
+    "    }\n"
+    "    Button {\n"
+    "      id=lxterminal.desktop\n"
+    "    }\n"
+    "    Button {\n"
+    "      id=firefox.desktop\n"
+    "    }\n"
+    "  }\n"
+    "}\n",
+
+    "Plugin {\n"
+    "  type=taskbar\n"
+    "  expand=1\n"
+    "  Config {\n"
+    "    tooltips=1\n"
+    "    IconsOnly=0\n"
+    "    AcceptSkipPager=1\n"
+    "    ShowIconified=1\n"
+    "    ShowMapped=1\n"
+    "    ShowAllDesks=0\n"
+    "    UseMouseWheel=1\n"
+    "    UseUrgencyHint=1\n"
+    "    FlatButton=0\n"
+    "    MaxTaskWidth=150\n"
+    "    spacing=1\n"
+    "  }\n"
+    "}\n",
+
+    "Plugin {\n"
+    "  type=dclock\n"
+    "  Config {\n"
+    "    ClockFmt=\"%R\"\n"
+    "    TooltipFmt=\"%A %x\"\n"
+    "    BoldFont=0\n"
+    "    IconOnly=0\n"
+    "    CenterText=0\n"
+    "  }\n"
+    "}\n"
+};
+
+static gchar *generate_config(guint n_plugins, gsize *size)
+{
+    GString *str = g_string_new(global);
+    guint i;
+
+    for (i = 0; i < n_plugins; i++)
+    {
+        g_string_append_c(str, '\n');
+        g_string_append(str, plugins[i % G_N_ELEMENTS(plugins)]);
+    }
+    *size = str->len;
+    return g_string_free(str, FALSE);
+}
+
+/* Returns number of plugins found or -1 on error */
+static int read_config(const char *filename)
+{
+    PanelConf *config = config_new();
+    PanelConfError error;
+    config_setting_t *list;
+    int n = -1;
+
+    if (config_read_file_checked(config, filename, &error))
+    {
+        list = config_setting_get_member(config_root_setting(config), "");
+        n = 0;
+        while (config_setting_get_elem(list, n) != NULL)
+            n++;
+        n--; /* Global */
+    }
+    else
+        fprintf(stderr, "%s:%u:%u: %s\n", filename, error.line, error.column,
+                error.message);
+    config_destroy(config);
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    GError *err = NULL;
+    gchar *filename, *data;
+    gsize size;
+    guint n_plugins = N_PLUGINS;
+    gulong n, rounds = 1;
+    gint64 start, elapsed;
+    int fd, found;
+
+    if (argc > 1)
+        n_plugins = atoi(argv[1]);
+    data = generate_config(n_plugins, &size);
+    fd = g_file_open_tmp("lxpanel-bench-XXXXXX", &filename, &err);
+    if (fd < 0)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        return 1;
+    }
+    close(fd);
+    if (!g_file_set_contents(filename, data, size, &err))
+    {
+        fprintf(stderr, "%s\n", err->message);
+        g_unlink(filename);
+        return 1;
+    }
+    g_free(data);
+
+    found = read_config(filename);
+    if (found != (int)n_plugins)
+    {
+        fprintf(stderr, "expected %u plugins, read %d\n", n_plugins, found);
+        g_unlink(filename);
+        return 1;
+    }
+    for (;;)
+    {
+        start = g_get_monotonic_time();
+        for (n = 0; n < rounds; n++)
+            read_config(filename);
+        elapsed = g_get_monotonic_time() - start;
+        if (elapsed >= BENCH_TIME)
+            break;
+        rounds *= 2;
+    }
+    g_unlink(filename);
+    g_free(filename);
+
+    printf("%u plugins, %" G_GSIZE_FORMAT " bytes: %.3f ms per read, %.1f MB/s\n",
+           n_plugins, size, (double)elapsed / 1000.0 / rounds,
+           (double)size * rounds / elapsed);
+    return 0;
+}
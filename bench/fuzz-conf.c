@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Fuzz target for the config file parser. The parser works on a private
+ * mapping of the file, so each input is written into a temporary file and
+ * read back both with and without stopping on the first error, then the
+ * result is converted to text again.
+ *
+ * Built with libFuzzer (-fsanitize=fuzzer and
+ * -DFUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) it is a usual fuzz target,
+ * otherwise it runs the inputs given on command line once, to reproduce
+ * a crash or to check a corpus. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "conf.h"
+
+int LLVMFuzzerTestOneInput(const guint8 *data, size_t size);
+
+static gchar *input_file = NULL;
+static int input_fd = -1;
+
+static void fuzz_log_handler(const gchar *domain, GLogLevelFlags level,
+                             const gchar *message, gpointer user_data)
+{
+    /* the parser warns about every error it skips, it is not a failure */
+    if (!(level & G_LOG_LEVEL_WARNING))
+        g_log_default_handler(domain, level, message, user_data);
+}
+
+static void fuzz_cleanup(void)
+{
+    if (input_fd >= 0)
+        close(input_fd);
+    if (input_file)
+        g_unlink(input_file);
+    g_free(input_file);
+}
+
+static gboolean fuzz_init(void)
+{
+    GError *err = NULL;
+
+    input_fd = g_file_open_tmp("lxpanel-fuzz-XXXXXX", &input_file, &err);
+    if (input_fd < 0)
+    {
+        fprintf(stderr, "%s\n", err->message);
+        g_error_free(err);
+        return FALSE;
+    }
+    atexit(fuzz_cleanup);
+    g_log_set_default_handler(fuzz_log_handler, NULL);
+    return TRUE;
+}
+
+static void fuzz_read(gboolean checked)
+{
+    PanelConf *config = config_new();
+    PanelConfError error;
+    config_setting_t *list;
+    gboolean ok;
+    char *str;
+
+    if (checked)
+        ok = config_read_file_checked(config, input_file, &error);
+    else
+        ok = config_read_file(config, input_file);
+    /* root has no name, write its contents as config_write_file() does */
+    list = config_setting_get_member(config_root_setting(config), "");
+    if (ok && list != NULL)
+    {
+        str = config_setting_to_string(list);
+        g_free(str);
+    }
+    config_destroy(config);
+}
+
+int LLVMFuzzerTestOneInput(const guint8 *data, size_t size)
+{
+    size_t done;
+    ssize_t len;
+
+    if (input_file == NULL && !fuzz_init())
+        abort();
+    if (ftruncate(input_fd, 0) < 0)
+        abort();
+    for (done = 0; done < size; done += len)
+    {
+        len = pwrite(input_fd, data + done, size - done, done);
+        if (len < 0)
+            abort();
+    }
+    fuzz_read(TRUE);
+    fuzz_read(FALSE);
+    return 0;
+}
+
+#ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+int main(int argc, char **argv)
+{
+    GError *err = NULL;
+    gchar *data;
+    gsize size;
+    int i;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+        return 2;
+    }
+    for (i = 1; i < argc; i++)
+    {
+        if (!g_file_get_contents(argv[i], &data, &size, &err))
+        {
+            fprintf(stderr, "%s\n", err->message);
+            g_clear_error(&err);
+            return 1;
+        }
+        LLVMFuzzerTestOneInput((const guint8 *)data, size);
+        g_free(data);
+    }
+    return 0;
+}
+#endif
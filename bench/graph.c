@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Times a frame of the graph widget used by CPU and monitors plugins (draw
+ * the new sample and expose the widget) against the code of 0.9.2 which
+ * cleared the surface and stroked every column on each sample. Both are
+ * drawn into offscreen windows, so an X display is needed (Xvfb will do). */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "graph.h"
+
+#define BORDER_SIZE 2
+
+/* minimal time to spend on each variant, microseconds */
+#define BENCH_TIME 500000
+
+static const struct {
+    gint width, height;
+} sizes[] = {
+    { 40, 24 },     /* default panel */
+    { 120, 48 },    /* large panel */
+    { 400, 96 }     /* wide graph on a 4K screen */
+};
+
+static GdkColor foreground = { 0, 0, 0xffff, 0 };
+
+/* --- graph as it was in cpu.c of 0.9.2 --- */
+
+typedef struct {
+    GtkWidget *da;
+    cairo_surface_t *pixmap;
+    guint pixmap_width, pixmap_height;
+    gfloat *stats;
+    guint ring_cursor;
+} OldGraph;
+
+static void old_redraw_pixmap(OldGraph *c)
+{
+    cairo_t *cr = cairo_create(c->pixmap);
+    GtkStyle *style = gtk_widget_get_style(c->da);
+    unsigned int i;
+    unsigned int drawing_cursor = c->ring_cursor;
+
+    cairo_set_line_width(cr, 1.0);
+    /* Erase pixmap. */
+    cairo_rectangle(cr, 0, 0, c->pixmap_width, c->pixmap_height);
+    gdk_cairo_set_source_color(cr, &style->black);
+    cairo_fill(cr);
+
+    /* Recompute pixmap. */
+    gdk_cairo_set_source_color(cr, &foreground);
+    for (i = 0; i < c->pixmap_width; i++)
+    {
+        if (c->stats[drawing_cursor] != 0.0)
+        {
+            cairo_move_to(cr, i + 0.5, c->pixmap_height);
+            cairo_line_to(cr, i + 0.5, c->pixmap_height - c->stats[drawing_cursor] * c->pixmap_height);
+            cairo_stroke(cr);
+        }
+        drawing_cursor += 1;
+        if (drawing_cursor >= c->pixmap_width)
+            drawing_cursor = 0;
+    }
+    cairo_destroy(cr);
+    gtk_widget_queue_draw(c->da);
+}
+
+static void old_size_allocate(GtkWidget *widget, GtkAllocation *allocation, OldGraph *c)
+{
+    c->pixmap_width = MAX(allocation->width - BORDER_SIZE * 2, 0);
+    c->pixmap_height = MAX(allocation->height - BORDER_SIZE * 2, 0);
+    g_free(c->stats);
+    c->stats = g_new0(gfloat, c->pixmap_width);
+    c->ring_cursor = 0;
+    if (c->pixmap)
+        cairo_surface_destroy(c->pixmap);
+    c->pixmap = cairo_image_surface_create(CAIRO_FORMAT_RGB24, c->pixmap_width,
+                                           c->pixmap_height);
+    old_redraw_pixmap(c);
+}
+
+static void old_paint(OldGraph *c, cairo_t *cr)
+{
+    if (c->pixmap == NULL)
+        return;
+    cairo_set_source_surface(cr, c->pixmap, BORDER_SIZE, BORDER_SIZE);
+    cairo_paint(cr);
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean old_draw(GtkWidget *widget, cairo_t *cr, OldGraph *c)
+{
+    old_paint(c, cr);
+    return FALSE;
+}
+#else
+static gboolean old_expose_event(GtkWidget *widget, GdkEventExpose *event, OldGraph *c)
+{
+    cairo_t *cr = gdk_cairo_create(gtk_widget_get_window(widget));
+
+    gdk_cairo_region(cr, event->region);
+    cairo_clip(cr);
+    old_paint(c, cr);
+    cairo_destroy(cr);
+    return FALSE;
+}
+#endif
+
+static void old_add_sample(OldGraph *c, gfloat value)
+{
+    c->stats[c->ring_cursor] = value;
+    c->ring_cursor += 1;
+    if (c->ring_cursor >= c->pixmap_width)
+        c->ring_cursor = 0;
+    old_redraw_pixmap(c);
+}
+
+/* --- PanelGraph --- */
+
+/* The same as CPU plugin draws total usage */
+static void draw_total(cairo_t *cr, gint x, gint height, const gfloat *values,
+                       guint n_values, gpointer user_data)
+{
+    if (values[0] != 0.0)
+    {
+        gdk_cairo_set_source_color(cr, &foreground);
+        cairo_rectangle(cr, x, height - values[0] * height, 1, values[0] * height);
+        cairo_fill(cr);
+    }
+}
+
+static void new_add_sample(PanelGraph *graph, gfloat value)
+{
+    gfloat *sample = panel_graph_new_sample(graph);
+
+    sample[0] = value;
+    panel_graph_commit_sample(graph);
+}
+
+/* --- driver --- */
+
+static GtkWidget *bench_window(GtkWidget *child, gint width, gint height)
+{
+    GtkWidget *win = gtk_offscreen_window_new();
+
+    gtk_widget_set_size_request(child, width + BORDER_SIZE * 2,
+                                height + BORDER_SIZE * 2);
+    gtk_container_add(GTK_CONTAINER(win), child);
+    gtk_widget_show_all(win);
+    while (gtk_events_pending())
+        gtk_main_iteration();
+    return win;
+}
+
+/* Returns microseconds per frame: new sample then expose of the widget */
+static double bench_run(GtkWidget *widget, OldGraph *old)
+{
+    GdkWindow *window = gtk_widget_get_window(widget);
+    gint64 start, elapsed;
+    gulong n, frames = 16;
+
+    for (;;)
+    {
+        start = g_get_monotonic_time();
+        for (n = 0; n < frames; n++)
+        {
+            gfloat value = g_random_double();
+
+            if (old)
+                old_add_sample(old, value);
+            else
+                new_add_sample(PANEL_GRAPH(widget), value);
+            gdk_window_process_updates(window, TRUE);
+        }
+        elapsed = g_get_monotonic_time() - start;
+        if (elapsed >= BENCH_TIME)
+            break;
+        frames *= 2;
+    }
+    return (double)elapsed / frames;
+}
+
+int main(int argc, char **argv)
+{
+    guint s;
+
+    if (!gtk_init_check(&argc, &argv))
+    {
+        fprintf(stderr, "cannot open display, try xvfb-run\n");
+        return 77;
+    }
+    printf("%-10s %14s %14s %8s\n", "size", "0.9.2 us/frame", "graph us/frame", "ratio");
+    for (s = 0; s < G_N_ELEMENTS(sizes); s++)
+    {
+        OldGraph old = { 0 };
+        GtkWidget *graph, *win;
+        double t_old, t_new;
+
+        old.da = gtk_drawing_area_new();
+        g_signal_connect(old.da, "size-allocate", G_CALLBACK(old_size_allocate), &old);
+#if GTK_CHECK_VERSION(3, 0, 0)
+        g_signal_connect(old.da, "draw", G_CALLBACK(old_draw), &old);
+#else
+        g_signal_connect(old.da, "expose-event", G_CALLBACK(old_expose_event), &old);
+#endif
+        win = bench_window(old.da, sizes[s].width, sizes[s].height);
+        t_old = bench_run(old.da, &old);
+        gtk_widget_destroy(win);
+        cairo_surface_destroy(old.pixmap);
+        g_free(old.stats);
+
+        graph = panel_graph_new(1, BORDER_SIZE, draw_total, NULL);
+        win = bench_window(graph, sizes[s].width, sizes[s].height);
+        t_new = bench_run(graph, NULL);
+        gtk_widget_destroy(win);
+
+        printf("%4dx%-5d %14.2f %14.2f %8.2f\n", sizes[s].width, sizes[s].height,
+               t_old, t_new, t_old / t_new);
+    }
+    return 0;
+}
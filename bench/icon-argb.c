@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Times _NET_WM_ICON to RGBA conversion used by taskbar on long-padded
+ * data as X returns it, against the byte-wise loop used before 0.9.3. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "icon-argb.h"
+
+/* minimal time to spend on each variant, microseconds */
+#define BENCH_TIME 200000
+
+typedef void (*ConvertFunc)(const gulong *src, guint32 *dst, gulong len);
+
+/* The loop taskbar used in 0.9.2 */
+static void icon_argb_to_rgba_bytes(const gulong *src, guint32 *dst, gulong len)
+{
+    guchar *p = (guchar *)dst;
+    gulong i;
+
+    for (i = 0; i < len; p += 4, i += 1)
+    {
+        guint argb = src[i];
+        guint rgba = (argb << 8) | (argb >> 24);
+        p[0] = rgba >> 24;
+        p[1] = (rgba >> 16) & 0xff;
+        p[2] = (rgba >> 8) & 0xff;
+        p[3] = rgba & 0xff;
+    }
+}
+
+static const struct {
+    const char *name;
+    ConvertFunc func;
+} variants[] = {
+    { "bytes (0.9.2)", icon_argb_to_rgba_bytes },
+    { "scalar", icon_argb_to_rgba_scalar },
+#ifdef __SSE2__
+    { "sse2", icon_argb_to_rgba_sse2 },
+#endif
+};
+
+static const guint sizes[] = { 16, 48, 256 };
+
+/* Returns nanoseconds per pixel */
+static double bench_run(ConvertFunc func, const gulong *src, guint32 *dst, gulong len)
+{
+    gint64 start, elapsed;
+    gulong n, rounds = 1;
+
+    for (;;)
+    {
+        start = g_get_monotonic_time();
+        for (n = 0; n < rounds; n++)
+            func(src, dst, len);
+        elapsed = g_get_monotonic_time() - start;
+        if (elapsed >= BENCH_TIME)
+            break;
+        rounds *= 2;
+    }
+    return (double)elapsed * 1000.0 / rounds / len;
+}
+
+int main(int argc, char **argv)
+{
+    guint s, v;
+    gulong i;
+
+    printf("%-10s %-14s %10s %12s\n", "size", "kernel", "ns/pixel", "us/icon");
+    for (s = 0; s < G_N_ELEMENTS(sizes); s++)
+    {
+        gulong len = (gulong)sizes[s] * sizes[s];
+        gulong *src = g_new(gulong, len);
+        guint32 *ref = g_new(guint32, len);
+        guint32 *dst = g_new(guint32, len);
+
+        /* on 64-bit hosts the upper half of each long must be ignored */
+        for (i = 0; i < len; i++)
+            src[i] = (gulong)g_random_int() | ((gulong)0xdeadbeef << 16 << 16);
+        icon_argb_to_rgba_bytes(src, ref, len);
+        for (v = 0; v < G_N_ELEMENTS(variants); v++)
+        {
+            double ns;
+
+            memset(dst, 0, len * sizeof(guint32));
+            variants[v].func(src, dst, len);
+            if (memcmp(dst, ref, len * sizeof(guint32)) != 0)
+            {
+                fprintf(stderr, "%s: wrong result for %ux%u icon\n",
+                        variants[v].name, sizes[s], sizes[s]);
+                return 1;
+            }
+            ns = bench_run(variants[v].func, src, dst, len);
+            printf("%4ux%-5u %-14s %10.3f %12.3f\n", sizes[s], sizes[s],
+                   variants[v].name, ns, ns * len / 1000.0);
+        }
+        g_free(src);
+        g_free(ref);
+        g_free(dst);
+    }
+    return 0;
+}
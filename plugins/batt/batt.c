@@ -24,8 +24,9 @@
  *
  *
  * This plugin monitors battery usage on ACPI-enabled systems by reading the
- * battery information found in /sys/class/power_supply. The update interval is
- * user-configurable and defaults to 3 second.
+ * battery information found in /sys/class/power_supply. It is updated on
+ * each uevent from power supplies (AC plugged or unplugged, status changed)
+ * and polled slowly for charge level.
  *
  * The battery's remaining life is estimated from its current charge and current
  * rate of discharge. The user may configure an alarm command to be run when
@@ -34,25 +35,26 @@
 
 /* FIXME:
  *  Here are somethings need to be improvec:
- *  1. Replace pthread stuff with gthread counterparts for portability.
  *  4. Handle failure gracefully under systems other than Linux.
 */
 
 #include <glib.h>
 #include <glib/gi18n.h>
-#include <pthread.h> /* used by pthread_create() and alarmThread */
-#include <semaphore.h> /* used by update() and alarmProcess() for alarms */
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <sys/wait.h> /* for WIFEXITED() on alarm status */
 
 #include "dbg.h" /* for ENTER and RET macros */
 #include "batt_sys.h"
 #include "plugin.h" /* all other APIs including panel configuration */
+#include "ticker.h" /* periodic updates */
+#include "sysfs.h" /* power supply uevents */
 
-/* The last MAX_SAMPLES samples are averaged when charge rates are evaluated.
-   This helps prevent spikes in the "time left" values the user sees. */
-#define MAX_SAMPLES 10
+/* Poll intervals for charge level, in milliseconds. Uevents aren't sent
+   on each change of charge so it is polled anyway but not often. */
+#define POLL_INTERVAL           9000
+#define POLL_INTERVAL_UEVENTS   30000
 
 typedef struct {
     char *alarmCommand,
@@ -74,20 +76,22 @@ typedef struct {
         border,
         height,
         length,
-        numSamples,
         requestedBorder,
-        *rateSamples,
-        rateSamplesSum,
         thickness,
         timer,
+        uevent_watch,
+        uevent_idle,
         state_elapsed_time,
         info_elapsed_time,
         wasCharging,
         width,
         hide_if_no_battery;
-    int battery_number;
-    sem_t alarmProcessLock;
-    battery* b;
+    int battery_number;         /* -1 to monitor all batteries */
+    GPid alarm_pid;             /* alarm command which is running */
+    guint alarm_watch;
+    GList *batteries;           /* monitored batteries */
+    battery_total total;        /* all of them together */
+    gboolean batteries_changed; /* battery was added or removed */
     gboolean has_ac_adapter;
     gboolean show_extended_information;
     LXPanel *panel;
@@ -95,26 +99,43 @@ typedef struct {
 } lx_battery;
 
 
-typedef struct {
-    char *command;
-    sem_t *lock;
-} Alarm;
-
 static void destructor(gpointer data);
 static void update_display(lx_battery *lx_b, gboolean repaint);
 
-/* alarmProcess takes the address of a dynamically allocated alarm struct (which
-   it must free). It ensures that alarm commands do not run concurrently. */
-static void * alarmProcess(void *arg) {
-    Alarm *a = (Alarm *) arg;
+/* alarm_exited is called when alarm command is finished, only then another
+   alarm can be run, so alarm commands do not run concurrently. */
+static void alarm_exited(GPid pid, gint status, gpointer user_data)
+{
+    lx_battery *lx_b = user_data;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        g_warning("plugin batt: failed to execute alarm command \"%s\"", lx_b->alarmCommand);
+    g_spawn_close_pid(pid);
+    lx_b->alarm_pid = 0;
+    lx_b->alarm_watch = 0;
+}
+
+/* reaps alarm command which outlived the plugin */
+static void alarm_reap(GPid pid, gint status, gpointer unused)
+{
+    g_spawn_close_pid(pid);
+}
 
-    sem_wait(a->lock);
-    if (system(a->command) != 0)
-        g_warning("plugin batt: failed to execute alarm command \"%s\"", a->command);
-    sem_post(a->lock);
+static void run_alarm(lx_battery *lx_b)
+{
+    gchar *argv[] = { "/bin/sh", "-c", lx_b->alarmCommand, NULL };
+    GError *error = NULL;
 
-    g_free(a);
-    return NULL;
+    if (!g_spawn_async(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                       &lx_b->alarm_pid, &error))
+    {
+        g_warning("plugin batt: failed to execute alarm command \"%s\": %s",
+                  lx_b->alarmCommand, error->message);
+        g_error_free(error);
+        lx_b->alarm_pid = 0;
+        return;
+    }
+    lx_b->alarm_watch = g_child_watch_add(lx_b->alarm_pid, alarm_exited, lx_b);
 }
 
 
@@ -141,19 +162,34 @@ static gchar* make_tooltip(lx_battery* lx_b, gboolean isCharging)
 {
     gchar * tooltip;
     gchar * indent = "  ";
-    battery *b = lx_b->b;
+    battery *b;
+    GList *l;
+    int hours = lx_b->total.seconds / 3600;
+    int minutes = (lx_b->total.seconds - 3600 * hours) / 60;
+    int battery_number = lx_b->battery_number;
 
-    if (b == NULL)
+    if (lx_b->batteries == NULL)
         return NULL;
-
-    if (isCharging) {
-        if (lx_b->b->seconds > 0) {
-            int hours = lx_b->b->seconds / 3600;
-            int left_seconds = lx_b->b->seconds - 3600 * hours;
-            int minutes = left_seconds / 60;
+    b = lx_b->batteries->data;
+    if (battery_number < 0)
+        battery_number = g_str_has_prefix(b->path, ACPI_BATTERY_DEVICE_NAME)
+                ? atoi(b->path + strlen(ACPI_BATTERY_DEVICE_NAME)) : 0;
+
+    if (lx_b->batteries->next != NULL) {
+        /* several batteries, show them as one */
+        if (lx_b->total.seconds > 0)
+            tooltip = g_strdup_printf(isCharging
+                    ? _("Batteries: %d%% charged, %d:%02d until full")
+                    : _("Batteries: %d%% charged, %d:%02d left"),
+                    lx_b->total.percentage, hours, minutes);
+        else
+            tooltip = g_strdup_printf(_("Batteries: %d%% charged"),
+                    lx_b->total.percentage);
+    } else if (isCharging) {
+        if (lx_b->total.seconds > 0) {
             tooltip = g_strdup_printf(
                     _("Battery %d: %d%% charged, %d:%02d until full"),
-                    lx_b->battery_number, lx_b->b->percentage,
+                    battery_number, lx_b->total.percentage,
                     hours,
                     minutes );
         }
@@ -161,20 +197,17 @@ static gchar* make_tooltip(lx_battery* lx_b, gboolean isCharging)
             goto _charged;
     } else {
         /* if we have enough rate information for battery */
-        if (lx_b->b->percentage != 100) {
-            int hours = lx_b->b->seconds / 3600;
-            int left_seconds = lx_b->b->seconds - 3600 * hours;
-            int minutes = left_seconds / 60;
+        if (lx_b->total.percentage != 100) {
             tooltip = g_strdup_printf(
                     _("Battery %d: %d%% charged, %d:%02d left"),
-                    lx_b->battery_number, lx_b->b->percentage,
+                    battery_number, lx_b->total.percentage,
                     hours,
                     minutes );
         } else {
 _charged:
             tooltip = g_strdup_printf(
                     _("Battery %d: %d%% charged"),
-                    lx_b->battery_number, lx_b->b->percentage);
+                    battery_number, lx_b->total.percentage);
         }
     }
 
@@ -182,36 +215,41 @@ _charged:
         return tooltip;
     }
 
-    if (b->energy_full_design != -1)
-        append(&tooltip, _("\n%sEnergy full design:\t\t%5d mWh"), indent, b->energy_full_design);
-    if (b->energy_full != -1)
-        append(&tooltip, _("\n%sEnergy full:\t\t\t%5d mWh"), indent, b->energy_full);
-    if (b->energy_now != -1)
-        append(&tooltip, _("\n%sEnergy now:\t\t\t%5d mWh"), indent, b->energy_now);
-    if (b->power_now != -1)
-        append(&tooltip, _("\n%sPower now:\t\t\t%5d mW"), indent, b->power_now);
-
-    if (b->charge_full_design != -1)
-        append(&tooltip, _("\n%sCharge full design:\t%5d mAh"), indent, b->charge_full_design);
-    if (b->charge_full != -1)
-        append(&tooltip, _("\n%sCharge full:\t\t\t%5d mAh"), indent, b->charge_full);
-    if (b->charge_now != -1)
-        append(&tooltip, _("\n%sCharge now:\t\t\t%5d mAh"), indent, b->charge_now);
-    if (b->current_now != -1)
-        append(&tooltip, _("\n%sCurrent now:\t\t\t%5d mA"), indent, b->current_now);
-
-    if (b->voltage_now != -1)
-        append(&tooltip, _("\n%sCurrent Voltage:\t\t%.3lf V"), indent, b->voltage_now / 1000.0);
+    for (l = lx_b->batteries; l; l = l->next) {
+        b = l->data;
+        if (lx_b->batteries->next != NULL)
+            append(&tooltip, "\n%s: %s, %d%%", b->path, b->state, b->percentage);
+
+        if (b->energy_full_design != -1)
+            append(&tooltip, _("\n%sEnergy full design:\t\t%5d mWh"), indent, b->energy_full_design);
+        if (b->energy_full != -1)
+            append(&tooltip, _("\n%sEnergy full:\t\t\t%5d mWh"), indent, b->energy_full);
+        if (b->energy_now != -1)
+            append(&tooltip, _("\n%sEnergy now:\t\t\t%5d mWh"), indent, b->energy_now);
+        if (b->power_now != -1)
+            append(&tooltip, _("\n%sPower now:\t\t\t%5d mW"), indent, b->power_now);
+
+        if (b->charge_full_design != -1)
+            append(&tooltip, _("\n%sCharge full design:\t%5d mAh"), indent, b->charge_full_design);
+        if (b->charge_full != -1)
+            append(&tooltip, _("\n%sCharge full:\t\t\t%5d mAh"), indent, b->charge_full);
+        if (b->charge_now != -1)
+            append(&tooltip, _("\n%sCharge now:\t\t\t%5d mAh"), indent, b->charge_now);
+        if (b->current_now != -1)
+            append(&tooltip, _("\n%sCurrent now:\t\t\t%5d mA"), indent, b->current_now);
+
+        if (b->voltage_now != -1)
+            append(&tooltip, _("\n%sCurrent Voltage:\t\t%.3lf V"), indent, b->voltage_now / 1000.0);
+    }
 
     return tooltip;
 }
 
 static void set_tooltip_text(lx_battery* lx_b)
 {
-    if (lx_b->b == NULL)
+    if (lx_b->batteries == NULL)
         return;
-    gboolean isCharging = battery_is_charging(lx_b->b);
-    gchar *tooltip = make_tooltip(lx_b, isCharging);
+    gchar *tooltip = make_tooltip(lx_b, lx_b->total.charging);
     gtk_widget_set_tooltip_text(lx_b->drawingArea, tooltip);
     g_free(tooltip);
 }
@@ -220,9 +258,6 @@ static void set_tooltip_text(lx_battery* lx_b)
    Don't repaint if percentage of remaining charge and remaining time aren't changed. */
 void update_display(lx_battery *lx_b, gboolean repaint) {
     cairo_t *cr;
-    battery *b = lx_b->b;
-    /* unit: mW */
-    int rate;
     gboolean isCharging;
 
     if (! lx_b->pixmap )
@@ -237,7 +272,7 @@ void update_display(lx_battery *lx_b, gboolean repaint) {
     cairo_fill(cr);
 
     /* no battery is found */
-    if( b == NULL )
+    if( lx_b->batteries == NULL )
     {
         gtk_widget_set_tooltip_text( lx_b->drawingArea, _("No batteries found") );
         if (lx_b->hide_if_no_battery)
@@ -248,39 +283,21 @@ void update_display(lx_battery *lx_b, gboolean repaint) {
         goto update_done;
     }
 
-    /* fixme: only one battery supported */
-
-    rate = lx_b->b->current_now;
-    isCharging = battery_is_charging ( b );
+    isCharging = lx_b->total.charging;
 
     /* Consider running the alarm command */
-    if ( !isCharging && rate > 0 &&
-        ( ( battery_get_remaining( b ) / 60 ) < (int)lx_b->alarmTime ) )
+    if ( !isCharging && lx_b->total.seconds >= 0 &&
+        ( ( lx_b->total.seconds / 60 ) < (int)lx_b->alarmTime ) )
     {
-        /* FIXME: this should be done using glibs process functions */
         /* FIXME: see bug #463: it should not spawn process all the time */
-        /* Alarms should not run concurrently; determine whether an alarm is
-           already running */
-        int alarmCanRun;
-        sem_getvalue(&(lx_b->alarmProcessLock), &alarmCanRun);
-
         /* Run the alarm command if it isn't already running */
-        if (alarmCanRun) {
-
-            Alarm *a = (Alarm *) malloc(sizeof(Alarm));
-            a->command = lx_b->alarmCommand;
-            a->lock = &(lx_b->alarmProcessLock);
-
-            /* Manage the alarm process in a new thread, which which will be
-               responsible for freeing the alarm struct it's given */
-            pthread_t alarmThread;
-            pthread_create(&alarmThread, NULL, alarmProcess, a);
-        }
+        if (lx_b->alarm_pid == 0)
+            run_alarm(lx_b);
     }
 
     set_tooltip_text(lx_b);
 
-    int chargeLevel = lx_b->b->percentage * lx_b->length / 100;
+    int chargeLevel = MAX(lx_b->total.percentage, 0) * lx_b->length / 100;
 
     if (lx_b->orientation == GTK_ORIENTATION_HORIZONTAL) {
 
@@ -323,23 +340,54 @@ update_done:
     cairo_destroy(cr);
 }
 
-/* This callback is called every 3 seconds */
-static int update_timout(lx_battery *lx_b) {
-    battery *bat;
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
+/* (Re)creates the list of batteries to monitor */
+static void load_batteries(lx_battery *lx_b)
+{
+    GList *found = NULL, *l, *old;
+    battery *b;
+
+    if (lx_b->battery_number < 0)
+        found = battery_get_all();
+    else if ((b = battery_get(lx_b->battery_number)) != NULL)
+        found = g_list_prepend(NULL, b);
+
+    /* keep batteries we already have so their sample history survives,
+       free only those which are gone */
+    for (l = found; l; l = l->next)
+    {
+        b = l->data;
+        for (old = lx_b->batteries; old; old = old->next)
+            if (strcmp(((battery *)old->data)->path, b->path) == 0)
+                break;
+        if (old == NULL)
+            continue;
+        l->data = old->data;
+        lx_b->batteries = g_list_delete_link(lx_b->batteries, old);
+        battery_free(b);
+    }
+    g_list_free_full(lx_b->batteries, (GDestroyNotify)battery_free);
+    lx_b->batteries = found;
+    lx_b->batteries_changed = FALSE;
+    battery_get_total(lx_b->batteries, &lx_b->total);
+}
+
+/* This callback is called periodically and on power supply uevents */
+static gboolean update_timout(gpointer user_data) {
+    lx_battery *lx_b = user_data;
+    GList *l;
     GDK_THREADS_ENTER();
     lx_b->state_elapsed_time++;
     lx_b->info_elapsed_time++;
 
-    bat = battery_update( lx_b->b );
-    if (bat == NULL)
-    {
-        battery_free(lx_b->b);
-
+    for (l = lx_b->batteries; l; l = l->next)
+        if (battery_update(l->data) == NULL)
+            /* battery is gone */
+            lx_b->batteries_changed = TRUE;
+    if (lx_b->batteries == NULL || lx_b->batteries_changed)
         /* maybe in the mean time a battery has been inserted. */
-        lx_b->b = battery_get(lx_b->battery_number);
-    }
+        load_batteries(lx_b);
+    else
+        battery_get_total(lx_b->batteries, &lx_b->total);
 
     update_display( lx_b, TRUE );
 
@@ -347,6 +395,31 @@ static int update_timout(lx_battery *lx_b) {
     return TRUE;
 }
 
+static gboolean update_on_uevent(gpointer user_data)
+{
+    lx_battery *lx_b = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    lx_b->uevent_idle = 0;
+    update_timout(lx_b);
+    return FALSE;
+}
+
+/* AC adapter or battery changed: show it right away, not on next poll.
+   Events usually come in bursts so they are processed once in idle. */
+static void power_supply_changed(const char *action, const char *devpath,
+                                 gpointer user_data)
+{
+    lx_battery *lx_b = user_data;
+
+    /* a battery might be inserted or removed, or events were lost */
+    if (action == NULL || strcmp(action, "change") != 0)
+        lx_b->batteries_changed = TRUE;
+    if (lx_b->uevent_idle == 0)
+        lx_b->uevent_idle = g_idle_add(update_on_uevent, lx_b);
+}
+
 /* An update will be performed whenever the user clicks on the charge bar */
 static gboolean buttonPressEvent(GtkWidget *p, GdkEventButton *event,
                                  LXPanel *panel)
@@ -454,10 +527,11 @@ static GtkWidget * constructor(LXPanel *panel, config_setting_t *settings)
 
     lx_b = g_new0(lx_battery, 1);
 
-    /* get requested battery */
+    /* get requested battery, all of them by default */
+    lx_b->battery_number = -1;
     if (config_setting_lookup_int(settings, "BatteryNumber", &tmp_int))
-        lx_b->battery_number = MAX(0, tmp_int);
-    lx_b->b = battery_get(lx_b->battery_number);
+        lx_b->battery_number = MAX(-1, tmp_int);
+    load_batteries(lx_b);
 
     p = gtk_event_box_new();
     lxpanel_plugin_set_data(p, lx_b, destructor);
@@ -475,8 +549,6 @@ static GtkWidget * constructor(LXPanel *panel, config_setting_t *settings)
 
     gtk_widget_show(lx_b->drawingArea);
 
-    sem_init(&(lx_b->alarmProcessLock), 0, 1);
-
     lx_b->alarmCommand = lx_b->backgroundColor = lx_b->chargingColor1 = lx_b->chargingColor2
             = lx_b->dischargingColor1 = lx_b->dischargingColor2 = NULL;
 
@@ -558,7 +630,11 @@ static GtkWidget * constructor(LXPanel *panel, config_setting_t *settings)
     gdk_color_parse(lx_b->dischargingColor2, &lx_b->discharging2);
 
     /* Start the update loop */
-    lx_b->timer = g_timeout_add_seconds( 9, (GSourceFunc) update_timout, (gpointer) lx_b);
+    lx_b->uevent_watch = lxpanel_sysfs_watch_uevents("power_supply",
+                                                     power_supply_changed, lx_b);
+    lx_b->timer = lxpanel_tick_add(p, lx_b->uevent_watch ? POLL_INTERVAL_UEVENTS
+                                                         : POLL_INTERVAL,
+                                   update_timout, lx_b);
 
     RET(p);
 }
@@ -571,8 +647,7 @@ destructor(gpointer data)
 
     lx_battery *b = (lx_battery *)data;
 
-    if (b->b != NULL)
-        battery_free(b->b);
+    g_list_free_full(b->batteries, (GDestroyNotify)battery_free);
 
     if (b->pixmap)
         cairo_surface_destroy(b->pixmap);
@@ -584,10 +659,18 @@ destructor(gpointer data)
     g_free(b->dischargingColor1);
     g_free(b->dischargingColor2);
 
-    g_free(b->rateSamples);
-    sem_destroy(&(b->alarmProcessLock));
+    if (b->alarm_watch)
+    {
+        /* let the alarm finish but don't leave a zombie */
+        g_source_remove(b->alarm_watch);
+        g_child_watch_add(b->alarm_pid, alarm_reap, NULL);
+    }
     if (b->timer)
-        g_source_remove(b->timer);
+        lxpanel_tick_remove(b->timer);
+    if (b->uevent_watch)
+        lxpanel_sysfs_unwatch_uevents(b->uevent_watch);
+    if (b->uevent_idle)
+        g_source_remove(b->uevent_idle);
     g_free(b);
 
     RET();
@@ -626,9 +709,10 @@ static gboolean applyConfig(gpointer user_data)
 
     lx_battery *b = lxpanel_plugin_get_data(user_data);
 
-    /* Update the battery we monitor */
-    battery_free(b->b);
-    b->b = battery_get(b->battery_number);
+    /* Update the batteries we monitor */
+    if (b->battery_number < -1)
+        b->battery_number = -1;
+    load_batteries(b);
 
     /* Update colors */
     if (b->backgroundColor &&
@@ -668,7 +752,7 @@ static gboolean applyConfig(gpointer user_data)
     /* ensure visibility if requested */
     if (!b->hide_if_no_battery)
         gtk_widget_show(user_data);
-    else if (b->b == NULL)
+    else if (b->batteries == NULL)
         gtk_widget_hide(user_data);
 
     if (b->alarmCommand == NULL)
@@ -710,7 +794,7 @@ static GtkWidget *config(LXPanel *panel, GtkWidget *p) {
             "", panel_config_int_button_new(_("Size"), (int *)&b->thickness,
                                             1, 50), CONF_TYPE_EXTERNAL,
             _("Show Extended Information"), &b->show_extended_information, CONF_TYPE_BOOL,
-            _("Number of battery to monitor"), &b->battery_number, CONF_TYPE_INT,
+            _("Number of battery to monitor (-1 for all)"), &b->battery_number, CONF_TYPE_INT,
             NULL);
 }
 
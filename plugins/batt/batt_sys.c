@@ -37,6 +37,12 @@
 /* shrug: get rid of this */
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+/* rate is taken from change of level only if samples cover this time */
+#define BATTERY_HISTORY_MIN_SPAN    (60 * G_USEC_PER_SEC)
+/* uevents come in bursts, samples taken more often than this are dropped */
+#define BATTERY_SAMPLE_MIN_INTERVAL (5 * G_USEC_PER_SEC)
 
 battery* battery_new() {
     static int battery_num = 1;
@@ -62,41 +68,109 @@ battery* battery_new() {
 }
 
 
-static gchar* parse_info_file(battery *b, char *sys_file)
+static const char *battery_attr_names[BATTERY_N_ATTRS] = {
+    "type",
+    "status",
+    "state",
+    "charge_now",
+    "energy_now",
+    "current_now",
+    "power_now",
+    "voltage_now",
+    "charge_full_design",
+    "energy_full_design",
+    "charge_full",
+    "energy_full",
+    "scope"
+};
+
+/* Attribute files are opened once and kept open while battery exists. */
+static LXPanelSysfsAttr *battery_attr(battery *b, int attr)
 {
-    char *buf = NULL;
-    GString *filename = g_string_new(ACPI_PATH_SYS_POWER_SUPPLY);
-
-    g_string_append_printf (filename, "/%s/%s", b->path, sys_file);
-
-    if (g_file_get_contents(filename->str, &buf, NULL, NULL) == TRUE) {
-        g_strstrip( buf );
+    if (b->attrs[attr] == NULL)
+    {
+        gchar *dir = g_build_filename(ACPI_PATH_SYS_POWER_SUPPLY, b->path, NULL);
+        b->attrs[attr] = lxpanel_sysfs_attr_new(dir, battery_attr_names[attr]);
+        g_free(dir);
     }
-
-    g_string_free(filename, TRUE);
-
-    return buf;
+    return b->attrs[attr];
 }
 
 /* get_gint_from_infofile():
  *         If the sys_file exists, then its value is converted to an int,
  *         divided by 1000, and returned.
  *         Failure is indicated by returning -1. */
-static gint get_gint_from_infofile(battery *b, gchar *sys_file)
+static gint get_gint_from_infofile(battery *b, int attr)
+{
+    gint64 value;
+
+    if (lxpanel_sysfs_attr_read_int(battery_attr(b, attr), &value))
+        return value / 1000;
+    return -1;
+}
+
+static const gchar* get_gchar_from_infofile(battery *b, int attr)
+{
+    return lxpanel_sysfs_attr_read(battery_attr(b, attr));
+}
+
+/* CLOCK_BOOTTIME includes time of suspend, so level lost while suspended
+   isn't taken as a discharge at a huge rate */
+static gint64 battery_time(void)
 {
-    gchar *file_content = parse_info_file(b, sys_file);
-    gint value = -1;
+#ifdef CLOCK_BOOTTIME
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) == 0)
+        return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+#endif
+    return g_get_monotonic_time();
+}
 
-    if (file_content != NULL)
-        value = atoi(file_content) / 1000;
-    g_free(file_content);
+/* Level is energy if battery reports it, charge otherwise; rate is in
+   matching units, see battery_sample. */
+static int battery_level(battery *b)
+{
+    return (b->energy_now != -1) ? b->energy_now : b->charge_now;
+}
 
-    return value;
+static int battery_level_full(battery *b)
+{
+    return (b->energy_now != -1) ? b->energy_full : b->charge_full;
 }
 
-static gchar* get_gchar_from_infofile(battery *b, gchar *sys_file)
+static int battery_reported_rate(battery *b)
 {
-    return parse_info_file(b, sys_file);
+    if (b->energy_now == -1)
+        return b->current_now;
+    if (b->power_now != -1)
+        return b->power_now;
+    if (b->current_now != -1 && b->voltage_now > 0)
+        return b->current_now * b->voltage_now / 1000; // P = U*I
+    return -1;
+}
+
+static void battery_add_sample(battery *b)
+{
+    battery_sample *sample;
+    gint64 now = battery_time();
+    int level = battery_level(b);
+
+    if (level == -1)
+        return;
+    if (b->history_len > 0)
+    {
+        sample = &b->history[(b->history_pos + BATTERY_HISTORY_SIZE - 1) % BATTERY_HISTORY_SIZE];
+        if (now - sample->time < BATTERY_SAMPLE_MIN_INTERVAL)
+            return;
+    }
+    sample = &b->history[b->history_pos];
+    sample->time = now;
+    sample->level = level;
+    sample->rate = battery_reported_rate(b);
+    b->history_pos = (b->history_pos + 1) % BATTERY_HISTORY_SIZE;
+    if (b->history_len < BATTERY_HISTORY_SIZE)
+        b->history_len++;
 }
 
 #if 0 /* never used */
@@ -146,41 +220,26 @@ void battery_print(battery *b, int show_capacity)
 }
 #endif
 
-static gboolean battery_inserted(gchar* path)
-{
-    if (path == NULL)
-        return FALSE;
-
-    GString *dirname = g_string_new(ACPI_PATH_SYS_POWER_SUPPLY);
-    GDir *dir;
-
-    g_string_append_printf (dirname, "/%s/", path);
-    dir = g_dir_open(dirname->str, 0, NULL);
-    if (dir)
-        g_dir_close(dir);
-    g_string_free(dirname, TRUE);
-
-    return dir ? TRUE : FALSE;
-}
-
-
 battery* battery_update(battery *b)
 {
-    gchar *gctmp;
-    int promille;
+    const gchar *gctmp;
+    int promille, rate, level, level_full;
 
     if (b == NULL)
         return NULL;
 
-    if (!battery_inserted(b->path))
+    /* every power supply has type, if it can't be read then device is gone */
+    gctmp = get_gchar_from_infofile(b, BATTERY_ATTR_TYPE);
+    if (gctmp == NULL)
         return NULL;
+    b->type_battery = (strcasecmp(gctmp, "battery") == 0);
 
     /* read from sysfs */
-    b->charge_now = get_gint_from_infofile(b, "charge_now");
-    b->energy_now = get_gint_from_infofile(b, "energy_now");
+    b->charge_now = get_gint_from_infofile(b, BATTERY_ATTR_CHARGE_NOW);
+    b->energy_now = get_gint_from_infofile(b, BATTERY_ATTR_ENERGY_NOW);
 
-    b->current_now = get_gint_from_infofile(b, "current_now");
-    b->power_now   = get_gint_from_infofile(b, "power_now");
+    b->current_now = get_gint_from_infofile(b, BATTERY_ATTR_CURRENT_NOW);
+    b->power_now   = get_gint_from_infofile(b, BATTERY_ATTR_POWER_NOW);
     /* FIXME: Some battery drivers report -1000 when the discharge rate is
      * unavailable. Others use negative values when discharging. Best we can do
      * is to treat -1 as an error, and take the absolute value otherwise.
@@ -189,28 +248,30 @@ battery* battery_update(battery *b)
     if (b->current_now < -1)
             b->current_now = - b->current_now;
 
-    b->charge_full = get_gint_from_infofile(b, "charge_full");
-    b->energy_full = get_gint_from_infofile(b, "energy_full");
-
-    b->charge_full_design = get_gint_from_infofile(b, "charge_full_design");
-    b->energy_full_design = get_gint_from_infofile(b, "energy_full_design");
+    b->charge_full = get_gint_from_infofile(b, BATTERY_ATTR_CHARGE_FULL);
+    b->energy_full = get_gint_from_infofile(b, BATTERY_ATTR_ENERGY_FULL);
 
-    b->voltage_now = get_gint_from_infofile(b, "voltage_now");
+    b->charge_full_design = get_gint_from_infofile(b, BATTERY_ATTR_CHARGE_FULL_DESIGN);
+    b->energy_full_design = get_gint_from_infofile(b, BATTERY_ATTR_ENERGY_FULL_DESIGN);
 
-    gctmp = get_gchar_from_infofile(b, "type");
-    b->type_battery = gctmp ? (strcasecmp(gctmp, "battery") == 0) : TRUE;
-    g_free(gctmp);
+    b->voltage_now = get_gint_from_infofile(b, BATTERY_ATTR_VOLTAGE_NOW);
 
-    g_free(b->state);
-    b->state = get_gchar_from_infofile(b, "status");
-    if (!b->state)
-        b->state = get_gchar_from_infofile(b, "state");
-    if (!b->state) {
+    gctmp = get_gchar_from_infofile(b, BATTERY_ATTR_STATUS);
+    if (!gctmp)
+        gctmp = get_gchar_from_infofile(b, BATTERY_ATTR_STATE);
+    if (!gctmp) {
         if (b->charge_now != -1 || b->energy_now != -1
                 || b->charge_full != -1 || b->energy_full != -1)
-            b->state = g_strdup("available");
+            gctmp = "available";
         else
-            b->state = g_strdup("unavailable");
+            gctmp = "unavailable";
+    }
+    /* state rarely changes so don't reallocate it each time */
+    if (b->state == NULL || strcmp(b->state, gctmp) != 0) {
+        g_free(b->state);
+        b->state = g_strdup(gctmp);
+        /* rate of previous state means nothing now */
+        b->history_len = b->history_pos = 0;
     }
 
 #if 0 /* those conversions might be good for text prints but are pretty wrong for tooltip and calculations */
@@ -268,29 +329,22 @@ battery* battery_update(battery *b)
 
     if (b->power_now < -1)
         b->power_now = - b->power_now;
-    if (b->current_now == -1 && b->power_now == -1) {
+
+    /* remaining time is estimated from history, not from one reading */
+    battery_add_sample(b);
+    rate = battery_get_rate(b);
+    level = battery_level(b);
+    level_full = battery_level_full(b);
+    if (rate <= 0 || level == -1) {
         //b->poststr = "rate information unavailable";
         b->seconds = -1;
     } else if (!strcasecmp(b->state, "charging")) {
-        if (b->current_now > MIN_PRESENT_RATE) {
-            b->seconds = 3600 * (b->charge_full - b->charge_now) / b->current_now;
-            //b->poststr = " until charged";
-        } else if (b->power_now > 0) {
-            b->seconds = 3600 * (b->energy_full - b->energy_now) / b->power_now;
-        } else {
-            //b->poststr = "charging at zero rate - will never fully charge.";
+        if (level_full != -1)
+            b->seconds = (gint64)3600 * MAX(level_full - level, 0) / rate;
+        else
             b->seconds = -1;
-        }
     } else if (!strcasecmp(b->state, "discharging")) {
-        if (b->current_now > MIN_PRESENT_RATE) {
-            b->seconds = 3600 * b->charge_now / b->current_now;
-            //b->poststr = " remaining";
-        } else if (b->power_now > 0) {
-            b->seconds = 3600 * b->energy_now / b->power_now;
-        } else {
-            //b->poststr = "discharging at zero rate - will never fully discharge.";
-            b->seconds = -1;
-        }
+        b->seconds = (gint64)3600 * level / rate;
     } else {
         //b->poststr = NULL;
         b->seconds = -1;
@@ -314,9 +368,8 @@ battery *battery_get(int battery_number) {
     if (g_file_test(batt_path, G_FILE_TEST_IS_DIR) == TRUE) {
         b = battery_new();
         b->path = g_strdup( batt_name);
-        battery_update ( b );
 
-        if (!b->type_battery) {
+        if (battery_update(b) == NULL || !b->type_battery) {
             g_warning( "Not a battery: %s", batt_path );
             battery_free(b);
             b = NULL;
@@ -345,10 +398,9 @@ battery *battery_get(int battery_number) {
     {
         b = battery_new();
         b->path = g_strdup( entry );
-        battery_update ( b );
 
         /* We're looking for a battery with the selected ID */
-        if (b->type_battery == TRUE) {
+        if (battery_update(b) != NULL && b->type_battery == TRUE) {
             break;
         }
         battery_free(b);
@@ -365,9 +417,52 @@ battery *battery_get(int battery_number) {
     return b;
 }
 
+static gint battery_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(((const battery *)a)->path, ((const battery *)b)->path);
+}
+
+/* Returns all batteries of the system sorted by name. */
+GList *battery_get_all(void)
+{
+    GError * error = NULL;
+    const gchar *entry;
+    GList *batteries = NULL;
+    GDir * dir;
+    battery *b;
+
+    dir = g_dir_open( ACPI_PATH_SYS_POWER_SUPPLY, 0, &error );
+    if ( dir == NULL )
+    {
+        g_warning( "NO ACPI/sysfs support in kernel: %s", error->message );
+        g_error_free(error);
+        return NULL;
+    }
+
+    while ( ( entry = g_dir_read_name (dir) ) != NULL )
+    {
+        b = battery_new();
+        b->path = g_strdup( entry );
+
+        /* batteries of mice and such have scope "Device", skip them */
+        if (battery_update(b) != NULL && b->type_battery == TRUE &&
+            g_strcmp0(get_gchar_from_infofile(b, BATTERY_ATTR_SCOPE), "Device") != 0)
+            batteries = g_list_insert_sorted(batteries, b, battery_compare);
+        else
+            battery_free(b);
+    }
+
+    g_dir_close( dir );
+    return batteries;
+}
+
 void battery_free(battery* bat)
 {
     if (bat) {
+        int i;
+
+        for (i = 0; i < BATTERY_N_ATTRS; i++)
+            lxpanel_sysfs_attr_free(bat->attrs[i]);
         g_free(bat->path);
         g_free(bat->state);
         g_free(bat);
@@ -389,5 +484,91 @@ gint battery_get_remaining( battery *b )
     return b->seconds;
 }
 
+/* Returns smoothed rate of charge or discharge, in units of battery_sample,
+   or -1 if it is unknown. */
+gint battery_get_rate( battery *b )
+{
+    battery_sample *first, *last;
+    gint64 span;
+    int i, n, sum;
+
+    if (b->history_len == 0)
+        return -1;
+    first = &b->history[(b->history_pos + BATTERY_HISTORY_SIZE - b->history_len) % BATTERY_HISTORY_SIZE];
+    last = &b->history[(b->history_pos + BATTERY_HISTORY_SIZE - 1) % BATTERY_HISTORY_SIZE];
+    span = last->time - first->time;
+    /* change of level over a few minutes is the real rate, the rate which
+       hardware reports is instantaneous and jumps with the load */
+    if (span >= BATTERY_HISTORY_MIN_SPAN && first->level != last->level)
+        return (gint64)ABS(first->level - last->level) * 3600 * G_USEC_PER_SEC / span;
+    /* not enough history yet, average the reported rates */
+    for (i = n = sum = 0; i < b->history_len; i++)
+    {
+        if (b->history[i].rate > 0)
+        {
+            sum += b->history[i].rate;
+            n++;
+        }
+    }
+    return (n > 0) ? sum / n : -1;
+}
+
+/* Combines batteries as one: they are charging if none is discharging, the
+   rate is sum of rates of batteries going that way, and the time is how long
+   it takes for all of them to be full or empty at that rate. */
+void battery_get_total(GList *batteries, battery_total *total)
+{
+    GList *l;
+    battery *b;
+    int n = 0, percentage = 0, level = 0, level_full = 0, rate = 0, r;
+    gboolean have_levels = TRUE, have_rate = FALSE;
+
+    total->charging = TRUE;
+    for (l = batteries; l; l = l->next)
+    {
+        b = l->data;
+        n++;
+        percentage += b->percentage;
+        if (!battery_is_charging(b))
+            total->charging = FALSE;
+        if (battery_level(b) == -1 || battery_level_full(b) <= 0)
+            have_levels = FALSE;
+        else
+        {
+            level += battery_level(b);
+            level_full += battery_level_full(b);
+        }
+    }
+    if (n == 0)
+    {
+        total->percentage = total->seconds = total->rate = -1;
+        return;
+    }
+    for (l = batteries; l; l = l->next)
+    {
+        b = l->data;
+        if (battery_is_charging(b) != total->charging)
+            continue;
+        r = battery_get_rate(b);
+        if (r > 0)
+        {
+            rate += r;
+            have_rate = TRUE;
+        }
+    }
+
+    if (have_levels)
+        total->percentage = MIN(((gint64)level * 1000 / level_full + 5) / 10, 100);
+    else
+        total->percentage = percentage / n;
+    total->rate = have_rate ? rate : -1;
+    if (!have_rate || !have_levels)
+        total->seconds = -1;
+    else if (total->charging)
+        total->seconds = (gint64)3600 * MAX(level_full - level, 0) / rate;
+    else
+        total->seconds = (gint64)3600 * level / rate;
+}
+
 
 /* vim: set sw=4 et sts=4 : */
@@ -31,13 +31,46 @@
 #define MIN_CAPACITY	 0.01
 #define MIN_PRESENT_RATE 0.01
 #define BATTERY_DESC	"Battery"
+/* number of samples kept to estimate the rate of charge or discharge */
+#define BATTERY_HISTORY_SIZE 16
 
 #include <glib.h>
 
+#include "sysfs.h"
+
+/* sysfs attributes of battery */
+enum {
+    BATTERY_ATTR_TYPE,
+    BATTERY_ATTR_STATUS,
+    BATTERY_ATTR_STATE,
+    BATTERY_ATTR_CHARGE_NOW,
+    BATTERY_ATTR_ENERGY_NOW,
+    BATTERY_ATTR_CURRENT_NOW,
+    BATTERY_ATTR_POWER_NOW,
+    BATTERY_ATTR_VOLTAGE_NOW,
+    BATTERY_ATTR_CHARGE_FULL_DESIGN,
+    BATTERY_ATTR_ENERGY_FULL_DESIGN,
+    BATTERY_ATTR_CHARGE_FULL,
+    BATTERY_ATTR_ENERGY_FULL,
+    BATTERY_ATTR_SCOPE,
+    BATTERY_N_ATTRS
+};
+
+/* one reading of the battery for rate estimation; level and rate are either
+   energy (mWh) and power (mW) or charge (mAh) and current (mA), the same as
+   the battery reports */
+typedef struct {
+    gint64 time;                /* since boot, in microseconds */
+    int level;
+    int rate;                   /* instantaneous rate reported, -1 if none */
+} battery_sample;
+
 typedef struct battery {
     int battery_num;
     /* path to battery dir */
     gchar *path;
+    /* opened on first use */
+    LXPanelSysfsAttr *attrs[BATTERY_N_ATTRS];
     /* sysfs file contents */
     int charge_now;
     int energy_now;
@@ -55,13 +88,28 @@ typedef struct battery {
     //const char *poststr;
     //const char *capacity_unit;
     int type_battery;
+    /* ring of last samples, reset when state changes */
+    battery_sample history[BATTERY_HISTORY_SIZE];
+    int history_len;
+    int history_pos;            /* where next sample goes */
 } battery;
 
+/* all batteries of the system together */
+typedef struct {
+    int percentage;             /* -1 if unknown */
+    int seconds;                /* until all are empty or full, -1 if unknown */
+    int rate;                   /* combined rate, mW or mA, -1 if unknown */
+    gboolean charging;
+} battery_total;
+
 battery *battery_get(int);
+GList *battery_get_all(void);
 battery *battery_update( battery *b );
 //void battery_print(battery *b, int show_capacity);
 gboolean battery_is_charging( battery *b );
 gint battery_get_remaining( battery *b );
+gint battery_get_rate( battery *b );
+void battery_get_total(GList *batteries, battery_total *total);
 void battery_free(battery* bat);
 
 #endif
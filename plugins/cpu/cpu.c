@@ -40,216 +40,264 @@
 #include <glib/gi18n.h>
 
 #include "plugin.h"
+#include "sysstat.h"
+#include "graph.h"
 
 #define BORDER_SIZE 2
 #define PANEL_HEIGHT_DEFAULT 26 /* from panel defaults */
+#define UPDATE_PERIOD 1500 /* ms */
+#define MIN_UPDATE_PERIOD 250 /* ms */
 
 /* #include "../../dbg.h" */
 
-typedef unsigned long long CPUTick;		/* Value from /proc/stat */
 typedef float CPUSample;			/* Saved CPU utilization value as 0.0..1.0 */
 
-struct cpu_stat {
-    CPUTick u, n, s, i;				/* User, nice, system, idle */
+/* Graph modes. */
+enum {
+    CPU_MODE_TOTAL,				/* Total usage of all CPUs */
+    CPU_MODE_STATES,				/* Stacked usage by user, system, iowait, steal */
+    CPU_MODE_CORES,				/* Heatmap strip with a row for each core */
+    CPU_N_MODES
+};
+
+/* States which are stacked in CPU_MODE_STATES. */
+enum {
+    CPU_STATE_USER,				/* User and nice */
+    CPU_STATE_SYSTEM,				/* System, irq and softirq */
+    CPU_STATE_IOWAIT,
+    CPU_STATE_STEAL,
+    CPU_N_STATES
+};
+
+static const char * mode_names[CPU_N_MODES] = {
+    [CPU_MODE_TOTAL] = N_("Total usage"),
+    [CPU_MODE_STATES] = N_("Usage by state"),
+    [CPU_MODE_CORES] = N_("Usage by core")
+};
+
+static const char * state_colors[CPU_N_STATES] = {
+    [CPU_STATE_USER] = "green",
+    [CPU_STATE_SYSTEM] = "red",
+    [CPU_STATE_IOWAIT] = "yellow",
+    [CPU_STATE_STEAL] = "blue"
 };
 
 /* Private context for CPU plugin. */
 typedef struct {
-    GdkColor foreground_color;			/* Foreground color for drawing area */
-    GtkWidget * da;				/* Drawing area */
-    cairo_surface_t * pixmap;				/* Pixmap to be drawn on drawing area */
-
-    guint timer;				/* Timer for periodic update */
-    CPUSample * stats_cpu;			/* Ring buffer of CPU utilization values */
-    unsigned int ring_cursor;			/* Cursor for ring buffer */
-    guint pixmap_width;				/* Width of drawing area pixmap; also size of ring buffer; does not include border size */
-    guint pixmap_height;			/* Height of drawing area pixmap; does not include border size */
-    struct cpu_stat previous_cpu_stat;		/* Previous value of cpu_stat */
+    GdkColor foreground_color[CPU_N_STATES];	/* Foreground colors for drawing area */
+    GtkWidget * da;				/* Graph of CPU utilization values */
+    config_setting_t * settings;		/* Plugin settings */
+
+    int mode;					/* Graph mode, one of CPU_MODE_* */
+    int graph_mode;				/* Mode of samples which are in graph now */
+    int interval;				/* Interval between samples, ms */
+    guint sampler;				/* Subscription to periodic statistics */
+    LXPanelCpuTicks previous_cpu_stat;		/* Previous value of total CPU counters */
+    LXPanelCpuTicks * previous_cores;		/* Previous values of counters for each core */
+    guint n_previous_cores;
+    gboolean restart;				/* Take next sample as previous counters only */
 } CPUPlugin;
 
-static void redraw_pixmap(CPUPlugin * c);
-static gboolean cpu_update(CPUPlugin * c);
-static gboolean configure_event(GtkWidget * widget, GdkEventConfigure * event, CPUPlugin * c);
-#if !GTK_CHECK_VERSION(3, 0, 0)
-static gboolean expose_event(GtkWidget * widget, GdkEventExpose * event, CPUPlugin * c);
-#else
-static gboolean draw(GtkWidget * widget, cairo_t * cr, CPUPlugin * c);
-#endif
+static void cpu_update(const LXPanelSysStat * stat, gpointer user_data);
 
 static void cpu_destructor(gpointer user_data);
 
-/* Redraw after timer callback or resize. */
-static void redraw_pixmap(CPUPlugin * c)
+/* Draw total usage as a bar. */
+static void draw_total(CPUPlugin * c, cairo_t * cr, gint x, gint height, const gfloat * values)
+{
+    if (values[0] != 0.0)
+    {
+        gdk_cairo_set_source_color(cr, &c->foreground_color[CPU_STATE_USER]);
+        cairo_rectangle(cr, x, height - values[0] * height, 1, values[0] * height);
+        cairo_fill(cr);
+    }
+}
+
+/* Draw usage by states, stacked from bottom. */
+static void draw_states(CPUPlugin * c, cairo_t * cr, gint x, gint height, const gfloat * values)
 {
-    cairo_t * cr = cairo_create(c->pixmap);
-    GtkStyle * style = gtk_widget_get_style(c->da);
-    cairo_set_line_width (cr, 1.0);
-    /* Erase pixmap. */
-    cairo_rectangle(cr, 0, 0, c->pixmap_width, c->pixmap_height);
-    gdk_cairo_set_source_color(cr, &style->black);
-    cairo_fill(cr);
-
-    /* Recompute pixmap. */
-    unsigned int i;
-    unsigned int drawing_cursor = c->ring_cursor;
-    gdk_cairo_set_source_color(cr, &c->foreground_color);
-    for (i = 0; i < c->pixmap_width; i++)
+    unsigned int state;
+    gfloat bottom = 0.0;
+    for (state = 0; state < CPU_N_STATES; state++)
     {
-        /* Draw one bar of the CPU usage graph. */
-        if (c->stats_cpu[drawing_cursor] != 0.0)
+        if (values[state] != 0.0)
         {
-            cairo_move_to(cr, i + 0.5, c->pixmap_height);
-            cairo_line_to(cr, i + 0.5, c->pixmap_height - c->stats_cpu[drawing_cursor] * c->pixmap_height);
-            cairo_stroke(cr);
+            gdk_cairo_set_source_color(cr, &c->foreground_color[state]);
+            cairo_rectangle(cr, x, height - (bottom + values[state]) * height, 1, values[state] * height);
+            cairo_fill(cr);
         }
-
-        /* Increment and wrap drawing cursor. */
-        drawing_cursor += 1;
-        if (drawing_cursor >= c->pixmap_width)
-            drawing_cursor = 0;
+        bottom += values[state];
     }
+}
 
-    /* check_cairo_status(cr); */
-    cairo_destroy(cr);
+/* Draw usage by cores as a heatmap. If there are more cores than pixels in
+ * height then each row shows the busiest of cores it covers. */
+static void draw_cores(CPUPlugin * c, cairo_t * cr, gint x, gint height, const gfloat * values, guint n_values)
+{
+    GdkColor * color = &c->foreground_color[CPU_STATE_USER];
+    guint rows = MIN(n_values, (guint)height);
+    guint row, k;
 
-    /* Redraw pixmap. */
-    gtk_widget_queue_draw(c->da);
+    for (row = 0; row < rows; row++)
+    {
+        guint y0 = row * height / rows;
+        guint y1 = (row + 1) * height / rows;
+        gfloat value = 0.0;
+        for (k = row * n_values / rows; k < (row + 1) * n_values / rows; k++)
+            value = MAX(value, values[k]);
+        if (value == 0.0)
+            continue;
+        cairo_set_source_rgb(cr, value * color->red / 65535.0,
+                             value * color->green / 65535.0,
+                             value * color->blue / 65535.0);
+        cairo_rectangle(cr, x, y0, 1, y1 - y0);
+        cairo_fill(cr);
+    }
 }
 
-/* Periodic timer callback. */
-static gboolean cpu_update(CPUPlugin * c)
+/* Draw one sample, called by graph on new sample or resize. */
+static void draw_sample(cairo_t * cr, gint x, gint height, const gfloat * values,
+                        guint n_values, gpointer user_data)
 {
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
-    if ((c->stats_cpu != NULL) && (c->pixmap != NULL))
+    CPUPlugin * c = user_data;
+    switch (c->mode)
     {
-        /* Open statistics file and scan out CPU usage. */
-        struct cpu_stat cpu;
-        FILE * stat = fopen("/proc/stat", "r");
-        if (stat == NULL)
-            return TRUE;
-        int fscanf_result = fscanf(stat, "cpu %llu %llu %llu %llu", &cpu.u, &cpu.n, &cpu.s, &cpu.i);
-        fclose(stat);
-
-        /* Ensure that fscanf succeeded. */
-        if (fscanf_result == 4)
-        {
-            /* Compute delta from previous statistics. */
-            struct cpu_stat cpu_delta;
-            cpu_delta.u = cpu.u - c->previous_cpu_stat.u;
-            cpu_delta.n = cpu.n - c->previous_cpu_stat.n;
-            cpu_delta.s = cpu.s - c->previous_cpu_stat.s;
-            cpu_delta.i = cpu.i - c->previous_cpu_stat.i;
-
-            /* Copy current to previous. */
-            memcpy(&c->previous_cpu_stat, &cpu, sizeof(struct cpu_stat));
-
-            /* Compute user+nice+system as a fraction of total.
-             * Introduce this sample to ring buffer, increment and wrap ring buffer cursor. */
-            float cpu_uns = cpu_delta.u + cpu_delta.n + cpu_delta.s;
-            c->stats_cpu[c->ring_cursor] = cpu_uns / (cpu_uns + cpu_delta.i);
-            c->ring_cursor += 1;
-            if (c->ring_cursor >= c->pixmap_width)
-                c->ring_cursor = 0;
-
-            /* Redraw with the new sample. */
-            redraw_pixmap(c);
-        }
+    case CPU_MODE_STATES:
+        draw_states(c, cr, x, height, values);
+        break;
+    case CPU_MODE_CORES:
+        draw_cores(c, cr, x, height, values, n_values);
+        break;
+    default:
+        draw_total(c, cr, x, height, values);
     }
-    return TRUE;
 }
 
-/* Handler for configure_event on drawing area. */
-static gboolean configure_event(GtkWidget * widget, GdkEventConfigure * event, CPUPlugin * c)
+/* Difference of counters; a core which was offline may have them reset. */
+static inline CPUSample ticks_delta(guint64 current, guint64 previous)
 {
-    GtkAllocation allocation;
+    return (current > previous) ? (CPUSample)(current - previous) : 0.0;
+}
 
-    gtk_widget_get_allocation(widget, &allocation);
-    /* Allocate pixmap and statistics buffer without border pixels. */
-    guint new_pixmap_width = MAX(allocation.width - BORDER_SIZE * 2, 0);
-    guint new_pixmap_height = MAX(allocation.height - BORDER_SIZE * 2, 0);
-    if ((new_pixmap_width > 0) && (new_pixmap_height > 0))
+/* Periodic statistics callback. */
+static void cpu_update(const LXPanelSysStat * stat, gpointer user_data)
+{
+    CPUPlugin * c = user_data;
+    PanelGraph * graph = PANEL_GRAPH(c->da);
+    CPUSample * sample;
+    guint k;
+
+    /* Take counters as previous ones on the first sample after mode change,
+     * so it doesn't cover the time spent in other mode. */
+    if (c->restart)
     {
-        /* If statistics buffer does not exist or it changed size, reallocate and preserve existing data. */
-        if ((c->stats_cpu == NULL) || (new_pixmap_width != c->pixmap_width))
+        if (stat->valid & LXPANEL_SYSSTAT_CPU)
+            memcpy(&c->previous_cpu_stat, &stat->cpu, sizeof(LXPanelCpuTicks));
+        if (stat->valid & LXPANEL_SYSSTAT_CPU_CORES)
         {
-            CPUSample * new_stats_cpu = g_new0(typeof(*c->stats_cpu), new_pixmap_width);
-            if (c->stats_cpu != NULL)
-            {
-                if (new_pixmap_width > c->pixmap_width)
-                {
-                    /* New allocation is larger.
-                     * Introduce new "oldest" samples of zero following the cursor. */
-                    memcpy(&new_stats_cpu[0],
-                        &c->stats_cpu[0], c->ring_cursor * sizeof(CPUSample));
-                    memcpy(&new_stats_cpu[new_pixmap_width - c->pixmap_width + c->ring_cursor],
-                        &c->stats_cpu[c->ring_cursor], (c->pixmap_width - c->ring_cursor) * sizeof(CPUSample));
-                }
-                else if (c->ring_cursor <= new_pixmap_width)
-                {
-                    /* New allocation is smaller, but still larger than the ring buffer cursor.
-                     * Discard the oldest samples following the cursor. */
-                    memcpy(&new_stats_cpu[0],
-                        &c->stats_cpu[0], c->ring_cursor * sizeof(CPUSample));
-                    memcpy(&new_stats_cpu[c->ring_cursor],
-                        &c->stats_cpu[c->pixmap_width - new_pixmap_width + c->ring_cursor], (new_pixmap_width - c->ring_cursor) * sizeof(CPUSample));
-                }
-                else
-                {
-                    /* New allocation is smaller, and also smaller than the ring buffer cursor.
-                     * Discard all oldest samples following the ring buffer cursor and additional samples at the beginning of the buffer. */
-                    memcpy(&new_stats_cpu[0],
-                        &c->stats_cpu[c->ring_cursor - new_pixmap_width], new_pixmap_width * sizeof(CPUSample));
-                    c->ring_cursor = 0;
-                }
-                g_free(c->stats_cpu);
-            }
-            c->stats_cpu = new_stats_cpu;
+            c->previous_cores = g_renew(LXPanelCpuTicks, c->previous_cores, stat->n_cores);
+            memcpy(c->previous_cores, stat->cores, stat->n_cores * sizeof(LXPanelCpuTicks));
+            c->n_previous_cores = stat->n_cores;
         }
+        if (stat->valid & ((c->mode == CPU_MODE_CORES) ? LXPANEL_SYSSTAT_CPU_CORES : LXPANEL_SYSSTAT_CPU))
+            c->restart = FALSE;
+        return;
+    }
 
-        /* Allocate or reallocate pixmap. */
-        c->pixmap_width = new_pixmap_width;
-        c->pixmap_height = new_pixmap_height;
-        if (c->pixmap)
-            cairo_surface_destroy(c->pixmap);
-        c->pixmap = cairo_image_surface_create(CAIRO_FORMAT_RGB24, c->pixmap_width, c->pixmap_height);
-        /* check_cairo_surface_status(&c->pixmap); */
+    if (c->mode == CPU_MODE_CORES)
+    {
+        /* Ensure that per-core usage was read. */
+        if (!(stat->valid & LXPANEL_SYSSTAT_CPU_CORES))
+            return;
+        panel_graph_set_n_values(graph, stat->n_cores);
+        if (stat->n_cores > c->n_previous_cores)
+        {
+            c->previous_cores = g_renew(LXPanelCpuTicks, c->previous_cores, stat->n_cores);
+            memcpy(&c->previous_cores[c->n_previous_cores], &stat->cores[c->n_previous_cores],
+                   (stat->n_cores - c->n_previous_cores) * sizeof(LXPanelCpuTicks));
+            c->n_previous_cores = stat->n_cores;
+        }
 
-        /* Redraw pixmap at the new size. */
-        redraw_pixmap(c);
+        /* Compute busy time of each core as a fraction of its total. */
+        sample = panel_graph_new_sample(graph);
+        for (k = 0; sample != NULL && k < stat->n_cores; k++)
+        {
+            const LXPanelCpuTicks * cur = &stat->cores[k];
+            LXPanelCpuTicks * prev = &c->previous_cores[k];
+            CPUSample idle = ticks_delta(cur->idle, prev->idle) + ticks_delta(cur->iowait, prev->iowait);
+            CPUSample busy = ticks_delta(cur->user, prev->user) + ticks_delta(cur->nice, prev->nice)
+                           + ticks_delta(cur->system, prev->system) + ticks_delta(cur->irq, prev->irq)
+                           + ticks_delta(cur->softirq, prev->softirq) + ticks_delta(cur->steal, prev->steal);
+            sample[k] = (busy + idle > 0.0) ? busy / (busy + idle) : 0.0;
+        }
+
+        /* Copy current to previous. */
+        memcpy(c->previous_cores, stat->cores, stat->n_cores * sizeof(LXPanelCpuTicks));
     }
-    return TRUE;
+    else
+    {
+        const LXPanelCpuTicks * cpu = &stat->cpu;
+        LXPanelCpuTicks * prev = &c->previous_cpu_stat;
+
+        /* Ensure that total CPU usage was read. */
+        if (!(stat->valid & LXPANEL_SYSSTAT_CPU))
+            return;
+
+        sample = panel_graph_new_sample(graph);
+        if (sample != NULL && c->mode == CPU_MODE_STATES)
+        {
+            /* Compute each state as a fraction of total. */
+            CPUSample total;
+            sample[CPU_STATE_USER] = ticks_delta(cpu->user, prev->user) + ticks_delta(cpu->nice, prev->nice);
+            sample[CPU_STATE_SYSTEM] = ticks_delta(cpu->system, prev->system) + ticks_delta(cpu->irq, prev->irq)
+                                     + ticks_delta(cpu->softirq, prev->softirq);
+            sample[CPU_STATE_IOWAIT] = ticks_delta(cpu->iowait, prev->iowait);
+            sample[CPU_STATE_STEAL] = ticks_delta(cpu->steal, prev->steal);
+            total = sample[CPU_STATE_USER] + sample[CPU_STATE_SYSTEM] + sample[CPU_STATE_IOWAIT]
+                  + sample[CPU_STATE_STEAL] + ticks_delta(cpu->idle, prev->idle);
+            for (k = 0; k < CPU_N_STATES; k++)
+                sample[k] = (total > 0.0) ? sample[k] / total : 0.0;
+        }
+        else if (sample != NULL)
+        {
+            /* Compute user+nice+system as a fraction of total. */
+            float cpu_uns = ticks_delta(cpu->user, prev->user) + ticks_delta(cpu->nice, prev->nice)
+                          + ticks_delta(cpu->system, prev->system);
+            float cpu_idle = ticks_delta(cpu->idle, prev->idle);
+            sample[0] = (cpu_uns + cpu_idle > 0.0) ? cpu_uns / (cpu_uns + cpu_idle) : 0.0;
+        }
+
+        /* Copy current to previous. */
+        memcpy(prev, cpu, sizeof(LXPanelCpuTicks));
+    }
+
+    /* Draw the new sample. */
+    if (sample != NULL)
+        panel_graph_commit_sample(graph);
 }
 
-/* Handler for expose_event on drawing area. */
-#if !GTK_CHECK_VERSION(3, 0, 0)
-static gboolean expose_event(GtkWidget * widget, GdkEventExpose * event, CPUPlugin * c)
-#else
-static gboolean draw(GtkWidget * widget, cairo_t * cr, CPUPlugin * c)
-#endif
+/* Number of values in each sample for mode, 0 if it's yet unknown. */
+static guint cpu_mode_stride(CPUPlugin * c)
 {
-    /* Draw the requested part of the pixmap onto the drawing area.
-     * Translate it in both x and y by the border size. */
-    if (c->pixmap != NULL)
+    switch (c->mode)
     {
-#if !GTK_CHECK_VERSION(3, 0, 0)
-        cairo_t * cr = gdk_cairo_create(gtk_widget_get_window(widget));
-        GtkStyle * style = gtk_widget_get_style(c->da);
-        gdk_cairo_region(cr, event->region);
-        cairo_clip(cr);
-        gdk_cairo_set_source_color(cr, &style->black);
-#else
-        cairo_set_source_rgb(cr, 0, 0, 0); // FIXME: use black color from style
-#endif
-        cairo_set_source_surface(cr, c->pixmap,
-              BORDER_SIZE, BORDER_SIZE);
-        cairo_paint(cr);
-        /* check_cairo_status(cr); */
-#if !GTK_CHECK_VERSION(3, 0, 0)
-        cairo_destroy(cr);
-#endif
+    case CPU_MODE_STATES:
+        return CPU_N_STATES;
+    case CPU_MODE_CORES:
+        return c->n_previous_cores;
+    default:
+        return 1;
     }
-    return FALSE;
+}
+
+/* Subscribe to statistics required for current mode. */
+static void cpu_subscribe(GtkWidget * p, CPUPlugin * c)
+{
+    if (c->sampler != 0)
+        lxpanel_sysstat_unsubscribe(c->sampler);
+    c->sampler = lxpanel_sysstat_subscribe(p, (c->mode == CPU_MODE_CORES) ?
+                                           LXPANEL_SYSSTAT_CPU_CORES : LXPANEL_SYSSTAT_CPU,
+                                           c->interval, cpu_update, c);
 }
 
 /* Plugin constructor. */
@@ -258,34 +306,39 @@ static GtkWidget *cpu_constructor(LXPanel *panel, config_setting_t *settings)
     /* Allocate plugin context and set into Plugin private data pointer. */
     CPUPlugin * c = g_new0(CPUPlugin, 1);
     GtkWidget * p;
+    int i;
+
+    /* Read config. */
+    c->settings = settings;
+    c->interval = UPDATE_PERIOD;
+    config_setting_lookup_int(settings, "DisplayMode", &c->mode);
+    config_setting_lookup_int(settings, "UpdateInterval", &c->interval);
+    if (c->mode < 0 || c->mode >= CPU_N_MODES)
+        c->mode = CPU_MODE_TOTAL;
+    if (c->interval < MIN_UPDATE_PERIOD)
+        c->interval = MIN_UPDATE_PERIOD;
 
     /* Allocate top level widget and set into Plugin widget pointer. */
     p = gtk_event_box_new();
     gtk_widget_set_has_window(p, FALSE);
     lxpanel_plugin_set_data(p, c, cpu_destructor);
 
-    /* Allocate drawing area as a child of top level widget. */
-    c->da = gtk_drawing_area_new();
+    /* Allocate graph as a child of top level widget. */
+    c->graph_mode = c->mode;
+    c->da = panel_graph_new(cpu_mode_stride(c), BORDER_SIZE, draw_sample, c);
     gtk_widget_add_events(c->da, GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
                                  GDK_BUTTON_MOTION_MASK);
     gtk_widget_set_size_request(c->da, 40, PANEL_HEIGHT_DEFAULT);
     gtk_container_add(GTK_CONTAINER(p), c->da);
 
-    /* Clone a graphics context and set "green" as its foreground color.
+    /* Set "green" as foreground color, and other colors for states.
      * We will use this to draw the graph. */
-    gdk_color_parse("green",  &c->foreground_color);
+    for (i = 0; i < CPU_N_STATES; i++)
+        gdk_color_parse(state_colors[i], &c->foreground_color[i]);
 
-    /* Connect signals. */
-    g_signal_connect(G_OBJECT(c->da), "configure-event", G_CALLBACK(configure_event), (gpointer) c);
-#if !GTK_CHECK_VERSION(3, 0, 0)
-    g_signal_connect(G_OBJECT(c->da), "expose-event", G_CALLBACK(expose_event), (gpointer) c);
-#else
-    g_signal_connect(G_OBJECT(c->da), "draw", G_CALLBACK(draw), (gpointer) c);
-#endif
-
-    /* Show the widget.  Connect a timer to refresh the statistics. */
+    /* Show the widget.  Subscribe to periodic statistics. */
     gtk_widget_show(c->da);
-    c->timer = g_timeout_add(1500, (GSourceFunc) cpu_update, (gpointer) c);
+    cpu_subscribe(p, c);
     return p;
 }
 
@@ -294,15 +347,87 @@ static void cpu_destructor(gpointer user_data)
 {
     CPUPlugin * c = (CPUPlugin *)user_data;
 
-    /* Disconnect the timer. */
-    g_source_remove(c->timer);
+    /* Stop receiving statistics. */
+    lxpanel_sysstat_unsubscribe(c->sampler);
 
     /* Deallocate memory. */
-    cairo_surface_destroy(c->pixmap);
-    g_free(c->stats_cpu);
+    g_free(c->previous_cores);
     g_free(c);
 }
 
+/* Callback when the configuration dialog has recorded a configuration change. */
+static gboolean cpu_apply_configuration(gpointer user_data)
+{
+    CPUPlugin * c = lxpanel_plugin_get_data(user_data);
+
+    if (c->interval < MIN_UPDATE_PERIOD)
+        c->interval = MIN_UPDATE_PERIOD;
+    config_group_set_int(c->settings, "DisplayMode", c->mode);
+    config_group_set_int(c->settings, "UpdateInterval", c->interval);
+
+    /* Start a new graph if mode was changed. */
+    if (c->mode != c->graph_mode)
+    {
+        panel_graph_set_n_values(PANEL_GRAPH(c->da), 0);
+        panel_graph_set_n_values(PANEL_GRAPH(c->da), cpu_mode_stride(c));
+        c->graph_mode = c->mode;
+    }
+    cpu_subscribe(user_data, c);
+    return FALSE;
+}
+
+static void cpu_mode_changed(GtkComboBox * combo, GtkWidget * p)
+{
+    CPUPlugin * c = lxpanel_plugin_get_data(p);
+    int mode = gtk_combo_box_get_active(combo);
+
+    if (mode < 0 || mode == c->mode)
+        return;
+    c->mode = mode;
+    c->restart = TRUE;
+    cpu_apply_configuration(p);
+}
+
+/* Selector of graph mode for the configuration dialog. */
+static GtkWidget *cpu_mode_selector_new(GtkWidget * p, CPUPlugin * c)
+{
+    GtkWidget * hbox = gtk_hbox_new(FALSE, 2);
+    GtkListStore * model = gtk_list_store_new(1, G_TYPE_STRING);
+    GtkWidget * combo;
+    GtkCellRenderer * cell;
+    GtkTreeIter it;
+    int i;
+
+    for (i = 0; i < CPU_N_MODES; i++)
+    {
+        gtk_list_store_append(model, &it);
+        gtk_list_store_set(model, &it, 0, _(mode_names[i]), -1);
+    }
+    combo = gtk_combo_box_new_with_model(GTK_TREE_MODEL(model));
+    g_object_unref(model);
+    cell = gtk_cell_renderer_text_new();
+    gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(combo), cell, TRUE);
+    gtk_cell_layout_add_attribute(GTK_CELL_LAYOUT(combo), cell, "text", 0);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), c->mode);
+    g_signal_connect(combo, "changed", G_CALLBACK(cpu_mode_changed), p);
+    gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new(_("Graph mode")), FALSE, FALSE, 2);
+    gtk_box_pack_start(GTK_BOX(hbox), combo, TRUE, TRUE, 2);
+    return hbox;
+}
+
+/* Callback when the configuration dialog is to be shown. */
+static GtkWidget *cpu_configure(LXPanel *panel, GtkWidget *p)
+{
+    CPUPlugin * c = lxpanel_plugin_get_data(p);
+
+    return lxpanel_generic_config_dlg(_("CPU Usage Monitor"), panel,
+        cpu_apply_configuration, p,
+        "", cpu_mode_selector_new(p, c), CONF_TYPE_EXTERNAL,
+        "", panel_config_int_button_new(_("Update interval (ms)"),
+                                        &c->interval, MIN_UPDATE_PERIOD, 10000), CONF_TYPE_EXTERNAL,
+        NULL);
+}
+
 FM_DEFINE_MODULE(lxpanel_gtk, cpu)
 
 /* Plugin descriptor. */
@@ -310,4 +435,5 @@ LXPanelPluginInit fm_module_init_lxpanel_gtk = {
     .name = N_("CPU Usage Monitor"),
     .description = N_("Display CPU usage"),
     .new_instance = cpu_constructor,
+    .config = cpu_configure,
 };
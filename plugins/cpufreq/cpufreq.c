@@ -29,6 +29,9 @@
 
 #include "plugin.h"
 #include "misc.h"
+#include "ticker.h"
+#include "sysfs.h"
+#include "graph.h"
 
 #include "dbg.h"
 
@@ -41,16 +44,39 @@
 #define SCALING_SETFREQ     "scaling_setspeed"
 #define SCALING_MAX         "scaling_max_freq"
 #define SCALING_MIN         "scaling_min_freq"
+#define CPUINFO_MAX         "cpuinfo_max_freq"
+#define CPUINFO_MIN         "cpuinfo_min_freq"
+
+#define HEATMAP_COLOR       "orange"
+#define BORDER_SIZE         2
+#define PANEL_HEIGHT_DEFAULT 26 /* from panel defaults */
+
+/* Cores which share a policy run at the same frequency, it is read once
+   for all of them. */
+typedef struct {
+    char *path;                 /* cpufreq directory of policy */
+    LXPanelSysfsAttr *cur_freq_attr;
+    guint n_cores;              /* number of cores in policy */
+    int min_freq, max_freq;     /* hardware limits, kHz */
+    int cur_freq;
+} CpufreqPolicy;
 
 
 typedef struct {
     GtkWidget *main;
+    GtkWidget *icon;
+    GtkWidget *graph;           /* heatmap of frequency of each core */
+    GdkColor heatmap_color;
     config_setting_t *settings;
     GList *governors;
-    GList *cpus;
+    CpufreqPolicy *policies;
+    guint n_policies;
+    guint n_cores;              /* total in all policies */
     int has_cpufreq;
+    gboolean show_heatmap;
     char* cur_governor;
     int   cur_freq;
+    LXPanelSysfsAttr *governor_attr;
     unsigned int timer;
     //gboolean remember;
 } cpufreq;
@@ -64,39 +90,31 @@ static void cpufreq_destructor(gpointer user_data);
 
 static void
 get_cur_governor(cpufreq *cf){
-    FILE *fp;
-    char buf[ 100 ], sstmp [ 256 ];
+    const char *governor;
 
-    snprintf(sstmp, sizeof(sstmp), "%s/%s", (char*)cf->cpus->data, SCALING_GOV);
-    if ((fp = fopen( sstmp, "r")) != NULL) {
-        if(cf->cur_governor)
-        {
-          g_free(cf->cur_governor);
-          cf->cur_governor = NULL;
-        }
-        if (fgets(buf, 100, fp))
-        {
-            buf[strlen(buf)-1] = '\0';
-            cf->cur_governor = strdup(buf);
-        }
-        fclose(fp);
+    if (cf->governor_attr == NULL)
+        return;
+    governor = lxpanel_sysfs_attr_read(cf->governor_attr);
+    if (governor == NULL)
+        return;
+    /* governor rarely changes so don't reallocate it each time */
+    if (cf->cur_governor == NULL || strcmp(cf->cur_governor, governor) != 0)
+    {
+        g_free(cf->cur_governor);
+        cf->cur_governor = g_strdup(governor);
     }
 }
 
 static void
 get_cur_freq(cpufreq *cf){
-    FILE *fp;
-    char buf[ 100 ], sstmp [ 256 ];
-
-    snprintf(sstmp, sizeof(sstmp), "%s/%s", (char*)cf->cpus->data, SCALING_CUR_FREQ);
-    if ((fp = fopen( sstmp, "r")) != NULL) {
-        if (fgets(buf, 100, fp))
-        {
-            buf[strlen(buf)-1] = '\0';
-            cf->cur_freq = atoi(buf);
-        }
-        fclose(fp);
-    }
+    gint64 freq;
+    guint i;
+
+    for (i = 0; i < cf->n_policies; i++)
+        if (lxpanel_sysfs_attr_read_int(cf->policies[i].cur_freq_attr, &freq))
+            cf->policies[i].cur_freq = freq;
+    if (cf->n_policies > 0)
+        cf->cur_freq = cf->policies[0].cur_freq;
 }
 
 /*static void
@@ -110,11 +128,11 @@ get_governors(cpufreq *cf){
 
     get_cur_governor(cf);
 
-    if(cf->cpus == NULL){
+    if(cf->n_policies == 0){
         cf->governors = NULL;
         return;
     }
-    sprintf(sstmp,"%s/%s",cf->cpus->data, SCALING_AGOV);
+    sprintf(sstmp,"%s/%s",cf->policies[0].path, SCALING_AGOV);
 
     if (!(fp = fopen( sstmp, "r"))) {
         printf("cpufreq: cannot open %s\n",sstmp);
@@ -144,7 +162,7 @@ cpufreq_set_freq(GtkWidget *widget, Param* p){
 
     if(strcmp(p->cf->cur_governor, "userspace")) return;
 
-    sprintf(sstmp,"%s/%s",p->cf->cpus->data, SCALING_SETFREQ);
+    sprintf(sstmp,"%s/%s",p->cf->policies[0].path, SCALING_SETFREQ);
     if ((fp = fopen( sstmp, "w")) != NULL) {
         fprintf(fp,"%s",p->data);
         fclose(fp);
@@ -157,7 +175,7 @@ frequency_menu(cpufreq *cf){
     Param* param;
     char buf[ 100 ], sstmp [ 256 ], c, bufl = 0;
 
-    sprintf(sstmp,"%s/%s",cf->cpus->data, SCALING_AFREQ);
+    sprintf(sstmp,"%s/%s",cf->policies[0].path, SCALING_AFREQ);
 
     if (!(fp = fopen( sstmp, "r"))) {
         printf("cpufreq: cannot open %s\n",sstmp);
@@ -191,41 +209,92 @@ frequency_menu(cpufreq *cf){
     return GTK_WIDGET(menu);
 }*/
 
+static int
+read_freq_once(const char *dir, const char *name)
+{
+    LXPanelSysfsAttr *attr = lxpanel_sysfs_attr_new(dir, name);
+    gint64 freq;
+    int result = 0;
+
+    if (lxpanel_sysfs_attr_read_int(attr, &freq))
+        result = freq;
+    lxpanel_sysfs_attr_free(attr);
+    return result;
+}
+
+static gint
+compare_cpu_numbers(gconstpointer a, gconstpointer b)
+{
+    return (gint)*(const guint *)a - (gint)*(const guint *)b;
+}
+
+/* Finds policies for all cores. On recent kernels cpu<n>/cpufreq is a
+   link to the policy directory so cores which share a policy have the
+   same real path of it. */
 static void
 get_cpus(cpufreq *cf)
 {
 
     const char *cpu;
     char cpu_path[100];
+    char *policy_path, *real_path;
+    GArray *numbers;
+    CpufreqPolicy *policy;
+    guint i, k;
 
     GDir * cpuDirectory = g_dir_open(SYSFS_CPU_DIRECTORY, 0, NULL);
     if (cpuDirectory == NULL)
     {
-        cf->cpus = NULL;
         printf("cpufreq: no cpu found\n");
         return;
     }
 
+    /* Sort cores so heatmap rows are in order. */
+    numbers = g_array_new(FALSE, FALSE, sizeof(guint));
     while ((cpu = g_dir_read_name(cpuDirectory)))
     {
         /* Look for directories of the form "cpu<n>", where "<n>" is a decimal integer. */
         if ((strncmp(cpu, "cpu", 3) == 0) && (cpu[3] >= '0') && (cpu[3] <= '9'))
         {
-            snprintf(cpu_path, sizeof(cpu_path), "%s/%s/cpufreq", SYSFS_CPU_DIRECTORY, cpu);
+            guint n = atoi(&cpu[3]);
+            g_array_append_val(numbers, n);
+        }
+    }
+    g_dir_close(cpuDirectory);
+    g_array_sort(numbers, compare_cpu_numbers);
 
-            GDir * cpufreqDir = g_dir_open(SYSFS_CPU_DIRECTORY, 0, NULL);
-            if (cpufreqDir == NULL)
-            {
-                cf->cpus = NULL;
-                cf->has_cpufreq = 0;
+    for (i = 0; i < numbers->len; i++)
+    {
+        snprintf(cpu_path, sizeof(cpu_path), "%s/cpu%u/cpufreq", SYSFS_CPU_DIRECTORY,
+                 g_array_index(numbers, guint, i));
+        if (!g_file_test(cpu_path, G_FILE_TEST_IS_DIR))
+            continue;
+        cf->has_cpufreq = 1;
+        /* CPUs which share a policy have links to the same directory */
+        real_path = realpath(cpu_path, NULL);
+        policy_path = g_strdup(real_path ? real_path : cpu_path);
+        free(real_path);
+
+        for (k = 0; k < cf->n_policies; k++)
+            if (strcmp(cf->policies[k].path, policy_path) == 0)
                 break;
-            }
-
-            cf->has_cpufreq = 1;
-            cf->cpus = g_list_append(cf->cpus, strdup(cpu_path));
+        cf->n_cores++;
+        if (k < cf->n_policies)
+        {
+            cf->policies[k].n_cores++;
+            g_free(policy_path);
+            continue;
         }
+        cf->policies = g_renew(CpufreqPolicy, cf->policies, cf->n_policies + 1);
+        policy = &cf->policies[cf->n_policies++];
+        policy->path = policy_path;
+        policy->cur_freq_attr = lxpanel_sysfs_attr_new(policy->path, SCALING_CUR_FREQ);
+        policy->n_cores = 1;
+        policy->min_freq = read_freq_once(policy->path, CPUINFO_MIN);
+        policy->max_freq = read_freq_once(policy->path, CPUINFO_MAX);
+        policy->cur_freq = 0;
     }
-    g_dir_close(cpuDirectory);
+    g_array_free(numbers, TRUE);
 }
 
 /*static void
@@ -233,7 +302,7 @@ cpufreq_set_governor(GtkWidget *widget, Param* p){
     FILE *fp;
     char buf[ 100 ], sstmp [ 256 ];
 
-    sprintf(sstmp, "%s/%s", p->cf->cpus->data, SCALING_GOV);
+    sprintf(sstmp, "%s/%s", p->cf->policies[0].path, SCALING_GOV);
     if ((fp = fopen( sstmp, "w")) != NULL) {
         fprintf(fp,"%s",p->data);
         fclose(fp);
@@ -322,45 +391,152 @@ _update_tooltip(cpufreq *cf)
 
     ENTER;
 
-    tooltip = g_strdup_printf(_("Frequency: %d MHz\nGovernor: %s"),
-                              cf->cur_freq / 1000, cf->cur_governor);
+    if (cf->n_policies > 1)
+    {
+        int min = G_MAXINT, max = 0;
+        gint64 sum = 0;
+        guint i;
+
+        for (i = 0; i < cf->n_policies; i++)
+        {
+            min = MIN(min, cf->policies[i].cur_freq);
+            max = MAX(max, cf->policies[i].cur_freq);
+            sum += (gint64)cf->policies[i].cur_freq * cf->policies[i].n_cores;
+        }
+        tooltip = g_strdup_printf(_("Frequency: %d MHz (min %d, max %d MHz)\nGovernor: %s"),
+                                  (int)(sum / cf->n_cores / 1000), min / 1000,
+                                  max / 1000, cf->cur_governor);
+    }
+    else
+        tooltip = g_strdup_printf(_("Frequency: %d MHz\nGovernor: %s"),
+                                  cf->cur_freq / 1000, cf->cur_governor);
     gtk_widget_set_tooltip_text(cf->main, tooltip);
     g_free(tooltip);
     RET(TRUE);
 }
 
+/* Adds a column to heatmap, row of each core is brighter if it runs closer
+   to its maximum frequency. */
+static void
+update_heatmap(cpufreq *cf)
+{
+    PanelGraph *graph = PANEL_GRAPH(cf->graph);
+    CpufreqPolicy *policy;
+    gfloat *sample, value;
+    guint i, k, n = 0;
+
+    sample = panel_graph_new_sample(graph);
+    if (sample == NULL)
+        return;
+    for (i = 0; i < cf->n_policies; i++)
+    {
+        policy = &cf->policies[i];
+        if (policy->max_freq > policy->min_freq)
+            value = CLAMP((gfloat)(policy->cur_freq - policy->min_freq) /
+                          (policy->max_freq - policy->min_freq), 0.0, 1.0);
+        else
+            value = 0.0;
+        for (k = 0; k < policy->n_cores; k++)
+            sample[n++] = value;
+    }
+    panel_graph_commit_sample(graph);
+}
+
+/* Draws a column, if there are more cores than pixels in height then each
+   row shows the fastest of cores it covers. */
+static void
+draw_heatmap(cairo_t *cr, gint x, gint height, const gfloat *values,
+             guint n_values, gpointer user_data)
+{
+    cpufreq *cf = user_data;
+    GdkColor *color = &cf->heatmap_color;
+    guint rows = MIN(n_values, (guint)height);
+    guint row, k;
+
+    for (row = 0; row < rows; row++)
+    {
+        guint y0 = row * height / rows;
+        guint y1 = (row + 1) * height / rows;
+        gfloat value = 0.0;
+        for (k = row * n_values / rows; k < (row + 1) * n_values / rows; k++)
+            value = MAX(value, values[k]);
+        if (value == 0.0)
+            continue;
+        cairo_set_source_rgb(cr, value * color->red / 65535.0,
+                             value * color->green / 65535.0,
+                             value * color->blue / 65535.0);
+        cairo_rectangle(cr, x, y0, 1, y1 - y0);
+        cairo_fill(cr);
+    }
+}
+
+/* Shows either icon or heatmap. */
+static void
+cpufreq_set_mode(cpufreq *cf)
+{
+    if (cf->show_heatmap && cf->n_cores > 0)
+    {
+        gtk_widget_hide(cf->icon);
+        gtk_widget_show(cf->graph);
+    }
+    else
+    {
+        gtk_widget_hide(cf->graph);
+        gtk_widget_show(cf->icon);
+    }
+}
+
 static gboolean update_tooltip(gpointer user_data)
 {
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
-    return _update_tooltip(user_data);
+    cpufreq *cf = user_data;
+
+    _update_tooltip(cf);
+    if (cf->show_heatmap && cf->n_cores > 0)
+        update_heatmap(cf);
+    return TRUE;
 }
 
 static GtkWidget *cpufreq_constructor(LXPanel *panel, config_setting_t *settings)
 {
     cpufreq *cf;
-    //GtkWidget *button;
+    GtkWidget *box;
+    int tmp_int;
 
     ENTER;
     cf = g_new0(cpufreq, 1);
     g_return_val_if_fail(cf != NULL, NULL);
     cf->governors = NULL;
-    cf->cpus = NULL;
     cf->settings = settings;
+    if (config_setting_lookup_int(settings, "ShowHeatmap", &tmp_int))
+        cf->show_heatmap = (tmp_int != 0);
 
-    cf->main = lxpanel_button_new_for_icon(panel, PROC_ICON, NULL, NULL);
+    cf->main = gtk_event_box_new();
+    gtk_widget_set_has_window(cf->main, FALSE);
     lxpanel_plugin_set_data(cf->main, cf, cpufreq_destructor);
+    box = gtk_hbox_new(FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(cf->main), box);
+    gtk_widget_show(box);
 
     cf->has_cpufreq = 0;
 
     get_cpus(cf);
+    if (cf->n_policies > 0)
+        cf->governor_attr = lxpanel_sysfs_attr_new(cf->policies[0].path, SCALING_GOV);
+
+    cf->icon = lxpanel_button_new_for_icon(panel, PROC_ICON, NULL, NULL);
+    gtk_box_pack_start(GTK_BOX(box), cf->icon, FALSE, FALSE, 0);
+    gdk_color_parse(HEATMAP_COLOR, &cf->heatmap_color);
+    cf->graph = panel_graph_new(cf->n_cores, BORDER_SIZE, draw_heatmap, cf);
+    gtk_widget_set_size_request(cf->graph, 40, PANEL_HEIGHT_DEFAULT);
+    gtk_box_pack_start(GTK_BOX(box), cf->graph, FALSE, FALSE, 0);
+    cpufreq_set_mode(cf);
 
     //if (config_setting_lookup_int(settings, "Remember", &tmp_int)) cf->remember = tmp_int != 0;
     //if (config_setting_lookup_int(settings, "Governor", &tmp_str)) cf->cur_governor = g_strdup(tmp_str);
     //config_setting_lookup_int(settings, "Frequency", &cf->cur_freq);
 
     _update_tooltip(cf);
-    cf->timer = g_timeout_add_seconds(2, update_tooltip, (gpointer)cf);
+    cf->timer = lxpanel_tick_add(cf->main, 2000, update_tooltip, cf);
 
     RET(cf->main);
 }
@@ -383,13 +559,40 @@ static GtkWidget *config(LXPanel *panel, GtkWidget *p, GtkWindow *parent)
 }
 */
 
+static gboolean cpufreq_apply_config(gpointer user_data)
+{
+    cpufreq *cf = lxpanel_plugin_get_data(user_data);
+
+    config_group_set_int(cf->settings, "ShowHeatmap", cf->show_heatmap);
+    cpufreq_set_mode(cf);
+    return FALSE;
+}
+
+static GtkWidget *cpufreq_config(LXPanel *panel, GtkWidget *p)
+{
+    cpufreq *cf = lxpanel_plugin_get_data(p);
+    return lxpanel_generic_config_dlg(_("CPUFreq frontend"), panel,
+            cpufreq_apply_config, p,
+            _("Show frequency of each core"), &cf->show_heatmap, CONF_TYPE_BOOL,
+            NULL);
+}
+
 static void
 cpufreq_destructor(gpointer user_data)
 {
     cpufreq *cf = (cpufreq *)user_data;
-    g_list_free ( cf->cpus );
+    guint i;
+
+    for (i = 0; i < cf->n_policies; i++)
+    {
+        g_free(cf->policies[i].path);
+        lxpanel_sysfs_attr_free(cf->policies[i].cur_freq_attr);
+    }
+    g_free(cf->policies);
     g_list_free ( cf->governors );
-    g_source_remove(cf->timer);
+    lxpanel_tick_remove(cf->timer);
+    lxpanel_sysfs_attr_free(cf->governor_attr);
+    g_free(cf->cur_governor);
     g_free(cf);
 }
 
@@ -402,6 +605,6 @@ LXPanelPluginInit fm_module_init_lxpanel_gtk = {
     .description = N_("Display CPU frequency and allow to change governors and frequency"),
 
     .new_instance = cpufreq_constructor,
-    //.config      = config,
+    .config = cpufreq_config,
     .button_press_event = clicked
 };
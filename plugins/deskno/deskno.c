@@ -68,7 +68,7 @@ static void deskno_redraw(GtkWidget * widget, DesknoPlugin * dc)
     dc->number_of_desktops = get_net_number_of_desktops();
     int number_of_desktop_names;
     char * * desktop_names;
-    desktop_names = get_utf8_property_list(GDK_ROOT_WINDOW(), a_NET_DESKTOP_NAMES, &number_of_desktop_names);
+    desktop_names = fb_ev_desktop_names(fbev, &number_of_desktop_names);
 
     /* Reallocate the vector of labels. */
     if (dc->desktop_labels != NULL)
@@ -84,10 +84,6 @@ static void deskno_redraw(GtkWidget * widget, DesknoPlugin * dc)
     for ( ; i < dc->number_of_desktops; i++)
         dc->desktop_labels[i] = g_strdup_printf("%d", i + 1);
 
-    /* Free the property. */
-    if (desktop_names != NULL)
-        g_strfreev(desktop_names);
-
     /* Redraw the label. */
     deskno_name_update(widget, dc);
 }
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* _NET_WM_ICON to RGBA conversion kernels, shared by taskbar and benchmark */
+
+#ifndef __ICON_ARGB_H__
+#define __ICON_ARGB_H__ 1
+
+#include <glib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+G_BEGIN_DECLS
+
+/* Converts one ARGB pixel into RGBA bytes order, as 32-bit value */
+static inline guint32 argb_to_rgba(guint32 argb)
+{
+    return GUINT32_TO_LE((argb & 0xff00ff00) | ((argb & 0xff) << 16) | ((argb >> 16) & 0xff));
+}
+
+static inline void icon_argb_to_rgba_scalar(const gulong *src, guint32 *dst, gulong len)
+{
+    gulong i;
+
+    for (i = 0; i < len; i++)
+        dst[i] = argb_to_rgba(src[i]);
+}
+
+#ifdef __SSE2__
+/* Packs 4 pixels from two vectors on each step if longs are 8 bytes */
+static inline void icon_argb_to_rgba_sse2(const gulong *src, guint32 *dst, gulong len)
+{
+    const __m128i mask_ga = _mm_set1_epi32(0xff00ff00);
+    const __m128i mask_rb = _mm_set1_epi32(0x00ff00ff);
+    gulong i;
+
+    for (i = 0; i + 4 <= len; i += 4)
+    {
+        __m128i argb, rb;
+#if GLIB_SIZEOF_LONG == 8
+        __m128i lo = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i hi = _mm_loadu_si128((const __m128i *)&src[i + 2]);
+
+        /* move low halves of each long into lower 64 bits and combine them */
+        lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+        hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+        argb = _mm_unpacklo_epi64(lo, hi);
+#else
+        argb = _mm_loadu_si128((const __m128i *)&src[i]);
+#endif
+        /* swap R and B bytes, keep G and A in place */
+        rb = _mm_and_si128(argb, mask_rb);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        argb = _mm_or_si128(_mm_and_si128(argb, mask_ga), rb);
+        _mm_storeu_si128((__m128i *)&dst[i], argb);
+    }
+    icon_argb_to_rgba_scalar(&src[i], &dst[i], len - i);
+}
+#endif
+
+/* Converts _NET_WM_ICON data into RGBA pixels. Since X returns format 32
+ * data as array of long, on 64-bit systems each pixel is padded to 8 bytes. */
+static inline void icon_argb_to_rgba(const gulong *src, guint32 *dst, gulong len)
+{
+#ifdef __SSE2__
+    icon_argb_to_rgba_sse2(src, dst, len);
+#else
+    icon_argb_to_rgba_scalar(src, dst, len);
+#endif
+}
+
+G_END_DECLS
+
+#endif
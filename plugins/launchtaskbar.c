@@ -104,6 +104,15 @@ typedef enum {
 
 typedef struct LaunchTaskBarPlugin LaunchTaskBarPlugin;
 
+/* Window property change, waiting to be processed */
+typedef struct {
+    Window win;
+    Atom atom;
+} TaskbarXprop;
+
+/* Minimal interval between processing of property changes, in milliseconds */
+#define TASKBAR_XPROPS_INTERVAL 40
+
 /* Private context for taskbar plugin. */
 struct LaunchTaskBarPlugin {
     /* LAUNCHBAR */
@@ -129,6 +138,12 @@ struct LaunchTaskBarPlugin {
     int spacing;                   /* Spacing between taskbar buttons */
     guint flash_timeout;        /* Timer for urgency notification */
     gboolean flash_state;       /* One-bit counter to flash taskbar */
+    GHashTable *client_list;    /* Last known NET_CLIENT_LIST, set of windows */
+    GQueue xprops_queue;        /* Changed window properties, in order of events */
+    GHashTable *xprops_set;     /* The same properties, to add each one only once */
+    guint xprops_flush;         /* Source to process changed properties */
+    guint xprops_events;        /* Statistics: PropertyNotify events received */
+    guint xprops_handled;       /* Statistics: properties actually processed */
     /* COMMON */
 #ifndef DISABLE_MENU
     FmPath * path;              /* Current menu item path */
@@ -180,6 +195,8 @@ static void taskbar_net_current_desktop(GtkWidget * widget, LaunchTaskBarPlugin
 static void taskbar_net_number_of_desktops(GtkWidget * widget, LaunchTaskBarPlugin * tb);
 static void taskbar_net_active_window(GtkWidget * widget, LaunchTaskBarPlugin * tb);
 static GdkFilterReturn taskbar_event_filter(XEvent * xev, GdkEvent * event, LaunchTaskBarPlugin * tb);
+static guint taskbar_xprop_hash(gconstpointer key);
+static gboolean taskbar_xprop_equal(gconstpointer a, gconstpointer b);
 static void taskbar_window_manager_changed(GdkScreen * screen, LaunchTaskBarPlugin * tb);
 static void taskbar_apply_configuration(LaunchTaskBarPlugin * ltbp);
 static void taskbar_add_task_button(LaunchTaskBarPlugin * tb, TaskButton * task);
@@ -1001,6 +1018,7 @@ static void launchtaskbar_constructor_task(LaunchTaskBarPlugin *ltbp)
         gint tmp_int;
 
         ltbp->tb_built = TRUE;
+        ltbp->xprops_set = g_hash_table_new(taskbar_xprop_hash, taskbar_xprop_equal);
 
         /* Parse configuration now */
         if (config_setting_lookup_int(s, "tooltips", &tmp_int))
@@ -1210,6 +1228,16 @@ static void launchtaskbar_destructor_task(LaunchTaskBarPlugin *ltbp)
     }
     if (ltbp->dnd_delay_task)
         g_object_remove_weak_pointer(G_OBJECT(ltbp->dnd_delay_task), (gpointer *)&ltbp->dnd_delay_task);
+
+    if (ltbp->client_list)
+        g_hash_table_destroy(ltbp->client_list);
+
+    /* Drop unprocessed property changes */
+    if (ltbp->xprops_flush != 0)
+        g_source_remove(ltbp->xprops_flush);
+    while (!g_queue_is_empty(&ltbp->xprops_queue))
+        g_slice_free(TaskbarXprop, g_queue_pop_head(&ltbp->xprops_queue));
+    g_hash_table_destroy(ltbp->xprops_set);
 }
 
 /* Plugin destructor. */
@@ -1920,48 +1948,45 @@ static gboolean accept_net_wm_window_type(NetWMWindowType * nwwt)
     return ( ! ((nwwt->desktop) || (nwwt->dock) || (nwwt->splash)));
 }
 
+/* Evaluate window state and window type to see if it should be in task list. */
+static gboolean accept_window(Window win)
+{
+    NetWMWindowType nwwt;
+    NetWMState nws;
+
+    get_net_wm_state(win, &nws);
+    if (!accept_net_wm_state(&nws))
+        return FALSE;
+    get_net_wm_window_type(win, &nwwt);
+    return accept_net_wm_window_type(&nwwt);
+}
+
 /* Set the class associated with a task. */
 static char *task_get_class(Window win)
 {
-    /* Read the WM_CLASS property. */
-    XClassHint ch;
-    ch.res_name = NULL;
-    ch.res_class = NULL;
-    char *res_class = NULL;
-    XGetClassHint(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, &ch);
-
-    /* If the res_name was returned, free it.  We make no use of it at this time. */
-    if (ch.res_name != NULL)
-    {
-        XFree(ch.res_name);
-    }
+    /* Read the WM_CLASS property.  It contains res_name and res_class as two
+     * consecutive strings, parse it the same way as XGetClassHint() does. */
+    int len, name_len;
+    char *data = get_xaproperty(win, XA_WM_CLASS, XA_STRING, &len);
+    char *res_class;
 
-    /* If the res_class was returned, process it.
-     * This identifies the application that created the window and is the basis for taskbar grouping. */
-    if (ch.res_class != NULL)
-    {
-        /* Convert the class to UTF-8 and enter it in the class table. */
-        res_class = g_locale_to_utf8(ch.res_class, -1, NULL, NULL, NULL);
-        XFree(ch.res_class);
-    }
+    if (data == NULL)
+        return NULL;
+    name_len = strlen(data);
+    if (name_len == len)
+        name_len--;
+
+    /* The res_class identifies the application that created the window and is the basis for taskbar grouping.
+     * We make no use of res_name at this time.  Convert the class to UTF-8. */
+    res_class = g_locale_to_utf8(data + name_len + 1, -1, NULL, NULL, NULL);
+    XFree(data);
     return res_class;
 }
 
 /* Look up a task in the task list. */
 static TaskButton *task_lookup(LaunchTaskBarPlugin * tb, Window win)
 {
-    TaskButton *task = NULL;
-    GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
-    GList *l;
-
-    for (l = children; l; l = l->next)
-        if (task_button_has_window(l->data, win))
-        {
-            task = l->data;
-            break;
-        }
-    g_list_free(children);
-    return task;
+    return task_button_lookup(tb->tb_icon_grid, win);
 }
 
 
@@ -2171,8 +2196,9 @@ static void taskbar_add_task_button(LaunchTaskBarPlugin * tb, TaskButton * task)
                            G_CALLBACK(taskbar_button_enter), tb);
 }
 
-/* add win to tb, using list of task buttons */
-static void taskbar_add_new_window(LaunchTaskBarPlugin * tb, Window win, GList *list)
+/* add win to tb, using list of task buttons
+   returns new button if none from list accepted the window */
+static TaskButton *taskbar_add_new_window(LaunchTaskBarPlugin * tb, Window win, GList *list)
 {
     gchar *res_class = task_get_class(win);
     TaskButton *task;
@@ -2183,11 +2209,31 @@ static void taskbar_add_new_window(LaunchTaskBarPlugin * tb, Window win, GList *
         if (task_button_add_window(list->data, win, res_class))
             break;
     if (list != NULL)
-        return; /* some button accepted it, done */
+    {
+        g_free(res_class);
+        return NULL; /* some button accepted it, done */
+    }
 
     task = task_button_new(win, tb->current_desktop, tb->number_of_desktops,
                            tb->panel, res_class, tb->flags);
+    g_free(res_class);
     taskbar_add_task_button(tb, task);
+    return task;
+}
+
+/* new windows should be watched for state changes even if not accepted */
+static void taskbar_watch_window(Window win)
+{
+    GdkDisplay *display = gdk_display_get_default();
+
+    /* see task_details_for_window() for event mask details */
+#if GTK_CHECK_VERSION(2, 24, 0)
+    if (!gdk_x11_window_lookup_for_display(display, win))
+#else
+    if (!gdk_window_lookup(win))
+#endif
+        XSelectInput(GDK_DISPLAY_XDISPLAY(display), win,
+                     PropertyChangeMask | StructureNotifyMask);
 }
 
 /*****************************************************
@@ -2202,51 +2248,88 @@ static void taskbar_net_client_list(GtkWidget * widget, LaunchTaskBarPlugin * tb
 
     /* Get the NET_CLIENT_LIST property. */
     int client_count;
-    Window * client_list = get_xaproperty(GDK_ROOT_WINDOW(), a_NET_CLIENT_LIST, XA_WINDOW, &client_count);
+    Window * client_list = fb_ev_client_list(fbev, &client_count);
     if (client_list != NULL)
     {
-        GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid)), *l;
-        /* Remove windows from the task list that are not present in the NET_CLIENT_LIST. */
-        for (l = children; l; l = l->next)
-            task_button_update_windows_list(l->data, client_list, client_count);
-        g_list_free(children);
-        children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
-        /* Loop over client list, correlating it with task list. */
-        int i;
-        for (i = 0; i < client_count; i++)
+        GHashTable *old_list = tb->client_list;
+        GList *children = NULL;
+        GHashTableIter iter;
+        gpointer key;
+        TaskButton *task;
+        Window *added;
+        int i, n_added;
+
+        /* Move windows that are still present into new snapshot, so only
+           removed windows are left in the old one. */
+        tb->client_list = g_hash_table_new(g_direct_hash, NULL);
+        if (old_list != NULL)
         {
-            /* Search for the window in the task list.  Set up context to do an insert right away if needed. */
-            for (l = children; l; l = l->next)
+            for (i = 0; i < client_count; i++)
             {
-                if (task_button_has_window(l->data, client_list[i]))
-                    break;
+                key = GUINT_TO_POINTER(client_list[i]);
+                if (g_hash_table_remove(old_list, key))
+                    g_hash_table_insert(tb->client_list, key, key);
             }
+            /* Remove windows from the task list that are not present in the NET_CLIENT_LIST. */
+            g_hash_table_iter_init(&iter, old_list);
+            while (g_hash_table_iter_next(&iter, &key, NULL))
+            {
+                task = task_lookup(tb, GPOINTER_TO_UINT(key));
+                if (task != NULL)
+                    task_button_drop_window(task, GPOINTER_TO_UINT(key), FALSE);
+            }
+            g_hash_table_destroy(old_list);
+        }
 
-            /* Task is not in task list. */
-            if (l == NULL)
+        /* Loop over client list, collecting windows which weren't seen before. */
+        added = g_new(Window, client_count);
+        n_added = 0;
+        for (i = 0; i < client_count; i++)
+        {
+            key = GUINT_TO_POINTER(client_list[i]);
+            if (g_hash_table_lookup(tb->client_list, key) != NULL)
+                continue;
+            g_hash_table_insert(tb->client_list, key, key);
+            if (task_lookup(tb, client_list[i]) == NULL)
+                added[n_added++] = client_list[i];
+        }
+
+        if (n_added > 0)
+        {
+            /* Properties which are needed to evaluate and set up new task. */
+            Atom props[] = { a_NET_WM_STATE, a_NET_WM_WINDOW_TYPE, XA_WM_CLASS,
+                             a_NET_WM_DESKTOP, a_NET_WM_VISIBLE_NAME, a_NET_WM_NAME,
+                             XA_WM_NAME, XA_WM_HINTS, a_WM_STATE };
+
+            /* Select events first so no change will be lost, then request
+               properties for all new windows at once. */
+            for (i = 0; i < n_added; i++)
+                taskbar_watch_window(added[i]);
+            lxpanel_xprop_prefetch(added, n_added, props, G_N_ELEMENTS(props));
+            children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+            for (i = 0; i < n_added; i++)
             {
-                /* Evaluate window state and window type to see if it should be in task list. */
-                NetWMWindowType nwwt;
-                NetWMState nws;
-                get_net_wm_state(client_list[i], &nws);
-                get_net_wm_window_type(client_list[i], &nwwt);
-                if ((accept_net_wm_state(&nws))
-                && (accept_net_wm_window_type(&nwwt)))
+                if (accept_window(added[i]))
                 {
                     /* Allocate and initialize new task structure. */
-                    taskbar_add_new_window(tb, client_list[i], children);
-                    g_list_free(children);
-                    children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+                    task = taskbar_add_new_window(tb, added[i], children);
+                    if (task != NULL)
+                        children = g_list_prepend(children, task);
                 }
             }
+            g_list_free(children);
+            lxpanel_xprop_prefetch_done();
         }
-        g_list_free(children);
-        XFree(client_list);
+        g_free(added);
     }
 
     else /* clear taskbar */
+    {
         gtk_container_foreach(GTK_CONTAINER(tb->tb_icon_grid),
                               (GtkCallback)gtk_widget_destroy, NULL);
+        if (tb->client_list)
+            g_hash_table_remove_all(tb->client_list);
+    }
 }
 
 /* Handler for "current-desktop" event from root window listener. */
@@ -2279,72 +2362,142 @@ static void taskbar_net_active_window(GtkWidget * widget, LaunchTaskBarPlugin *
     if(ltbp->mode == LAUNCHBAR) return;
 
     /* Get the window that has focus. */
-    Window * f = get_xaproperty(GDK_ROOT_WINDOW(), a_NET_ACTIVE_WINDOW, XA_WINDOW, 0);
+    Window * f = fb_ev_active_window(fbev);
 
     gtk_container_foreach(GTK_CONTAINER(tb->tb_icon_grid),
                           (GtkCallback)task_button_window_focus_changed, f);
-    if (f != NULL)
-        XFree(f);
 }
 
-/* Handle PropertyNotify event.
+/* Handle window property change.
  * http://tronche.com/gui/x/icccm/
  * http://standards.freedesktop.org/wm-spec/wm-spec-1.4.html */
-static void taskbar_property_notify_event(LaunchTaskBarPlugin *tb, XEvent *ev)
+static void taskbar_window_xprop_changed(LaunchTaskBarPlugin *tb, Window win, Atom at)
 {
-    /* State may be PropertyNewValue, PropertyDeleted. */
-    if (((XPropertyEvent*) ev)->state == PropertyNewValue)
+    /* Look up task structure by X window handle. */
+    TaskButton * tk = task_lookup(tb, win);
+    if (tk == NULL)
     {
-        Atom at = ev->xproperty.atom;
-        Window win = ev->xproperty.window;
-        if (win != GDK_ROOT_WINDOW())
+        /* Window which was not accepted may become acceptable. */
+        if ((at == a_NET_WM_STATE || at == a_NET_WM_WINDOW_TYPE)
+            && tb->client_list != NULL
+            && g_hash_table_lookup(tb->client_list, GUINT_TO_POINTER(win)) != NULL
+            && accept_window(win))
         {
-            /* Look up task structure by X window handle. */
-            TaskButton * tk = task_lookup(tb, win);
-            if (tk != NULL)
-            {
-                /* Install an error handler that ignores BadWindow.
-                 * We frequently get a PropertyNotify event on deleted windows. */
-                XErrorHandler previous_error_handler = XSetErrorHandler(panel_handle_x_error_swallow_BadWindow_BadDrawable);
+            GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+            taskbar_add_new_window(tb, win, children);
+            g_list_free(children);
+        }
+    }
+    /* Dispatch on atom. */
+    else if (at == a_NET_WM_STATE)
+    {
+        /* Window changed EWMH state. */
+        NetWMState nws;
+        get_net_wm_state(win, &nws);
+        if ( ! accept_net_wm_state(&nws))
+            task_button_drop_window(tk, win, FALSE);
+        /* else
+            task_button_window_state_changed(tk, win, nws); */
+    }
+    else if (at == a_NET_WM_WINDOW_TYPE)
+    {
+        /* Window changed EWMH window type. */
+        NetWMWindowType nwwt;
+        get_net_wm_window_type(win, &nwwt);
+        if ( ! accept_net_wm_window_type(&nwwt))
+            task_button_drop_window(tk, win, FALSE);
+    }
+    else if (at == XA_WM_CLASS && tb->grouped_tasks
+             && task_button_drop_window(tk, win, TRUE))
+    {
+        GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
+        /* if Window was not single window of that class then
+           add it to another class or make another button */
+        taskbar_add_new_window(tb, win, children);
+        g_list_free(children);
+    }
+    else
+    {
+        /* simply notify button, it will handle the event */
+        task_button_window_xprop_changed(tk, win, at);
+    }
+}
 
-                /* Dispatch on atom. */
-                if (at == a_NET_WM_STATE)
-                {
-                    /* Window changed EWMH state. */
-                    NetWMState nws;
-                    get_net_wm_state(win, &nws);
-                    if ( ! accept_net_wm_state(&nws))
-                        task_button_drop_window(tk, win, FALSE);
-                    /* else
-                        task_button_window_state_changed(tk, win, nws); */
-                }
-                else if (at == a_NET_WM_WINDOW_TYPE)
-                {
-                    /* Window changed EWMH window type. */
-                    NetWMWindowType nwwt;
-                    get_net_wm_window_type(win, &nwwt);
-                    if ( ! accept_net_wm_window_type(&nwwt))
-                        task_button_drop_window(tk, win, FALSE);
-                }
-                else if (at == XA_WM_CLASS && tb->grouped_tasks
-                         && task_button_drop_window(tk, win, TRUE))
-                {
-                    GList *children = gtk_container_get_children(GTK_CONTAINER(tb->tb_icon_grid));
-                    /* if Window was not single window of that class then
-                       add it to another class or make another button */
-                    taskbar_add_new_window(tb, win, children);
-                    g_list_free(children);
-                }
-                else
-                {
-                    /* simply notify button, it will handle the event */
-                    task_button_window_xprop_changed(tk, win, at);
-                }
+static guint taskbar_xprop_hash(gconstpointer key)
+{
+    const TaskbarXprop *xprop = key;
 
-                XSetErrorHandler(previous_error_handler);
-            }
-        }
+    return (guint)xprop->win * 31 + (guint)xprop->atom;
+}
+
+static gboolean taskbar_xprop_equal(gconstpointer a, gconstpointer b)
+{
+    const TaskbarXprop *xprop_a = a, *xprop_b = b;
+
+    return (xprop_a->win == xprop_b->win && xprop_a->atom == xprop_b->atom);
+}
+
+/* Process all queued property changes, each property only once */
+static gboolean taskbar_flush_xprops(gpointer user_data)
+{
+    LaunchTaskBarPlugin *tb = user_data;
+    XErrorHandler previous_error_handler;
+    TaskbarXprop *xprop;
+    guint n = 0;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    tb->xprops_flush = 0;
+    if (g_queue_is_empty(&tb->xprops_queue))
+        return FALSE;
+
+    /* Install an error handler that ignores BadWindow.
+     * We frequently get a PropertyNotify event on deleted windows. */
+    previous_error_handler = XSetErrorHandler(panel_handle_x_error_swallow_BadWindow_BadDrawable);
+    while ((xprop = g_queue_pop_head(&tb->xprops_queue)) != NULL)
+    {
+        g_hash_table_remove(tb->xprops_set, xprop);
+        taskbar_window_xprop_changed(tb, xprop->win, xprop->atom);
+        g_slice_free(TaskbarXprop, xprop);
+        n++;
     }
+    XSetErrorHandler(previous_error_handler);
+
+    tb->xprops_handled += n;
+    g_debug("taskbar: processed %u property changes, %u of %u events coalesced in total",
+            n, tb->xprops_events - tb->xprops_handled, tb->xprops_events);
+
+    /* Changes that come too often will be processed once per interval. */
+    tb->xprops_flush = g_timeout_add_full(G_PRIORITY_HIGH_IDLE,
+                                          TASKBAR_XPROPS_INTERVAL,
+                                          taskbar_flush_xprops, tb, NULL);
+    return FALSE;
+}
+
+/* Handle PropertyNotify event: queue the change so if it is repeated
+ * before it's processed then the property will be fetched only once. */
+static void taskbar_property_notify_event(LaunchTaskBarPlugin *tb, XEvent *ev)
+{
+    TaskbarXprop key, *xprop;
+
+    /* State may be PropertyNewValue, PropertyDeleted. */
+    if (((XPropertyEvent*) ev)->state != PropertyNewValue)
+        return;
+    key.win = ev->xproperty.window;
+    key.atom = ev->xproperty.atom;
+    if (key.win == GDK_ROOT_WINDOW())
+        return;
+
+    tb->xprops_events++;
+    if (g_hash_table_lookup(tb->xprops_set, &key) != NULL)
+        return;
+    xprop = g_slice_new(TaskbarXprop);
+    *xprop = key;
+    g_queue_push_tail(&tb->xprops_queue, xprop);
+    g_hash_table_insert(tb->xprops_set, xprop, xprop);
+    if (tb->xprops_flush == 0)
+        tb->xprops_flush = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                                           taskbar_flush_xprops, tb, NULL);
 }
 
 /* Handle ConfigureNotify events */
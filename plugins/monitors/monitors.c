@@ -36,7 +36,8 @@
 /*
  * HOWTO : Add your own monitor for the resource "foo".
  *
- * 1) Write the foo_update() function, that fills in the stats.
+ * 1) Write the foo_update() function, that fills in the stats from the
+ *    sample provided by the sysstat sampler.
  * 2) Write the foo_tooltip_update() function, that updates your tooltip. This
  *    is optional, but recommended.
  * 3) Add a #define FOO_POSITION, and increment N_MONITORS.
@@ -73,10 +74,11 @@
 
 #include <stdlib.h>
 #include <glib/gi18n.h>
-#include <errno.h>
 #include <libfm/fm-gtk.h>
 
 #include "plugin.h"
+#include "sysstat.h"
+#include "graph.h"
 
 #include "dbg.h"
 
@@ -84,7 +86,7 @@
 #define PLUGIN_NAME      "MonitorsPlugin"
 #define BORDER_SIZE      2                  /* Pixels               */
 #define DEFAULT_WIDTH    40                 /* Pixels               */
-#define UPDATE_PERIOD    1                  /* Seconds              */
+#define UPDATE_PERIOD    1000               /* Milliseconds         */
 #define COLOR_SIZE       8                  /* In chars : #xxxxxx\0 */
 
 #ifndef ENTER
@@ -92,28 +94,21 @@
 #endif
 
 /*
- * Stats are stored in a circular buffer.
- * Newest values are on the left of the ring cursor.
- * Oldest values are on the right of the ring cursor.
+ * Stats are stored in a circular buffer of the graph widget.
  */
 typedef float stats_set;
 
 struct Monitor {
     GdkColor     foreground_color;  /* Foreground color for drawing area      */
-    GtkWidget    *da;               /* Drawing area                           */
-    cairo_surface_t    *pixmap;     /* Pixmap to be drawn on drawing area     */
-    gint         pixmap_width;      /* Width and size of the buffer           */
-    gint         pixmap_height;     /* Does not include border size           */
-    stats_set    *stats;            /* Circular buffer of values              */
+    GtkWidget    *da;               /* Graph of values                        */
     stats_set    total;             /* Maximum possible value, as in mem_total*/
-    gint         ring_cursor;       /* Cursor for ring/circular buffer        */
     gchar        *color;            /* Color of the graph                     */
-    gboolean     (*update) (struct Monitor *); /* Update function             */
+    gboolean     (*update) (struct Monitor *, const LXPanelSysStat *); /* Update function */
     void         (*update_tooltip) (struct Monitor *);
 };
 
 typedef struct Monitor Monitor;
-typedef gboolean (*update_func) (Monitor *);
+typedef gboolean (*update_func) (Monitor *, const LXPanelSysStat *);
 typedef void (*tooltip_update_func) (Monitor *);
 
 /*
@@ -132,7 +127,8 @@ typedef struct {
     Monitor  *monitors[N_MONITORS];          /* Monitors                      */
     int      displayed_monitors[N_MONITORS]; /* Booleans                      */
     char     *action;                        /* What to do on click           */
-    guint    timer;                          /* Timer for regular updates     */
+    guint    sampler;                        /* Subscription to statistics    */
+    LXPanelSysStatFlags sampler_flags;       /* Statistics it receives        */
 } MonitorsPlugin;
 
 /*
@@ -141,21 +137,14 @@ typedef struct {
 static void monitor_set_foreground_color(MonitorsPlugin *, Monitor *, const gchar *);
 
 /* CPU Monitor */
-static gboolean cpu_update(Monitor *);
+static gboolean cpu_update(Monitor *, const LXPanelSysStat *);
 static void     cpu_tooltip_update (Monitor *m);
 
 /* RAM Monitor */
-static gboolean mem_update(Monitor *);
+static gboolean mem_update(Monitor *, const LXPanelSysStat *);
 static void     mem_tooltip_update (Monitor *m);
 
-
-static gboolean configure_event(GtkWidget*, GdkEventConfigure*, gpointer);
-#if !GTK_CHECK_VERSION(3, 0, 0)
-static gboolean expose_event(GtkWidget *, GdkEventExpose *, Monitor *);
-#else
-static gboolean draw(GtkWidget *, cairo_t *, Monitor *);
-#endif
-static void redraw_pixmap (Monitor *m);
+static void draw_sample(cairo_t *, gint, gint, const gfloat *, guint, gpointer);
 
 /* Monitors functions */
 static void monitors_destructor(gpointer);
@@ -170,24 +159,13 @@ monitor_init(MonitorsPlugin *mp, Monitor *m, gchar *color)
 {
     ENTER;
 
-    m->da = gtk_drawing_area_new();
+    m->da = panel_graph_new(1, BORDER_SIZE, draw_sample, m);
     gtk_widget_add_events(m->da, GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK |
                                  GDK_BUTTON_MOTION_MASK);
     gtk_widget_set_size_request(m->da, DEFAULT_WIDTH, panel_get_height(mp->panel));
 
     monitor_set_foreground_color(mp, m, color);
 
-    /* Signals */
-    g_signal_connect(G_OBJECT(m->da), "configure-event",
-        G_CALLBACK(configure_event), (gpointer) m);
-#if !GTK_CHECK_VERSION(3, 0, 0)
-    g_signal_connect (G_OBJECT(m->da), "expose-event",
-        G_CALLBACK(expose_event), (gpointer) m);
-#else
-    g_signal_connect (G_OBJECT(m->da), "draw",
-        G_CALLBACK(draw), (gpointer) m);
-#endif
-
     return m;
 }
 
@@ -198,10 +176,6 @@ monitor_free(Monitor *m)
         return;
 
     g_free(m->color);
-    if (m->pixmap)
-        cairo_surface_destroy(m->pixmap);
-    if (m->stats)
-        g_free(m->stats);
     g_free(m);
 
     return;
@@ -213,6 +187,7 @@ monitor_set_foreground_color(MonitorsPlugin *mp, Monitor *m, const gchar *color)
     g_free(m->color);
     m->color = g_strndup(color, COLOR_SIZE - 1);
     gdk_color_parse(color, &m->foreground_color);
+    panel_graph_redraw(PANEL_GRAPH(m->da));
 }
 /******************************************************************************
  *                          End of monitor functions                          *
@@ -229,24 +204,22 @@ struct cpu_stat {
 };
 
 static gboolean
-cpu_update(Monitor * c)
+cpu_update(Monitor * c, const LXPanelSysStat * stat)
 {
     static struct cpu_stat previous_cpu_stat = { 0, 0, 0, 0 };
+    stats_set *sample = panel_graph_new_sample(PANEL_GRAPH(c->da));
 
-    if ((c->stats != NULL) && (c->pixmap != NULL))
+    if (sample != NULL)
     {
-        /* Open statistics file and scan out CPU usage. */
-        struct cpu_stat cpu;
-        FILE * stat = fopen("/proc/stat", "r");
-        if (stat == NULL)
-            return TRUE;
-        int fscanf_result = fscanf(stat, "cpu %llu %llu %llu %llu",
-                                    &cpu.u, &cpu.n, &cpu.s, &cpu.i);
-        fclose(stat);
-
-        /* Ensure that fscanf succeeded. */
-        if (fscanf_result == 4)
+        /* Ensure that CPU usage was read. */
+        if (stat->valid & LXPANEL_SYSSTAT_CPU)
         {
+            struct cpu_stat cpu;
+            cpu.u = stat->cpu.user;
+            cpu.n = stat->cpu.nice;
+            cpu.s = stat->cpu.system;
+            cpu.i = stat->cpu.idle;
+
             /* Comcolors delta from previous statistics. */
             struct cpu_stat cpu_delta;
             cpu_delta.u = cpu.u - previous_cpu_stat.u;
@@ -258,16 +231,10 @@ cpu_update(Monitor * c)
             memcpy(&previous_cpu_stat, &cpu, sizeof(struct cpu_stat));
 
             /* Comcolors user+nice+system as a fraction of total.
-             * Introduce this sample to ring buffer, increment and wrap ring
-             * buffer cursor. */
+             * Introduce this sample to ring buffer and draw it. */
             float cpu_uns = cpu_delta.u + cpu_delta.n + cpu_delta.s;
-            c->stats[c->ring_cursor] = cpu_uns / (cpu_uns + cpu_delta.i);
-            c->ring_cursor += 1;
-            if (c->ring_cursor >= c->pixmap_width)
-                c->ring_cursor = 0;
-
-            /* Redraw with the new sample. */
-            redraw_pixmap(c);
+            *sample = cpu_uns / (cpu_uns + cpu_delta.i);
+            panel_graph_commit_sample(PANEL_GRAPH(c->da));
         }
     }
     return TRUE;
@@ -276,12 +243,12 @@ cpu_update(Monitor * c)
 static void
 cpu_tooltip_update (Monitor *m)
 {
-    if (m && m->stats) {
+    const stats_set *last;
+
+    if (m && (last = panel_graph_get_last_sample(PANEL_GRAPH(m->da)))) {
         gchar *tooltip_text;
-        gint ring_pos = (m->ring_cursor == 0)
-            ? m->pixmap_width - 1 : m->ring_cursor - 1;
         tooltip_text = g_strdup_printf(_("CPU usage: %.2f%%"),
-                m->stats[ring_pos] * 100);
+                *last * 100);
         gtk_widget_set_tooltip_text(m->da, tooltip_text);
         g_free(tooltip_text);
     }
@@ -295,55 +262,27 @@ cpu_tooltip_update (Monitor *m)
  *                               RAM Monitor                                  *
  ******************************************************************************/
 static gboolean
-mem_update(Monitor * m)
+mem_update(Monitor * m, const LXPanelSysStat * stat)
 {
     ENTER;
 
-    FILE *meminfo;
-    char buf[80];
-    long int mem_total = 0;
-    long int mem_free  = 0;
-    long int mem_buffers = 0;
-    long int mem_cached = 0;
-    unsigned int readmask = 0x8 | 0x4 | 0x2 | 0x1;
+    long int mem_total;
+    long int mem_free;
+    long int mem_buffers;
+    long int mem_cached;
+    stats_set *sample = panel_graph_new_sample(PANEL_GRAPH(m->da));
 
-    if (!m->stats || !m->pixmap)
+    if (!sample)
         RET(TRUE);
 
-    meminfo = fopen("/proc/meminfo", "r");
-    if (!meminfo) {
-        g_warning("monitors: Could not open /proc/meminfo: %d, %s",
-                  errno, strerror(errno));
-        RET(FALSE);
-    }
-
-    while (readmask && fgets(buf, sizeof(buf), meminfo)) {
-        if (sscanf(buf, "MemTotal: %ld kB\n", &mem_total) == 1) {
-            readmask ^= 0x1;
-            continue;
-        }
-        if (sscanf(buf, "MemFree: %ld kB\n", &mem_free) == 1) {
-            readmask ^= 0x2;
-            continue;
-        }
-        if (sscanf(buf, "Buffers: %ld kB\n", &mem_buffers) == 1) {
-            readmask ^= 0x4;
-            continue;
-        }
-        if (sscanf(buf, "Cached: %ld kB\n", &mem_cached) == 1) {
-            readmask ^= 0x8;
-            continue;
-        }
-    }
-
-    fclose(meminfo);
-
-    if (readmask) {
-        g_warning("monitors: Couldn't read all values from /proc/meminfo: "
-                  "readmask %x", readmask);
+    /* Sampler already warned if /proc/meminfo couldn't be read. */
+    if (!(stat->valid & LXPANEL_SYSSTAT_MEM))
         RET(FALSE);
-    }
 
+    mem_total = stat->mem_total;
+    mem_free = stat->mem_free;
+    mem_buffers = stat->mem_buffers;
+    mem_cached = stat->mem_cached;
     m->total = mem_total;
 
     /* Adding stats to the buffer:
@@ -356,15 +295,11 @@ mem_update(Monitor * m)
      * them as 'free'.
      * 'mem_cached' definitely counts as 'free' because it is immediately
      * released should any application need it. */
-    m->stats[m->ring_cursor] = (mem_total - mem_buffers - mem_free -
+    *sample = (mem_total - mem_buffers - mem_free -
             mem_cached) / (float)mem_total;
 
-    m->ring_cursor++;
-    if (m->ring_cursor >= m->pixmap_width)
-        m->ring_cursor = 0;
-
-    /* Redraw the pixmap, with the new sample */
-    redraw_pixmap (m);
+    /* Draw the new sample */
+    panel_graph_commit_sample(PANEL_GRAPH(m->da));
 
     RET(TRUE);
 }
@@ -372,13 +307,13 @@ mem_update(Monitor * m)
 static void
 mem_tooltip_update (Monitor *m)
 {
-    if (m && m->stats) {
+    const stats_set *last;
+
+    if (m && (last = panel_graph_get_last_sample(PANEL_GRAPH(m->da)))) {
         gchar *tooltip_text;
-        gint ring_pos = (m->ring_cursor == 0)
-            ? m->pixmap_width - 1 : m->ring_cursor - 1;
         tooltip_text = g_strdup_printf(_("RAM usage: %.1fMB (%.2f%%)"),
-                m->stats[ring_pos] * m->total / 1024,
-                m->stats[ring_pos] * 100);
+                *last * m->total / 1024,
+                *last * 100);
         gtk_widget_set_tooltip_text(m->da, tooltip_text);
         g_free(tooltip_text);
     }
@@ -390,128 +325,6 @@ mem_tooltip_update (Monitor *m)
 /******************************************************************************
  *                            Basic events handlers                           *
  ******************************************************************************/
-static gboolean
-configure_event(GtkWidget* widget, GdkEventConfigure* dummy, gpointer data)
-{
-    (void) dummy;
-    GtkAllocation allocation;
-
-    int new_pixmap_width, new_pixmap_height;
-
-    gtk_widget_get_allocation(widget, &allocation);
-    new_pixmap_width = allocation.width - BORDER_SIZE * 2;
-    new_pixmap_height = allocation.height - BORDER_SIZE *2;
-    Monitor *m;
-
-    m = (Monitor *) data;
-
-    if (new_pixmap_width > 0 && new_pixmap_height > 0)
-    {
-        /*
-         * If the stats buffer does not exist (first time we get inside this
-         * function) or its size changed, reallocate the buffer and preserve
-         * existing data.
-         */
-        if (!m->stats || (new_pixmap_width != m->pixmap_width))
-        {
-            stats_set *new_stats = g_new0(stats_set, new_pixmap_width);
-
-            if (!new_stats)
-                return TRUE;
-
-            if (m->stats)
-            {
-                /* New allocation is larger.
-                 * Add new "oldest" samples of zero following the cursor*/
-                if (new_pixmap_width > m->pixmap_width)
-                {
-                    /* Number of values between the ring cursor and the end of
-                     * the buffer */
-                    int nvalues = m->pixmap_width - m->ring_cursor;
-
-                    memcpy(new_stats,
-                           m->stats,
-                           m->ring_cursor * sizeof (stats_set));
-                    memcpy(new_stats + nvalues,
-                           m->stats + m->ring_cursor,
-                           nvalues * sizeof(stats_set));
-                }
-                /* New allocation is smaller, but still larger than the ring
-                 * buffer cursor */
-                else if (m->ring_cursor <= new_pixmap_width)
-                {
-                    /* Numver of values that can be stored between the end of
-                     * the new buffer and the ring cursor */
-                    int nvalues = new_pixmap_width - m->ring_cursor;
-                    memcpy(new_stats,
-                           m->stats,
-                           m->ring_cursor * sizeof(stats_set));
-                    memcpy(new_stats + m->ring_cursor,
-                           m->stats + m->pixmap_width - nvalues,
-                           nvalues * sizeof(stats_set));
-                }
-                /* New allocation is smaller, and also smaller than the ring
-                 * buffer cursor.  Discard all oldest samples following the ring
-                 * buffer cursor and additional samples at the beginning of the
-                 * buffer. */
-                else
-                {
-                    memcpy(new_stats,
-                           m->stats + m->ring_cursor - new_pixmap_width,
-                           new_pixmap_width * sizeof(stats_set));
-                }
-                g_free(m->stats);
-            }
-            m->stats = new_stats;
-        }
-
-        m->pixmap_width = new_pixmap_width;
-        m->pixmap_height = new_pixmap_height;
-        if (m->pixmap)
-            cairo_surface_destroy(m->pixmap);
-        m->pixmap = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
-                                   m->pixmap_width,
-                                   m->pixmap_height);
-        check_cairo_surface_status(&m->pixmap);
-        redraw_pixmap(m);
-    }
-
-    return TRUE;
-}
-
-#if !GTK_CHECK_VERSION(3, 0, 0)
-static gboolean
-expose_event(GtkWidget * widget, GdkEventExpose * event, Monitor *m)
-#else
-static gboolean
-draw(GtkWidget * widget, cairo_t * cr, Monitor *m)
-#endif
-{
-    /* Draw the requested part of the pixmap onto the drawing area.
-     * Translate it in both x and y by the border size. */
-    if (m->pixmap != NULL)
-    {
-#if !GTK_CHECK_VERSION(3, 0, 0)
-        cairo_t *cr = gdk_cairo_create(gtk_widget_get_window(widget));
-        GtkStyle *style = gtk_widget_get_style(m->da);
-        gdk_cairo_region(cr, event->region);
-        cairo_clip(cr);
-        gdk_cairo_set_source_color(cr, &style->black);
-#else
-        cairo_set_source_rgb(cr, 0, 0, 0); // FIXME: set the color from style
-#endif
-        cairo_set_source_surface(cr, m->pixmap, BORDER_SIZE, BORDER_SIZE);
-        cairo_paint(cr);
-        check_cairo_status(cr);
-#if !GTK_CHECK_VERSION(3, 0, 0)
-        cairo_destroy(cr);
-#endif
-    }
-
-    return FALSE;
-}
-
-
 static gboolean monitors_button_press_event(GtkWidget* widget, GdkEventButton* evt, LXPanel *panel)
 {
     MonitorsPlugin* mp;
@@ -532,33 +345,15 @@ static gboolean monitors_button_press_event(GtkWidget* widget, GdkEventButton* e
  ******************************************************************************/
 
 static void
-redraw_pixmap (Monitor *m)
+draw_sample(cairo_t *cr, gint x, gint height, const gfloat *values,
+            guint n_values, gpointer user_data)
 {
-    int i;
-    cairo_t *cr = cairo_create(m->pixmap);
-    GtkStyle *style = gtk_widget_get_style(m->da);
-
-    cairo_set_line_width (cr, 1.0);
-
-    /* Erase pixmap */
-    gdk_cairo_set_source_color(cr, &style->black);
-    cairo_paint(cr);
+    Monitor *m = user_data;
 
+    /* Draw one bar of the graph */
     gdk_cairo_set_source_color(cr, &m->foreground_color);
-    for (i = 0; i < m->pixmap_width; i++)
-    {
-        unsigned int drawing_cursor = (m->ring_cursor + i) % m->pixmap_width;
-
-        /* Draw one bar of the graph */
-        cairo_move_to(cr, i + 0.5, m->pixmap_height);
-        cairo_line_to(cr, i + 0.5, (1.0 - m->stats[drawing_cursor]) * m->pixmap_height);
-        cairo_stroke(cr);
-    }
-
-    check_cairo_status(cr);
-    cairo_destroy(cr);
-    /* Redraw pixmap */
-    gtk_widget_queue_draw(m->da);
+    cairo_rectangle(cr, x, (1.0 - values[0]) * height, 1, values[0] * height);
+    cairo_fill(cr);
 }
 
 
@@ -586,33 +381,54 @@ static char *colors[N_MONITORS] = {
     NULL
 };
 
+/* Statistics each monitor needs */
+static LXPanelSysStatFlags monitor_stats[N_MONITORS] = {
+    [CPU_POSITION] = LXPANEL_SYSSTAT_CPU,
+    [MEM_POSITION] = LXPANEL_SYSSTAT_MEM
+};
+
 /*
- * This function is called every UPDATE_PERIOD seconds. It updates all
- * monitors.
+ * This function is called every UPDATE_PERIOD milliseconds with a new sample
+ * of statistics. It updates all monitors.
  */
-static gboolean
-monitors_update(gpointer data)
+static void
+monitors_update(const LXPanelSysStat *stat, gpointer data)
 {
     MonitorsPlugin *mp;
     int i;
 
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
     mp = (MonitorsPlugin *) data;
     if (!mp)
-        RET(FALSE);
+        RET();
 
     for (i = 0; i < N_MONITORS; i++)
     {
         if (mp->monitors[i])
         {
-            mp->monitors[i]->update(mp->monitors[i]);
+            mp->monitors[i]->update(mp->monitors[i], stat);
             if (mp->monitors[i]->update_tooltip)
                 mp->monitors[i]->update_tooltip(mp->monitors[i]);
         }
     }
+}
 
-    return TRUE;
+/* (Re)subscribes to statistics which displayed monitors need */
+static void
+monitors_subscribe(GtkWidget *p, MonitorsPlugin *mp)
+{
+    LXPanelSysStatFlags flags = 0;
+    int i;
+
+    for (i = 0; i < N_MONITORS; i++)
+        if (mp->monitors[i])
+            flags |= monitor_stats[i];
+    if (mp->sampler != 0 && flags == mp->sampler_flags)
+        return;
+    if (mp->sampler != 0)
+        lxpanel_sysstat_unsubscribe(mp->sampler);
+    mp->sampler = lxpanel_sysstat_subscribe(p, flags, UPDATE_PERIOD,
+                                            monitors_update, mp);
+    mp->sampler_flags = flags;
 }
 
 static Monitor*
@@ -679,10 +495,9 @@ monitors_constructor(LXPanel *panel, config_setting_t *settings)
         }
     }
 
-    /* Adding a timer : monitors will be updated every UPDATE_PERIOD
-     * seconds */
-    mp->timer = g_timeout_add_seconds(UPDATE_PERIOD, (GSourceFunc) monitors_update,
-                              (gpointer) mp);
+    /* Subscribing to statistics : monitors will be updated every
+     * UPDATE_PERIOD milliseconds */
+    monitors_subscribe(p, mp);
     RET(p);
 }
 
@@ -695,8 +510,8 @@ monitors_destructor(gpointer user_data)
 
     mp = (MonitorsPlugin *) user_data;
 
-    /* Removing timer */
-    g_source_remove(mp->timer);
+    /* Removing subscription */
+    lxpanel_sysstat_unsubscribe(mp->sampler);
 
     /* Freeing all monitors */
     for (i = 0; i < N_MONITORS; i++)
@@ -792,6 +607,7 @@ start:
         mp->displayed_monitors[0] = 1;
         goto start;
     }
+    monitors_subscribe(p, mp);
     config_group_set_int(mp->settings, "DisplayCPU", mp->displayed_monitors[CPU_POSITION]);
     config_group_set_int(mp->settings, "DisplayRAM", mp->displayed_monitors[MEM_POSITION]);
     config_group_set_string(mp->settings, "Action", mp->action);
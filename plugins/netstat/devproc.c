@@ -131,132 +131,38 @@ static NETDEVLIST_PTR netproc_netdevlist_find(
 	return NULL;
 }
 
-static char *netproc_parse_ifname(const char *buffer)
+int netproc_scandevice(int sockfd, int iwsockfd, const LXPanelSysStat *stat, NETDEVLIST_PTR *netdev_list)
 {
-	char *ptr;
-	if ((ptr = strchr(buffer, ':'))) {
-		*ptr++ = '\0';
-	}
-
-	return ptr;
-}
-
-static void netproc_parse_stats_header(char *buffer,
-                                       int *prx_idx,
-                                       int *ptx_idx,
-                                       int *brx_idx,
-                                       int *btx_idx)
-{
-	char *p;
-	int i;
-
-	*prx_idx = *ptx_idx = -1;
-	*brx_idx = *btx_idx = -1;
-
-	p = strtok (buffer, "| \t\n");
-	p = strtok (NULL, "| \t\n");
-	for (i = 0; p; i++, p = strtok (NULL, "| \t\n")) {
-		if (!strcmp (p, "packets")) {
-			if (*prx_idx == -1)
-				*prx_idx = i;
-			else
-				*ptx_idx = i;
-		} else if (!strcmp (p, "bytes")) {
-			if (*brx_idx == -1)
-				*brx_idx = i;
-			else
-				*btx_idx = i;
-		}
-	}
-}
-
-static gboolean netproc_parse_status(char *buffer,
-                                     int prx_idx,
-                                     int ptx_idx,
-                                     gulong *in_packets,
-                                     gulong *out_packets,
-                                     int brx_idx,
-                                     int btx_idx,
-                                     gulong *in_bytes,
-                                     gulong *out_bytes)
-{
-	char *ptr;
-	int i;
-	ptr = strtok(buffer, " \t\n");
-	for (i=0;ptr;i++, ptr = strtok(NULL, " \t\n")) {
-		if (i==prx_idx)
-			*in_packets = g_ascii_strtoull(ptr, NULL, 10);
-		else if (i==ptx_idx)
-			*out_packets = g_ascii_strtoull(ptr, NULL, 10);
-		else if (i==brx_idx)
-			*in_bytes = g_ascii_strtoull(ptr, NULL, 10);
-		else if (i==btx_idx)
-			*out_bytes = g_ascii_strtoull(ptr, NULL, 10);
-	}
-
-	if (i <= prx_idx || i <= ptx_idx || i <= brx_idx || i <=btx_idx)
-		return FALSE;
-
-	return TRUE;
-}
-
-FILE *netproc_open()
-{
-	return fopen("/proc/net/dev", "r");
-}
-
-void netproc_close(FILE *fp)
-{
-	fclose(fp);
-}
-
-int netproc_scandevice(int sockfd, int iwsockfd, FILE *fp, NETDEVLIST_PTR *netdev_list)
-{
-	char buffer[512];
 	int count = 0;
-	int prx_idx, ptx_idx, brx_idx, btx_idx;
+	guint i;
 	gulong in_packets, out_packets, in_bytes, out_bytes;
 	NETDEVLIST_PTR devptr = NULL;
 
 	/* interface information */
+	const LXPanelIfaceStat *ifs;
 	struct ifreq ifr;
 	struct ethtool_test edata;
 	iwstats iws;
-	char *status;
-	char *name;
+	const char *name;
 	struct iw_range iwrange;
 	int has_iwrange = 0;
 
-	status = fgets (buffer, sizeof(buffer), fp);
-	if (!status)
-		g_warning("netstat: netproc_scnadevice(): Error reading first line from stream!");
-	status = fgets (buffer, sizeof(buffer), fp);
-	if (!status)
-		g_warning("netstat: netproc_scnadevice(): Error reading second line from stream!");
-	netproc_parse_stats_header(buffer, &prx_idx, &ptx_idx, &brx_idx, &btx_idx);
-
-	while (fgets(buffer, sizeof(buffer), fp)) {
-		/* getting interface name */
-		name = buffer;
-		while (g_ascii_isspace(name[0])) {
-			name++;
-		}
+	if (!(stat->valid & LXPANEL_SYSSTAT_NET))
+		return 0;
+
+	/* all interfaces were read by sampler at once, with their hw_type and flags */
+	for (i = 0; i < stat->n_ifaces; i++) {
+		ifs = &stat->ifaces[i];
+		name = ifs->name;
 
 		/* reading packet infomation */
-		in_packets = out_packets = in_bytes = out_bytes = 0L;
-		status = netproc_parse_ifname(name);
-		netproc_parse_status(status, prx_idx, ptx_idx, &in_packets, &out_packets,
-				     brx_idx, btx_idx, &in_bytes, &out_bytes);
-
-		/* check interface hw_type */
-		bzero(&ifr, sizeof(ifr));
-		strncpy(ifr.ifr_name, name, strlen(name));
-		ifr.ifr_name[strlen(name)+1] = '\0';
-		if (ioctl(sockfd, SIOCGIFHWADDR, &ifr)<0)
-			continue;
+		in_packets = ifs->rx_packets;
+		out_packets = ifs->tx_packets;
+		in_bytes = ifs->rx_bytes;
+		out_bytes = ifs->tx_bytes;
 
 		/* hw_types is not Ethernet and PPP */
-		if (ifr.ifr_hwaddr.sa_family!=ARPHRD_ETHER&&ifr.ifr_hwaddr.sa_family!=ARPHRD_PPP)
+		if (ifs->type!=ARPHRD_ETHER&&ifs->type!=ARPHRD_PPP)
 			continue;
 
 		/* detecting new interface */
@@ -271,13 +177,11 @@ int netproc_scandevice(int sockfd, int iwsockfd, FILE *fp, NETDEVLIST_PTR *netde
 			devptr = netproc_netdevlist_find(*netdev_list, name);
 
 			/* MAC Address */
-			devptr->info.mac = g_strdup_printf ("%02X:%02X:%02X:%02X:%02X:%02X",
-					ifr.ifr_hwaddr.sa_data[0] & 0377,
-					ifr.ifr_hwaddr.sa_data[1] & 0377,
-					ifr.ifr_hwaddr.sa_data[2] & 0377,
-					ifr.ifr_hwaddr.sa_data[3] & 0377,
-					ifr.ifr_hwaddr.sa_data[4] & 0377,
-					ifr.ifr_hwaddr.sa_data[5] & 0377);
+			if (ifs->hwaddr_len >= 6)
+				devptr->info.mac = g_strdup_printf ("%02X:%02X:%02X:%02X:%02X:%02X",
+						ifs->hwaddr[0], ifs->hwaddr[1],
+						ifs->hwaddr[2], ifs->hwaddr[3],
+						ifs->hwaddr[4], ifs->hwaddr[5]);
 		} else {
 			/* Setting device status and update flags */
 			if (devptr->info.recv_packets!=in_packets&&devptr->info.trans_packets!=out_packets) {
@@ -313,139 +217,134 @@ int netproc_scandevice(int sockfd, int iwsockfd, FILE *fp, NETDEVLIST_PTR *netde
 		}
 
 		/* Enable */
-		bzero(&ifr, sizeof(ifr));
-		strcpy(ifr.ifr_name, devptr->info.ifname);
-		ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
-		if (ioctl(sockfd, SIOCGIFFLAGS, &ifr)>=0) {
-			devptr->info.flags = ifr.ifr_flags;
-			if (ifr.ifr_flags & IFF_UP) {
-				devptr->info.enable = TRUE;
-				devptr->info.updated = TRUE;
-			} else {
-				devptr->info.enable = FALSE;
-				devptr->info.updated = TRUE;
-			}
+		devptr->info.flags = ifs->flags;
+		if (ifs->flags & IFF_UP) {
+			devptr->info.enable = TRUE;
+			devptr->info.updated = TRUE;
+		} else {
+			devptr->info.enable = FALSE;
+			devptr->info.updated = TRUE;
+		}
 
-			if (devptr->info.enable) {
-				/* Workaround for Atheros Cards */
-				if (strncmp(devptr->info.ifname, "ath", 3)==0)
-					wireless_refresh(iwsockfd, devptr->info.ifname);
-
-				/* plug */
-				bzero(&ifr, sizeof(ifr));
-				strcpy(ifr.ifr_name, devptr->info.ifname);
-				ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
-
-				edata.cmd = 0x0000000a;
-				ifr.ifr_data = (caddr_t)&edata;
-				if (ioctl(sockfd, SIOCETHTOOL, &ifr)<0) {
-					/* using IFF_RUNNING instead due to system doesn't have ethtool or working in non-root */
-					if (devptr->info.flags & IFF_RUNNING) {
-						if (!devptr->info.plug) {
-							devptr->info.plug = TRUE;
-							devptr->info.updated = TRUE;
-						}
-					} else if (devptr->info.plug) {
-						devptr->info.plug = FALSE;
+		if (devptr->info.enable) {
+			/* Workaround for Atheros Cards */
+			if (strncmp(devptr->info.ifname, "ath", 3)==0)
+				wireless_refresh(iwsockfd, devptr->info.ifname);
+
+			/* plug */
+			bzero(&ifr, sizeof(ifr));
+			strcpy(ifr.ifr_name, devptr->info.ifname);
+			ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
+
+			edata.cmd = 0x0000000a;
+			ifr.ifr_data = (caddr_t)&edata;
+			if (ioctl(sockfd, SIOCETHTOOL, &ifr)<0) {
+				/* using IFF_RUNNING instead due to system doesn't have ethtool or working in non-root */
+				if (devptr->info.flags & IFF_RUNNING) {
+					if (!devptr->info.plug) {
+						devptr->info.plug = TRUE;
 						devptr->info.updated = TRUE;
 					}
-				} else {
-					if (edata.data) {
-						if (!devptr->info.plug) {
-							devptr->info.plug = TRUE;
-							devptr->info.updated = TRUE;
-						}
-					} else if (devptr->info.plug) {
-						devptr->info.plug = FALSE;
+				} else if (devptr->info.plug) {
+					devptr->info.plug = FALSE;
+					devptr->info.updated = TRUE;
+				}
+			} else {
+				if (edata.data) {
+					if (!devptr->info.plug) {
+						devptr->info.plug = TRUE;
 						devptr->info.updated = TRUE;
 					}
+				} else if (devptr->info.plug) {
+					devptr->info.plug = FALSE;
+					devptr->info.updated = TRUE;
 				}
+			}
 
-				/* get network information */
-				if (devptr->info.enable&&devptr->info.plug) {
-					if (devptr->info.flags & IFF_RUNNING) {
-						/* release old information */
-						g_free(devptr->info.ipaddr);
-						g_free(devptr->info.bcast);
-						g_free(devptr->info.mask);
-
-						/* IP Address */
+			/* get network information */
+			if (devptr->info.enable&&devptr->info.plug) {
+				if (devptr->info.flags & IFF_RUNNING) {
+					/* release old information */
+					g_free(devptr->info.ipaddr);
+					g_free(devptr->info.bcast);
+					g_free(devptr->info.mask);
+
+					/* IP Address */
+					bzero(&ifr, sizeof(ifr));
+					strcpy(ifr.ifr_name, devptr->info.ifname);
+					ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
+					if (ioctl(sockfd, SIOCGIFADDR, &ifr)<0)
+						devptr->info.ipaddr = g_strdup("0.0.0.0");
+					else
+						devptr->info.ipaddr = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr));
+
+					/* Point-to-Porint Address */
+					if (devptr->info.flags & IFF_POINTOPOINT) {
 						bzero(&ifr, sizeof(ifr));
 						strcpy(ifr.ifr_name, devptr->info.ifname);
 						ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
-						if (ioctl(sockfd, SIOCGIFADDR, &ifr)<0)
-							devptr->info.ipaddr = g_strdup("0.0.0.0");
+						if (ioctl(sockfd, SIOCGIFDSTADDR, &ifr)<0)
+							devptr->info.dest = NULL;
 						else
-							devptr->info.ipaddr = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr));
-
-						/* Point-to-Porint Address */
-						if (devptr->info.flags & IFF_POINTOPOINT) {
-							bzero(&ifr, sizeof(ifr));
-							strcpy(ifr.ifr_name, devptr->info.ifname);
-							ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
-							if (ioctl(sockfd, SIOCGIFDSTADDR, &ifr)<0)
-								devptr->info.dest = NULL;
-							else
-								devptr->info.dest = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_dstaddr)->sin_addr));
-						}
-
-						/* Broadcast */
-						if (devptr->info.flags & IFF_BROADCAST) {
-							bzero(&ifr, sizeof(ifr));
-							strcpy(ifr.ifr_name, devptr->info.ifname);
-							ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
-							if (ioctl(sockfd, SIOCGIFBRDADDR, &ifr)<0)
-								devptr->info.bcast = NULL;
-							else
-								devptr->info.bcast = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_broadaddr)->sin_addr));
-						}
+							devptr->info.dest = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_dstaddr)->sin_addr));
+					}
 
-						/* Netmask */
+					/* Broadcast */
+					if (devptr->info.flags & IFF_BROADCAST) {
 						bzero(&ifr, sizeof(ifr));
 						strcpy(ifr.ifr_name, devptr->info.ifname);
 						ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
-						if (ioctl(sockfd, SIOCGIFNETMASK, &ifr)<0)
-							devptr->info.mask = NULL;
+						if (ioctl(sockfd, SIOCGIFBRDADDR, &ifr)<0)
+							devptr->info.bcast = NULL;
 						else
-							devptr->info.mask = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr));
-
-						/* Wireless Information */
-						if (devptr->info.wireless) {
-							struct wireless_config wconfig;
-
-							/* get wireless config */
-							if (iw_get_basic_config(iwsockfd, devptr->info.ifname, &wconfig)>=0) {
-								/* Protocol */
-								devptr->info.protocol = g_strdup(wconfig.name);
-								/* ESSID */
-								devptr->info.essid = g_strdup(wconfig.essid);
-
-								/* Signal Quality */
-								iw_get_stats(iwsockfd, devptr->info.ifname, &iws, &iwrange, has_iwrange);
-								devptr->info.quality = rint((log (iws.qual.qual) / log (92)) * 100.0);
-							}
-						}
+							devptr->info.bcast = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_broadaddr)->sin_addr));
+					}
 
-						/* check problem connection */
-						if (strcmp(devptr->info.ipaddr, "0.0.0.0")==0) {
-							devptr->info.status = NETDEV_STAT_PROBLEM;
-							/* has connection problem  */
-							if (devptr->info.connected) {
-								devptr->info.connected = FALSE;
-								devptr->info.updated = TRUE;
-							}
-						} else if (!devptr->info.connected) {
-								devptr->info.status = NETDEV_STAT_NORMAL;
-								devptr->info.connected = TRUE;
-								devptr->info.updated = TRUE;
+					/* Netmask */
+					bzero(&ifr, sizeof(ifr));
+					strcpy(ifr.ifr_name, devptr->info.ifname);
+					ifr.ifr_name[IF_NAMESIZE - 1] = '\0';
+					if (ioctl(sockfd, SIOCGIFNETMASK, &ifr)<0)
+						devptr->info.mask = NULL;
+					else
+						devptr->info.mask = g_strdup(inet_ntoa(((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr));
+
+					/* Wireless Information */
+					if (devptr->info.wireless) {
+						struct wireless_config wconfig;
+
+						/* get wireless config */
+						if (iw_get_basic_config(iwsockfd, devptr->info.ifname, &wconfig)>=0) {
+							/* Protocol */
+							devptr->info.protocol = g_strdup(wconfig.name);
+							/* ESSID */
+							devptr->info.essid = g_strdup(wconfig.essid);
+
+							/* Signal Quality */
+							iw_get_stats(iwsockfd, devptr->info.ifname, &iws, &iwrange, has_iwrange);
+							devptr->info.quality = rint((log (iws.qual.qual) / log (92)) * 100.0);
 						}
-					} else {
-						/* has connection problem  */
+					}
+
+					/* check problem connection */
+					if (strcmp(devptr->info.ipaddr, "0.0.0.0")==0) {
 						devptr->info.status = NETDEV_STAT_PROBLEM;
+						/* has connection problem  */
 						if (devptr->info.connected) {
 							devptr->info.connected = FALSE;
 							devptr->info.updated = TRUE;
 						}
+					} else if (!devptr->info.connected) {
+							devptr->info.status = NETDEV_STAT_NORMAL;
+							devptr->info.connected = TRUE;
+							devptr->info.updated = TRUE;
+					}
+				} else {
+					/* has connection problem  */
+					devptr->info.status = NETDEV_STAT_PROBLEM;
+					if (devptr->info.connected) {
+						devptr->info.connected = FALSE;
+						devptr->info.updated = TRUE;
 					}
 				}
 			}
@@ -455,9 +354,6 @@ int netproc_scandevice(int sockfd, int iwsockfd, FILE *fp, NETDEVLIST_PTR *netde
 		count++;
 	}
 
-	rewind(fp);
-	fflush(fp);
-
 	return count;
 }
 
@@ -497,13 +393,11 @@ void netproc_devicelist_clear(NETDEVLIST_PTR *netdev_list)
 	}
 }
 
-void netproc_listener(FNETD *fnetd)
+void netproc_listener(FNETD *fnetd, const LXPanelSysStat *stat)
 {
 	if (fnetd->sockfd) {
 		netproc_alive(fnetd->netdevlist);
-		fnetd->netdev_fp = netproc_open();
-		netproc_scandevice(fnetd->sockfd, fnetd->iwsockfd, fnetd->netdev_fp, &fnetd->netdevlist);
-		netproc_close(fnetd->netdev_fp);
+		netproc_scandevice(fnetd->sockfd, fnetd->iwsockfd, stat, &fnetd->netdevlist);
 	}
 }
 
@@ -6,12 +6,10 @@ struct linktest_value {
         unsigned int    data;
 };
 
-FILE *netproc_open(void);
-void netproc_close(FILE *fp);
 int netproc_netdevlist_clear(NETDEVLIST_PTR *netdev_list);
-int netproc_scandevice(int sockfd, int iwsockfd, FILE *fp, NETDEVLIST_PTR *netdev_list);
+int netproc_scandevice(int sockfd, int iwsockfd, const LXPanelSysStat *stat, NETDEVLIST_PTR *netdev_list);
 void netproc_print(NETDEVLIST_PTR netdev_list);
-void netproc_listener(FNETD *fnetd);
+void netproc_listener(FNETD *fnetd, const LXPanelSysStat *stat);
 void netproc_devicelist_clear(NETDEVLIST_PTR *netdev_list);
 
 #endif
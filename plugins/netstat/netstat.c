@@ -413,17 +413,44 @@ static void refresh_systray(netstat *ns, NETDEVLIST_PTR netdev_list)
     } while(ptr!=NULL);
 }
 
-static gboolean refresh_devstat(netstat *ns)
+static void refresh_devstat(const LXPanelSysStat *stat, gpointer user_data)
 {
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
-    netproc_listener(ns->fnetd);
+    netstat *ns = user_data;
+
+    netproc_listener(ns->fnetd, stat);
 #ifdef DEBUG
     netproc_print(ns->fnetd->netdevlist);
 #endif
     refresh_systray(ns, ns->fnetd->netdevlist);
     netproc_devicelist_clear(&ns->fnetd->netdevlist);
-    return TRUE;
+}
+
+static gboolean refresh_on_link_change(gpointer user_data)
+{
+    netstat *ns = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    ns->link_idle = 0;
+    refresh_devstat(lxpanel_sysstat_read(LXPANEL_SYSSTAT_NET), ns);
+    return FALSE;
+}
+
+/* Interface went up or down: show it right away, not on next poll. Changes
+ * usually come in bursts so they are processed once in idle. */
+static void link_changed(const LXPanelIfaceStat *iface, LXPanelSysStatLinkEvent event,
+                         gpointer user_data)
+{
+    netstat *ns = user_data;
+
+    /* periodic refresh still runs, just forget the watch */
+    if (event == LXPANEL_SYSSTAT_LINK_CLOSED)
+    {
+        ns->link_watch = 0;
+        return;
+    }
+    if (ns->link_idle == 0)
+        ns->link_idle = g_idle_add(refresh_on_link_change, ns);
 }
 
 /* Plugin constructor */
@@ -432,7 +459,11 @@ static void netstat_destructor(gpointer user_data)
     netstat *ns = (netstat *) user_data;
 
     ENTER;
-    g_source_remove(ns->ttag);
+    lxpanel_sysstat_unsubscribe(ns->sampler);
+    if (ns->link_watch)
+        lxpanel_sysstat_unwatch_links(ns->link_watch);
+    if (ns->link_idle)
+        g_source_remove(ns->link_idle);
     netproc_netdevlist_clear(&ns->fnetd->netdevlist);
     /* The widget is destroyed in plugin_stop().
     gtk_widget_destroy(ns->mainw);
@@ -475,19 +506,22 @@ static GtkWidget *netstat_constructor(LXPanel *panel, config_setting_t *settings
     gtk_widget_show_all(ns->mainw);
 
     /* Initializing network device list*/
-    ns->fnetd->netdev_fp = netproc_open();
+    ns->link_watch = lxpanel_sysstat_watch_links(link_changed, ns);
     ns->fnetd->dev_count = netproc_netdevlist_clear(&ns->fnetd->netdevlist);
-    ns->fnetd->dev_count = netproc_scandevice(ns->fnetd->sockfd, ns->fnetd->iwsockfd, ns->fnetd->netdev_fp, &ns->fnetd->netdevlist);
-    netproc_close(ns->fnetd->netdev_fp);
+    ns->fnetd->dev_count = netproc_scandevice(ns->fnetd->sockfd, ns->fnetd->iwsockfd,
+                                              lxpanel_sysstat_read(LXPANEL_SYSSTAT_NET),
+                                              &ns->fnetd->netdevlist);
     refresh_systray(ns, ns->fnetd->netdevlist);
 
-    ns->ttag = g_timeout_add(NETSTAT_IFACE_POLL_DELAY, (GSourceFunc)refresh_devstat, ns);
-
     p = gtk_event_box_new();
     lxpanel_plugin_set_data(p, ns, netstat_destructor);
     gtk_widget_set_has_window(p, FALSE);
     gtk_container_add((GtkContainer*)p, ns->mainw);
 
+    ns->sampler = lxpanel_sysstat_subscribe(p, LXPANEL_SYSSTAT_NET,
+                                            NETSTAT_IFACE_POLL_DELAY,
+                                            refresh_devstat, ns);
+
     RET(p);
 }
 
@@ -6,6 +6,7 @@
 #include <gtk/gtk.h>
 #include "wireless.h"
 #include "plugin.h"
+#include "sysstat.h"
 
 #define NETDEV_STAT_NORMAL	0
 #define NETDEV_STAT_PROBLEM	1
@@ -65,7 +66,6 @@ typedef struct {
 	int sockfd;
 	int iwsockfd;
 	GIOChannel *lxnmchannel;
-	FILE *netdev_fp;
 	NETDEVLIST_PTR netdevlist;
 } FNETD;
 
@@ -74,7 +74,9 @@ typedef struct {
     LXPanel *panel;
     FNETD *fnetd;
     char *fixcmd;
-    gint ttag;
+    guint sampler;
+    guint link_watch;
+    guint link_idle;
     gboolean use_theme;
 } netstat;
 
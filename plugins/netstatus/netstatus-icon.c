@@ -32,6 +32,10 @@
 #include "netstatus-fallback-pixbuf.h"
 
 #include "gtk-compat.h"
+#include "graph.h"
+
+#define NETSTATUS_GRAPH_SIZE      30    /* length of throughput graph, pixels */
+#define NETSTATUS_GRAPH_MIN_PEAK  1024  /* bytes/s at top of graph at least */
 
 typedef enum
 {
@@ -46,11 +50,13 @@ struct _NetstatusIconPrivate
 {
   GtkWidget      *image;
   GtkWidget      *signal_image;
+  GtkWidget      *graph;
   GtkWidget      *error_dialog;
 
   NetstatusIface *iface;
   NetstatusState  state;
   NetstatusSignal signal_strength;
+  gdouble         graph_peak;     /* bytes/s at top of each half of graph */
 
   GtkIconTheme   *icon_theme;
   GdkPixbuf      *icons [NETSTATUS_STATE_LAST];
@@ -69,9 +75,11 @@ struct _NetstatusIconPrivate
   gulong          name_changed_id;
   gulong          wireless_changed_id;
   gulong          signal_changed_id;
+  gulong          sample_added_id;
 
   guint           tooltips_enabled : 1;
   guint           show_signal : 1;
+  guint           show_graph : 1;
 };
 
 enum {
@@ -367,28 +375,116 @@ netstatus_icon_update_image (NetstatusIcon *icon)
 }
 
 static void
-netstatus_icon_name_changed (NetstatusIface *iface __attribute__((unused)),
-			     GParamSpec     *pspec __attribute__((unused)),
-			     NetstatusIcon  *icon)
+netstatus_icon_append_rate (GString *str,
+			    gdouble  rate)
+{
+  if (rate >= 1 << 20)
+    g_string_append_printf (str, _("%.1f MiB/s"), rate / (1 << 20));
+  else if (rate >= 1 << 10)
+    g_string_append_printf (str, _("%.1f KiB/s"), rate / (1 << 10));
+  else
+    g_string_append_printf (str, _("%.0f B/s"), rate);
+}
+
+static void
+netstatus_icon_update_tooltip (NetstatusIcon *icon)
 {
   const gchar *iface_name;
-  const gchar *tip;
-  gchar       *freeme = NULL;
+  GString     *tip;
+  gdouble      in_rate, out_rate;
+
+  tip = g_string_new (NULL);
 
   iface_name = netstatus_iface_get_name (icon->priv->iface);
   if (iface_name)
+    g_string_printf (tip, _("Network Connection: %s"), iface_name);
+  else
+    g_string_assign (tip, _("Network Connection"));
+
+  if (netstatus_iface_get_state (icon->priv->iface) != NETSTATUS_STATE_DISCONNECTED &&
+      netstatus_iface_get_rates (icon->priv->iface, &in_rate, &out_rate, NULL, NULL))
     {
-      freeme = g_strdup_printf (_("Network Connection: %s"), iface_name);
-      tip = freeme;
+      g_string_append (tip, _("\nReceived: "));
+      netstatus_icon_append_rate (tip, in_rate);
+      g_string_append (tip, _("\nSent: "));
+      netstatus_icon_append_rate (tip, out_rate);
     }
-  else
+
+  gtk_widget_set_tooltip_text (GTK_WIDGET (icon), tip->str);
+
+  g_string_free (tip, TRUE);
+}
+
+static void
+netstatus_icon_name_changed (NetstatusIface *iface __attribute__((unused)),
+			     GParamSpec     *pspec __attribute__((unused)),
+			     NetstatusIcon  *icon)
+{
+  netstatus_icon_update_tooltip (icon);
+}
+
+/* Draws a column of the graph: sent bytes up from the middle, received
+ * bytes down from it. */
+static void
+netstatus_icon_draw_sample (cairo_t      *cr,
+			    gint          x,
+			    gint          height,
+			    const gfloat *values,
+			    guint         n_values __attribute__((unused)),
+			    gpointer      user_data)
+{
+  NetstatusIcon *icon = user_data;
+  gdouble        half = height / 2.0;
+  gdouble        in_h, out_h;
+
+  in_h  = MIN (values [0] / icon->priv->graph_peak, 1.0) * half;
+  out_h = MIN (values [1] / icon->priv->graph_peak, 1.0) * half;
+
+  if (out_h > 0.0)
+    {
+      cairo_set_source_rgb (cr, 1.0, 0.5, 0.0);
+      cairo_rectangle (cr, x, half - out_h, 1, out_h);
+      cairo_fill (cr);
+    }
+  if (in_h > 0.0)
     {
-      tip = _("Network Connection");
+      cairo_set_source_rgb (cr, 0.0, 0.8, 0.0);
+      cairo_rectangle (cr, x, half, 1, in_h);
+      cairo_fill (cr);
     }
+}
+
+/* Called on each poll of interface, so the graph doesn't need a timer. */
+static void
+netstatus_icon_sample_added (NetstatusIface *iface,
+			     NetstatusIcon  *icon)
+{
+  PanelGraph *graph = PANEL_GRAPH (icon->priv->graph);
+  gdouble     in_rate, out_rate, peak;
+  gfloat     *sample;
 
-  gtk_widget_set_tooltip_text(GTK_WIDGET (icon), tip);
+  if (!netstatus_iface_get_rates (iface, &in_rate, &out_rate, NULL, NULL))
+    return;
+
+  netstatus_icon_update_tooltip (icon);
 
-  g_free (freeme);
+  if (!icon->priv->show_graph)
+    return;
+
+  sample = panel_graph_new_sample (graph);
+  if (!sample)
+    return;
+  sample [0] = in_rate;
+  sample [1] = out_rate;
+  panel_graph_commit_sample (graph);
+
+  /* Scale follows the highest rate of recent samples. */
+  peak = MAX (netstatus_iface_get_peak_rate (iface), NETSTATUS_GRAPH_MIN_PEAK);
+  if (peak != icon->priv->graph_peak)
+    {
+      icon->priv->graph_peak = peak;
+      panel_graph_redraw (graph);
+    }
 }
 
 static void
@@ -473,11 +569,14 @@ netstatus_icon_destroy (GtkObject *widget)
 				   icon->priv->wireless_changed_id);
       g_signal_handler_disconnect (icon->priv->iface,
 				   icon->priv->signal_changed_id);
+      g_signal_handler_disconnect (icon->priv->iface,
+				   icon->priv->sample_added_id);
     }
   icon->priv->state_changed_id    = 0;
   icon->priv->name_changed_id     = 0;
   icon->priv->wireless_changed_id = 0;
   icon->priv->signal_changed_id   = 0;
+  icon->priv->sample_added_id     = 0;
 
   icon->priv->image = NULL;
 
@@ -909,6 +1008,12 @@ netstatus_icon_instance_init (NetstatusIcon      *icon,
   gtk_container_add (GTK_CONTAINER (icon), icon->priv->signal_image);
   gtk_widget_hide (icon->priv->signal_image);
 
+  icon->priv->graph_peak = NETSTATUS_GRAPH_MIN_PEAK;
+  icon->priv->graph = panel_graph_new (2, 1, netstatus_icon_draw_sample, icon);
+  gtk_widget_set_size_request (icon->priv->graph, NETSTATUS_GRAPH_SIZE, -1);
+  gtk_container_add (GTK_CONTAINER (icon), icon->priv->graph);
+  gtk_widget_hide (icon->priv->graph);
+
   gtk_widget_add_events (GTK_WIDGET (icon),
 			 GDK_BUTTON_PRESS_MASK | GDK_ENTER_NOTIFY_MASK | GDK_LEAVE_NOTIFY_MASK);
 }
@@ -1020,14 +1125,22 @@ netstatus_icon_set_iface (NetstatusIcon  *icon,
 				       icon->priv->wireless_changed_id);
 	  g_signal_handler_disconnect (icon->priv->iface,
 				       icon->priv->signal_changed_id);
+	  g_signal_handler_disconnect (icon->priv->iface,
+				       icon->priv->sample_added_id);
 	}
 
       if (iface)
-	g_object_ref (iface);
+	{
+	  g_object_ref (iface);
+	  netstatus_iface_set_owner (iface, GTK_WIDGET (icon));
+	}
       icon->priv->iface = iface;
 
       if (old_iface)
-	g_object_unref (old_iface);
+	{
+	  netstatus_iface_set_owner (old_iface, NULL);
+	  g_object_unref (old_iface);
+	}
 
       icon->priv->state_changed_id     = g_signal_connect (icon->priv->iface, "notify::state",
 							   G_CALLBACK (netstatus_icon_state_changed), icon);
@@ -1037,6 +1150,12 @@ netstatus_icon_set_iface (NetstatusIcon  *icon,
 							   G_CALLBACK (netstatus_icon_is_wireless_changed), icon);
       icon->priv->signal_changed_id    = g_signal_connect (icon->priv->iface, "notify::signal-strength",
 							   G_CALLBACK (netstatus_icon_signal_changed), icon);
+      icon->priv->sample_added_id      = g_signal_connect (icon->priv->iface, "sample-added",
+							   G_CALLBACK (netstatus_icon_sample_added), icon);
+
+      /* Samples of the previous interface mean nothing now. */
+      panel_graph_set_n_values (PANEL_GRAPH (icon->priv->graph), 0);
+      panel_graph_set_n_values (PANEL_GRAPH (icon->priv->graph), 2);
 
       netstatus_icon_state_changed       (icon->priv->iface, NULL, icon);
       netstatus_icon_name_changed        (icon->priv->iface, NULL, icon);
@@ -1068,6 +1187,11 @@ netstatus_icon_set_orientation (NetstatusIcon  *icon,
       netstatus_icon_rotate_signal_icons (icon, orientation);
       netstatus_icon_update_image (icon);
 
+      if (orientation == GTK_ORIENTATION_HORIZONTAL)
+	gtk_widget_set_size_request (icon->priv->graph, NETSTATUS_GRAPH_SIZE, -1);
+      else
+	gtk_widget_set_size_request (icon->priv->graph, -1, NETSTATUS_GRAPH_SIZE);
+
       icon->priv->size = -1;
 
       gtk_widget_queue_resize (GTK_WIDGET (icon));
@@ -1136,3 +1260,30 @@ netstatus_icon_get_show_signal (NetstatusIcon *icon)
 
   return icon->priv->show_signal;
 }
+
+void
+netstatus_icon_set_show_graph (NetstatusIcon *icon,
+			       gboolean       show_graph)
+{
+  g_return_if_fail (NETSTATUS_IS_ICON (icon));
+
+  show_graph = show_graph != FALSE;
+
+  if (icon->priv->show_graph != show_graph)
+    {
+      icon->priv->show_graph = show_graph;
+
+      if (show_graph)
+	gtk_widget_show (icon->priv->graph);
+      else
+	gtk_widget_hide (icon->priv->graph);
+    }
+}
+
+gboolean
+netstatus_icon_get_show_graph (NetstatusIcon *icon)
+{
+  g_return_val_if_fail (NETSTATUS_IS_ICON (icon), FALSE);
+
+  return icon->priv->show_graph;
+}
@@ -50,10 +50,20 @@
 
 #include "netstatus-sysdeps.h"
 #include "netstatus-enums.h"
+#include "sysstat.h"
 
 #define NETSTATUS_IFACE_POLL_DELAY       500  /* milliseconds between polls */
 #define NETSTATUS_IFACE_POLLS_IN_ERROR   10   /* no. of polls in error before increasing delay */
 #define NETSTATUS_IFACE_ERROR_POLL_DELAY 5000 /* delay to use when in error state */
+#define NETSTATUS_IFACE_IDLE_POLLS       10   /* no. of idle polls before increasing delay */
+#define NETSTATUS_IFACE_HISTORY_SIZE     32   /* no. of samples of counters kept */
+#define NETSTATUS_IFACE_IDLE_POLL_DELAY  2000 /* delay to use when idle */
+
+enum
+{
+  SAMPLE_ADDED,
+  LAST_SIGNAL
+};
 
 enum
 {
@@ -66,9 +76,21 @@ enum
   PROP_ERROR
 };
 
+/* Change of counters between two polls */
+typedef struct
+{
+  gint64          time;           /* monotonic time of poll, microseconds */
+  gint64          interval;       /* since previous poll, microseconds */
+  gulong          in_packets;
+  gulong          out_packets;
+  gulong          in_bytes;
+  gulong          out_bytes;
+} NetstatusSample;
+
 struct _NetstatusIfacePrivate
 {
   char           *name;
+  GtkWidget      *owner;          /* plugin which shows the interface */
 
   NetstatusState  state;
   NetstatusStats  stats;
@@ -76,7 +98,15 @@ struct _NetstatusIfacePrivate
   GError         *error;
 
   int             sockfd;
-  guint           monitor_id;
+  guint           monitor_id;     /* subscription to sampler */
+  guint           poll_delay;     /* interval of monitor_id, 0 if paused */
+  guint           link_watch;     /* rtnetlink link notifications */
+  int             idle_polls;
+
+  NetstatusSample history [NETSTATUS_IFACE_HISTORY_SIZE];
+  int             history_len;
+  int             history_pos;    /* where the next sample goes */
+  gint64          last_poll_time; /* 0 if counters weren't read yet */
 
   guint           error_polling : 1;
   guint           is_wireless : 1;
@@ -94,10 +124,15 @@ static void     netstatus_iface_get_property    (GObject             *object,
 						 guint                property_id,
 						 GValue              *value,
 						 GParamSpec          *pspec);
-static gboolean netstatus_iface_monitor_timeout (NetstatusIface      *iface);
+static void     netstatus_iface_monitor_timeout (const LXPanelSysStat *stat,
+						 gpointer             data);
 static void     netstatus_iface_init_monitor    (NetstatusIface      *iface);
+static void     netstatus_iface_link_changed    (const LXPanelIfaceStat *ifs,
+						 LXPanelSysStatLinkEvent event,
+						 gpointer             data);
 
 static GObjectClass *parent_class;
+static guint iface_signals [LAST_SIGNAL] = { 0 };
 
 GType
 netstatus_iface_get_type (void)
@@ -192,6 +227,15 @@ netstatus_iface_class_init (NetstatusIfaceClass *klass)
 						       _("The current error condition"),
 						       NETSTATUS_TYPE_G_ERROR,
 						       G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+  iface_signals [SAMPLE_ADDED] =
+    g_signal_new ("sample-added",
+		  G_OBJECT_CLASS_TYPE (gobject_class),
+		  G_SIGNAL_RUN_LAST,
+		  0,
+		  NULL, NULL,
+		  g_cclosure_marshal_VOID__VOID,
+		  G_TYPE_NONE, 0);
 }
 
 static void
@@ -204,9 +248,13 @@ netstatus_iface_finalize (GObject *object)
   iface->priv->error = NULL;
 
   if (iface->priv->monitor_id)
-    g_source_remove (iface->priv->monitor_id);
+    lxpanel_sysstat_unsubscribe (iface->priv->monitor_id);
   iface->priv->monitor_id = 0;
 
+  if (iface->priv->link_watch)
+    lxpanel_sysstat_unwatch_links (iface->priv->link_watch);
+  iface->priv->link_watch = 0;
+
   if (iface->priv->sockfd)
     close (iface->priv->sockfd);
   iface->priv->sockfd = 0;
@@ -334,6 +382,57 @@ netstatus_iface_get_statistics (NetstatusIface *iface,
     *stats  = iface->priv->stats;
 }
 
+gboolean
+netstatus_iface_get_rates (NetstatusIface *iface,
+			   gdouble        *in_bytes,
+			   gdouble        *out_bytes,
+			   gdouble        *in_packets,
+			   gdouble        *out_packets)
+{
+  NetstatusSample *sample;
+  gdouble          seconds;
+
+  g_return_val_if_fail (NETSTATUS_IS_IFACE (iface), FALSE);
+
+  if (iface->priv->history_len == 0)
+    return FALSE;
+
+  sample = &iface->priv->history [(iface->priv->history_pos + NETSTATUS_IFACE_HISTORY_SIZE - 1)
+				  % NETSTATUS_IFACE_HISTORY_SIZE];
+  seconds = (gdouble) sample->interval / G_USEC_PER_SEC;
+
+  if (in_bytes)
+    *in_bytes = sample->in_bytes / seconds;
+  if (out_bytes)
+    *out_bytes = sample->out_bytes / seconds;
+  if (in_packets)
+    *in_packets = sample->in_packets / seconds;
+  if (out_packets)
+    *out_packets = sample->out_packets / seconds;
+
+  return TRUE;
+}
+
+gdouble
+netstatus_iface_get_peak_rate (NetstatusIface *iface)
+{
+  NetstatusSample *sample;
+  gdouble          peak = 0.0;
+  gdouble          seconds;
+  int              i;
+
+  g_return_val_if_fail (NETSTATUS_IS_IFACE (iface), 0.0);
+
+  for (i = 0; i < iface->priv->history_len; i++)
+    {
+      sample = &iface->priv->history [i];
+      seconds = (gdouble) sample->interval / G_USEC_PER_SEC;
+      peak = MAX (peak, MAX (sample->in_bytes, sample->out_bytes) / seconds);
+    }
+
+  return peak;
+}
+
 gboolean
 netstatus_iface_get_is_wireless (NetstatusIface *iface)
 {
@@ -479,41 +578,104 @@ netstatus_iface_poll_iface_statistics (NetstatusIface *iface,
   return TRUE;
 }
 
-static NetstatusState
-netstatus_iface_poll_state (NetstatusIface *iface)
+static inline gulong
+netstatus_counter_delta (gulong current,
+			 gulong previous)
 {
-  NetstatusState state;
-  struct ifreq   if_req;
-  gboolean       tx, rx;
-  int            fd;
-  gulong         in_packets, out_packets;
-  gulong         in_bytes, out_bytes;
+  /* counters are reset when the driver is reloaded */
+  return current >= previous ? current - previous : current;
+}
 
-  if (!(fd = netstatus_iface_get_sockfd (iface)))
-    return NETSTATUS_STATE_DISCONNECTED;
+/* Records change of counters since the previous poll, which are in stats. */
+static void
+netstatus_iface_add_sample (NetstatusIface *iface,
+			    gulong          in_packets,
+			    gulong          out_packets,
+			    gulong          in_bytes,
+			    gulong          out_bytes)
+{
+  NetstatusSample *sample;
+  gint64           now = g_get_monotonic_time ();
+  gint64           last = iface->priv->last_poll_time;
+
+  iface->priv->last_poll_time = now;
+  if (last == 0 || now <= last)
+    return;
 
-  memset (&if_req, 0, sizeof (struct ifreq));
-  strcpy (if_req.ifr_name, iface->priv->name);
+  sample = &iface->priv->history [iface->priv->history_pos];
+  sample->time        = now;
+  sample->interval    = now - last;
+  sample->in_packets  = netstatus_counter_delta (in_packets, iface->priv->stats.in_packets);
+  sample->out_packets = netstatus_counter_delta (out_packets, iface->priv->stats.out_packets);
+  sample->in_bytes    = netstatus_counter_delta (in_bytes, iface->priv->stats.in_bytes);
+  sample->out_bytes   = netstatus_counter_delta (out_bytes, iface->priv->stats.out_bytes);
 
-  if (ioctl (fd, SIOCGIFFLAGS, &if_req) < 0)
+  iface->priv->history_pos = (iface->priv->history_pos + 1) % NETSTATUS_IFACE_HISTORY_SIZE;
+  if (iface->priv->history_len < NETSTATUS_IFACE_HISTORY_SIZE)
+    iface->priv->history_len++;
+
+  g_signal_emit (iface, iface_signals [SAMPLE_ADDED], 0);
+}
+
+static NetstatusState
+netstatus_iface_poll_state (NetstatusIface       *iface,
+			    const LXPanelSysStat *stat)
+{
+  NetstatusState          state;
+  const LXPanelIfaceStat *ifs;
+  guint                   flags;
+  gboolean                tx, rx;
+  gulong                  in_packets, out_packets;
+  gulong                  in_bytes, out_bytes;
+
+  /* The sampler reads flags and counters of all interfaces at once, the
+   * ioctl and sysdeps are used only if it didn't find the interface. */
+  ifs = lxpanel_sysstat_find_iface (stat, iface->priv->name);
+  if (ifs)
     {
-      netstatus_iface_set_polling_error (iface,
-					 NETSTATUS_ERROR_IOCTL_IFFLAGS,
-					 _("SIOCGIFFLAGS error: %s"),
-					 g_strerror (errno));
-      return NETSTATUS_STATE_DISCONNECTED;
+      netstatus_iface_clear_error (iface, NETSTATUS_ERROR_IOCTL_IFFLAGS);
+      flags = ifs->flags;
     }
+  else
+    {
+      struct ifreq if_req;
+      int          fd;
+
+      if (!(fd = netstatus_iface_get_sockfd (iface)))
+	return NETSTATUS_STATE_DISCONNECTED;
+
+      memset (&if_req, 0, sizeof (struct ifreq));
+      strcpy (if_req.ifr_name, iface->priv->name);
+
+      if (ioctl (fd, SIOCGIFFLAGS, &if_req) < 0)
+	{
+	  netstatus_iface_set_polling_error (iface,
+					     NETSTATUS_ERROR_IOCTL_IFFLAGS,
+					     _("SIOCGIFFLAGS error: %s"),
+					     g_strerror (errno));
+	  return NETSTATUS_STATE_DISCONNECTED;
+	}
 
-  netstatus_iface_clear_error (iface, NETSTATUS_ERROR_IOCTL_IFFLAGS);
+      netstatus_iface_clear_error (iface, NETSTATUS_ERROR_IOCTL_IFFLAGS);
+      flags = (unsigned short) if_req.ifr_flags;
+    }
 
   dprintf (POLLING, "Interface is %sup and %srunning\n",
-	   if_req.ifr_flags & IFF_UP ? "" : "not ",
-	   if_req.ifr_flags & IFF_RUNNING ? "" : "not ");
+	   flags & IFF_UP ? "" : "not ",
+	   flags & IFF_RUNNING ? "" : "not ");
 
-  if (!(if_req.ifr_flags & IFF_UP) || !(if_req.ifr_flags & IFF_RUNNING))
+  if (!(flags & IFF_UP) || !(flags & IFF_RUNNING))
     return NETSTATUS_STATE_DISCONNECTED;
 
-  if (!netstatus_iface_poll_iface_statistics (iface, &in_packets, &out_packets, &in_bytes, &out_bytes))
+  if (ifs)
+    {
+      netstatus_iface_clear_error (iface, NETSTATUS_ERROR_STATISTICS);
+      in_packets  = ifs->rx_packets;
+      out_packets = ifs->tx_packets;
+      in_bytes    = ifs->rx_bytes;
+      out_bytes   = ifs->tx_bytes;
+    }
+  else if (!netstatus_iface_poll_iface_statistics (iface, &in_packets, &out_packets, &in_bytes, &out_bytes))
     return NETSTATUS_STATE_IDLE;
 
   dprintf (POLLING, "Packets in: %ld out: %ld. Prev in: %ld out: %ld\n",
@@ -523,6 +685,8 @@ netstatus_iface_poll_state (NetstatusIface *iface)
 	   in_bytes, out_bytes,
 	   iface->priv->stats.in_bytes, iface->priv->stats.out_bytes);
 
+  netstatus_iface_add_sample (iface, in_packets, out_packets, in_bytes, out_bytes);
+
   rx = in_packets  > iface->priv->stats.in_packets;
   tx = out_packets > iface->priv->stats.out_packets;
 
@@ -537,7 +701,8 @@ netstatus_iface_poll_state (NetstatusIface *iface)
 
   dprintf (POLLING, "State: %s\n", netstatus_get_state_string (state));
 
-  if (tx || rx)
+  if (in_packets != iface->priv->stats.in_packets ||
+      out_packets != iface->priv->stats.out_packets)
     {
       iface->priv->stats.in_packets  = in_packets;
       iface->priv->stats.out_packets = out_packets;
@@ -577,50 +742,105 @@ netstatus_iface_poll_wireless_details (NetstatusIface *iface,
 }
 
 static void
-netstatus_iface_increase_poll_delay_in_error (NetstatusIface *iface)
+netstatus_iface_set_poll_delay (NetstatusIface *iface,
+				guint           delay)
+{
+  if (iface->priv->poll_delay == delay)
+    return;
+
+  dprintf (POLLING, "Changing polling delay to %d\n", delay);
+
+  if (iface->priv->monitor_id)
+    lxpanel_sysstat_unsubscribe (iface->priv->monitor_id);
+  iface->priv->monitor_id = 0;
+  iface->priv->poll_delay = delay;
+
+  if (delay)
+    iface->priv->monitor_id = lxpanel_sysstat_subscribe (iface->priv->owner,
+							 LXPANEL_SYSSTAT_NET,
+							 delay,
+							 netstatus_iface_monitor_timeout,
+							 iface);
+}
+
+/* Polls are counted for the owner and slowed down while its panel is
+ * hidden, so subscribe again if polling already runs. */
+void
+netstatus_iface_set_owner (NetstatusIface *iface,
+			   GtkWidget      *owner)
+{
+  guint delay;
+
+  g_return_if_fail (NETSTATUS_IS_IFACE (iface));
+
+  if (iface->priv->owner == owner)
+    return;
+
+  iface->priv->owner = owner;
+  delay = iface->priv->poll_delay;
+  if (delay)
+    {
+      netstatus_iface_set_poll_delay (iface, 0);
+      netstatus_iface_set_poll_delay (iface, delay);
+    }
+}
+
+static void
+netstatus_iface_update_poll_delay (NetstatusIface *iface)
 {
   static int polls_in_error = 0;
+  guint      delay = NETSTATUS_IFACE_POLL_DELAY;
 
-  if (iface->priv->state == NETSTATUS_STATE_ERROR)
+  switch (iface->priv->state)
     {
+    case NETSTATUS_STATE_ERROR:
       dprintf (POLLING, "Interface in error state\n");
 
-      if (!iface->priv->error_polling &&
+      if (iface->priv->error_polling ||
 	  ++polls_in_error >= NETSTATUS_IFACE_POLLS_IN_ERROR)
 	{
-	  dprintf (POLLING, "Increasing polling delay after too many errors\n");
 	  iface->priv->error_polling = TRUE;
-	  g_source_remove (iface->priv->monitor_id);
-	  iface->priv->monitor_id = g_timeout_add (NETSTATUS_IFACE_ERROR_POLL_DELAY,
-						   (GSourceFunc) netstatus_iface_monitor_timeout,
-						   iface);
+	  delay = NETSTATUS_IFACE_ERROR_POLL_DELAY;
 	}
+      break;
+    case NETSTATUS_STATE_DISCONNECTED:
+      /* Link is down: nothing to poll until a link notification
+       * tells it is up again. */
+      if (iface->priv->link_watch)
+	delay = 0;
+      break;
+    case NETSTATUS_STATE_IDLE:
+      /* Traffic can start any time, so only poll less often. */
+      if (iface->priv->idle_polls >= NETSTATUS_IFACE_IDLE_POLLS)
+	delay = NETSTATUS_IFACE_IDLE_POLL_DELAY;
+      else
+	iface->priv->idle_polls++;
+      break;
+    default:
+      break;
     }
-  else if (iface->priv->error_polling)
-    {
-      dprintf (POLLING, "Recovered from errors. Increasing polling delay again\n");
 
+  if (iface->priv->state != NETSTATUS_STATE_ERROR)
+    {
       iface->priv->error_polling = FALSE;
       polls_in_error = 0;
-
-      g_source_remove (iface->priv->monitor_id);
-      iface->priv->monitor_id = g_timeout_add (NETSTATUS_IFACE_POLL_DELAY,
-					       (GSourceFunc) netstatus_iface_monitor_timeout,
-					       iface);
     }
+  if (iface->priv->state != NETSTATUS_STATE_IDLE)
+    iface->priv->idle_polls = 0;
+
+  netstatus_iface_set_poll_delay (iface, delay);
 }
 
-static gboolean
-netstatus_iface_monitor_timeout (NetstatusIface *iface)
+static void
+netstatus_iface_monitor_timeout (const LXPanelSysStat *stat,
+				 gpointer             data)
 {
-  NetstatusState state;
-  int            signal_strength;
-  gboolean       is_wireless;
-
-  if (g_source_is_destroyed(g_main_current_source()))
-    return FALSE;
+  NetstatusIface *iface = data;
+  NetstatusState  state;
+  int             signal_strength;
+  gboolean        is_wireless;
 
-  state = netstatus_iface_poll_state (iface);
+  state = netstatus_iface_poll_state (iface, stat);
 
   if (iface->priv->state != state &&
       iface->priv->state != NETSTATUS_STATE_ERROR)
@@ -642,9 +862,43 @@ netstatus_iface_monitor_timeout (NetstatusIface *iface)
       g_object_notify (G_OBJECT (iface), "signal-strength");
     }
 
-  netstatus_iface_increase_poll_delay_in_error (iface);
+  netstatus_iface_update_poll_delay (iface);
+}
 
-  return TRUE;
+static void
+netstatus_iface_link_changed (const LXPanelIfaceStat *ifs,
+			      LXPanelSysStatLinkEvent event,
+			      gpointer                data)
+{
+  NetstatusIface *iface = data;
+
+  if (event == LXPANEL_SYSSTAT_LINK_CLOSED)
+    {
+      /* No more notifications, poll even when the link is down. */
+      dprintf (POLLING, "Link notifications stopped\n");
+      iface->priv->link_watch = 0;
+      if (iface->priv->name)
+	netstatus_iface_update_poll_delay (iface);
+      return;
+    }
+
+  if (!iface->priv->name)
+    return;
+
+  if (ifs && strcmp (ifs->name, iface->priv->name) != 0)
+    return;
+
+  if (event == LXPANEL_SYSSTAT_LINK_ADDRESS)
+    {
+      /* State is the same but the dialog shows addresses for it. */
+      dprintf (POLLING, "Address of %s changed\n", iface->priv->name);
+      g_object_notify (G_OBJECT (iface), "state");
+      return;
+    }
+
+  /* Poll right away, it pauses polling again if the link is still down. */
+  dprintf (POLLING, "Link %s changed\n", iface->priv->name);
+  netstatus_iface_monitor_timeout (lxpanel_sysstat_read (LXPANEL_SYSSTAT_NET), iface);
 }
 
 static void
@@ -663,19 +917,26 @@ netstatus_iface_init_monitor (NetstatusIface *iface)
   g_object_notify (G_OBJECT (iface), "signal-strength");
   g_object_thaw_notify (G_OBJECT (iface));
 
+  iface->priv->idle_polls        = 0;
+  iface->priv->error_polling     = FALSE;
+  iface->priv->history_len       = 0;
+  iface->priv->history_pos       = 0;
+  iface->priv->last_poll_time    = 0;
+
   if (iface->priv->monitor_id)
-    {
-      dprintf (POLLING, "Removing existing monitor\n");
-      g_source_remove (iface->priv->monitor_id);
-      iface->priv->monitor_id = 0;
-    }
+    dprintf (POLLING, "Removing existing monitor\n");
+  netstatus_iface_set_poll_delay (iface, 0);
 
   if (iface->priv->name)
     {
+      /* Without link notifications the interface is polled even when
+       * the link is down. */
+      if (!iface->priv->link_watch)
+	iface->priv->link_watch = lxpanel_sysstat_watch_links (netstatus_iface_link_changed,
+							       iface);
+
       dprintf (POLLING, "Initialising monitor with delay of %d\n", NETSTATUS_IFACE_POLL_DELAY);
-      iface->priv->monitor_id = g_timeout_add (NETSTATUS_IFACE_POLL_DELAY,
-					       (GSourceFunc) netstatus_iface_monitor_timeout,
-					       iface);
+      netstatus_iface_set_poll_delay (iface, NETSTATUS_IFACE_POLL_DELAY);
 
       /* netstatus_iface_monitor_timeout (iface); */
     }
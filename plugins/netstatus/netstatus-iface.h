@@ -27,6 +27,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gtk/gtk.h>
 
 #include "netstatus-util.h"
 
@@ -61,12 +62,20 @@ GType                  netstatus_iface_get_type              (void) G_GNUC_CONST
 
 NetstatusIface *       netstatus_iface_new                   (const char      *name);
 
+void                   netstatus_iface_set_owner             (NetstatusIface  *iface,
+							      GtkWidget       *owner);
 const char *           netstatus_iface_get_name              (NetstatusIface  *iface);
 void                   netstatus_iface_set_name              (NetstatusIface  *iface,
 							      const char      *name);
 NetstatusState         netstatus_iface_get_state             (NetstatusIface  *iface);
 void                   netstatus_iface_get_statistics        (NetstatusIface  *iface,
 							      NetstatusStats  *stats);
+gboolean               netstatus_iface_get_rates             (NetstatusIface  *iface,
+							      gdouble         *in_bytes,
+							      gdouble         *out_bytes,
+							      gdouble         *in_packets,
+							      gdouble         *out_packets);
+gdouble                netstatus_iface_get_peak_rate         (NetstatusIface  *iface);
 gboolean               netstatus_iface_get_is_wireless       (NetstatusIface  *iface);
 int                    netstatus_iface_get_signal_strength   (NetstatusIface  *iface);
 
@@ -51,6 +51,7 @@
 #include "misc.h"
 #include "icon.xpm"
 #include "gtk-compat.h"
+#include "icon-argb.h"
 
 #define ALL_WORKSPACES       -1
 
@@ -65,10 +66,13 @@ static Atom a_NET_WM_STATE_MAXIMIZED_HORZ;
 typedef struct
 {
     Window win;                             /* X window ID */
+    TaskButton * button;                    /* button which holds the task */
     gint desktop;                           /* Desktop that contains task, needed to switch to it on Raise */
     gint monitor;                           /* Monitor that the window is on or closest to */
     char * name;                            /* Taskbar label when normal, from WM_NAME or NET_WM_NAME */
     GdkPixbuf * icon;           /* the taskbar icon */
+    GdkPixbuf * icon_src;       /* unscaled icon from _NET_WM_ICON, shared */
+    unsigned int icon_src_largest :1; /* icon_src is the largest but less than needed */
     GtkWidget * menu_item;      /* if menu_list exists then it's an item in it */
     Atom name_source;                       /* Atom that is the source of taskbar label */
     Atom image_source;                      /* Atom that is the source of taskbar icon */
@@ -249,13 +253,59 @@ static void free_task_details(TaskDetails *details)
     g_free(details->name);
     if (details->icon)
         g_object_unref(details->icon);
+    if (details->icon_src)
+        g_object_unref(details->icon_src);
     g_slice_free(TaskDetails, details);
 }
 
+/* Window index is shared by all buttons in the same parent widget and maps
+ * each X window ID into its TaskDetails, it is kept in parent object data. */
+static GHashTable *task_index_get(GtkWidget *parent, gboolean create)
+{
+    GHashTable *index;
+
+    if (parent == NULL)
+        return NULL;
+    index = g_object_get_data(G_OBJECT(parent), "task-button-index");
+    if (index == NULL && create)
+    {
+        index = g_hash_table_new(g_direct_hash, NULL);
+        g_object_set_data_full(G_OBJECT(parent), "task-button-index", index,
+                               (GDestroyNotify)g_hash_table_destroy);
+    }
+    return index;
+}
+
+static void task_index_add(TaskButton *task, TaskDetails *details)
+{
+    GHashTable *index = task_index_get(gtk_widget_get_parent(GTK_WIDGET(task)), TRUE);
+
+    details->button = task;
+    if (index)
+        g_hash_table_insert(index, GUINT_TO_POINTER(details->win), details);
+}
+
+static void task_index_remove(TaskButton *task, TaskDetails *details)
+{
+    GHashTable *index = task_index_get(gtk_widget_get_parent(GTK_WIDGET(task)), FALSE);
+
+    /* don't remove the entry if it was replaced already */
+    if (index && g_hash_table_lookup(index, GUINT_TO_POINTER(details->win)) == details)
+        g_hash_table_remove(index, GUINT_TO_POINTER(details->win));
+}
+
 static TaskDetails *task_details_lookup(TaskButton *task, Window win)
 {
+    GHashTable *index = task_index_get(gtk_widget_get_parent(GTK_WIDGET(task)), FALSE);
+    TaskDetails *details;
     GList *l;
 
+    if (index)
+    {
+        details = g_hash_table_lookup(index, GUINT_TO_POINTER(win));
+        return (details && details->button == task) ? details : NULL;
+    }
+    /* button isn't added into container yet */
     for (l = task->details; l; l = l->next)
         if (((TaskDetails *)l->data)->win == win)
             return l->data;
@@ -790,10 +840,222 @@ static GdkPixbuf * apply_mask(GdkPixbuf * pixbuf, GdkPixbuf * mask)
     return with_alpha;
 }
 
+/* Icons cache: all windows which have the same _NET_WM_ICON image share the
+ * same unscaled pixbuf, and that pixbuf keeps its scaled copies in object
+ * data. The cache doesn't hold references, entries are removed on finalize. */
+static GHashTable *icons_cache = NULL; /* hash of ARGB data -> GdkPixbuf */
+
+static guint icon_data_hash(const gulong *data, guint w, guint h)
+{
+    gulong i, len = (gulong)w * h;
+    guint hash = 2166136261U ^ (w << 16) ^ h;
+
+    /* FNV-1a over 32-bit values */
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (guint32)data[i]) * 16777619U;
+    return hash;
+}
+
+static gboolean icon_data_equal(const gulong *data, guint w, guint h, GdkPixbuf *pixbuf)
+{
+    const guint32 *p;
+    gulong i, len = (gulong)w * h;
+
+    if ((guint)gdk_pixbuf_get_width(pixbuf) != w || (guint)gdk_pixbuf_get_height(pixbuf) != h)
+        return FALSE;
+    /* rowstride of pixbufs in cache is always w * 4 */
+    p = (const guint32 *)gdk_pixbuf_get_pixels(pixbuf);
+    for (i = 0; i < len; i++)
+        if (p[i] != argb_to_rgba(data[i]))
+            return FALSE;
+    return TRUE;
+}
+
+static void icons_cache_remove(gpointer hash, GObject *pixbuf)
+{
+    /* entry might be replaced already by icon with the same hash */
+    if (g_hash_table_lookup(icons_cache, hash) == pixbuf)
+        g_hash_table_remove(icons_cache, hash);
+}
+
+/* Converts ARGB image from _NET_WM_ICON into pixbuf */
+static GdkPixbuf *icon_from_argb(const gulong *data, guint w, guint h)
+{
+    /* Allocate enough space for the pixel data and convert it. */
+    gulong len = (gulong)w * h;
+    guint32 * pixdata = g_new(guint32, len);
+
+    icon_argb_to_rgba(data, pixdata, len);
+
+    /* Initialize a pixmap with the pixel data. */
+    return gdk_pixbuf_new_from_data((guchar *)pixdata,
+                                    GDK_COLORSPACE_RGB,
+                                    TRUE, 8,    /* has_alpha, bits_per_sample */
+                                    w, h, w * 4,
+                                    (GdkPixbufDestroyNotify) g_free,
+                                    NULL);
+}
+
+/* Returns new reference to cached pixbuf for the image, adds it if not found */
+static GdkPixbuf *icons_cache_lookup(const gulong *data, guint w, guint h)
+{
+    guint hash = icon_data_hash(data, w, h);
+    GdkPixbuf *pixbuf;
+
+    if (icons_cache == NULL)
+        icons_cache = g_hash_table_new(g_direct_hash, NULL);
+    pixbuf = g_hash_table_lookup(icons_cache, GUINT_TO_POINTER(hash));
+    if (pixbuf != NULL && icon_data_equal(data, w, h, pixbuf))
+        return g_object_ref(pixbuf);
+    pixbuf = icon_from_argb(data, w, h);
+    g_hash_table_insert(icons_cache, GUINT_TO_POINTER(hash), pixbuf);
+    g_object_weak_ref(G_OBJECT(pixbuf), icons_cache_remove, GUINT_TO_POINTER(hash));
+    return pixbuf;
+}
+
+/* Returns new reference to scaled copy of cached pixbuf */
+static GdkPixbuf *icons_cache_get_scaled(GdkPixbuf *src, guint width, guint height)
+{
+    char key[32];
+    GdkPixbuf *scaled;
+
+    g_snprintf(key, sizeof(key), "task-icon-%ux%u", width, height);
+    scaled = g_object_get_data(G_OBJECT(src), key);
+    if (scaled == NULL)
+    {
+        scaled = gdk_pixbuf_scale_simple(src, width, height, GDK_INTERP_BILINEAR);
+        if (scaled == NULL)
+            return NULL;
+        g_object_set_data_full(G_OBJECT(src), key, scaled, g_object_unref);
+    }
+    return g_object_ref(scaled);
+}
+
+/* Bytes of _NET_WM_ICON which weren't transferred thanks to partial fetch */
+static guint64 icons_bytes_saved = 0;
+
+/* Retrieves one image from _NET_WM_ICON: the smallest one which is not less
+ * than required size, so it only needs downscaling, or else the largest one.
+ * Since some applications set many sizes, which may take megabytes, only the
+ * width and height header of each image is read until one is selected, then
+ * pixels of that image only. Returns data which should be freed with XFree().
+ * Sets largest to TRUE if there is no image with enough size in property. */
+static gulong *get_wm_icon_image(Display *xdisplay, Window win,
+                                 guint required_width, guint required_height,
+                                 guint *w_ret, guint *h_ret, gboolean *largest)
+{
+    Atom type = None;
+    int format;
+    gulong nitems;
+    gulong bytes_after;
+    gulong * data;
+    glong offset = 0;
+    glong total = 0;
+    glong fetched = 0;
+    glong max_offset = -1;
+    guint max_w = 0;
+    guint max_h = 0;
+    glong fit_offset = -1;
+    guint fit_w = 0;
+    guint fit_h = 0;
+
+    do
+    {
+        guint w, h;
+        gulong size;
+
+        /* Fetch width and height of the next image. */
+        data = NULL;
+        if (XGetWindowProperty(xdisplay, win, a_NET_WM_ICON, offset, 2, False,
+                               XA_CARDINAL, &type, &format, &nitems,
+                               &bytes_after, (void *) &data) != Success)
+            break;
+        if ((type != XA_CARDINAL) || (nitems < 2))
+        {
+            if (data != NULL)
+                XFree(data);
+            break;
+        }
+        w = data[0];
+        h = data[1];
+        size = (gulong)w * h;
+        XFree(data);
+        fetched += 2;
+        /* format 32 data is transferred as 4 bytes per item */
+        total = offset + 2 + bytes_after / 4;
+        offset += 2;
+
+        /* Bounds check the icon. Also check for invalid width and height,
+           see http://bugs.debian.org/cgi-bin/bugreport.cgi?bug=801319 */
+        if (size == 0 || w > 1024 || h > 1024 || offset + (glong)size > total)
+            break;
+
+        /* Rare special case: the desired size is the same as icon size. */
+        if ((required_width == w) && (required_height == h))
+        {
+            fit_offset = offset;
+            fit_w = w;
+            fit_h = h;
+            break;
+        }
+
+        /* If the icon is big enough and the smallest of such so far, capture it. */
+        if ((w >= required_width) && (h >= required_height)
+            && (fit_offset < 0 || size < (gulong)fit_w * fit_h))
+        {
+            fit_offset = offset;
+            fit_w = w;
+            fit_h = h;
+        }
+
+        /* If the icon is the largest so far, capture it. */
+        if ((w > max_w) && (h > max_h))
+        {
+            max_offset = offset;
+            max_w = w;
+            max_h = h;
+        }
+        offset += size;
+    } while (offset + 2 < total);
+
+    *largest = (fit_offset < 0);
+    if (fit_offset >= 0)
+    {
+        max_offset = fit_offset;
+        max_w = fit_w;
+        max_h = fit_h;
+    }
+    if (max_offset < 0)
+        return NULL;
+
+    /* Fetch pixels of selected image. */
+    data = NULL;
+    if (XGetWindowProperty(xdisplay, win, a_NET_WM_ICON, max_offset,
+                           (glong)max_w * max_h, False, XA_CARDINAL,
+                           &type, &format, &nitems, &bytes_after,
+                           (void *) &data) != Success)
+        return NULL;
+    /* property might be changed between requests, check it */
+    if ((type != XA_CARDINAL) || (nitems != (gulong)max_w * max_h))
+    {
+        if (data != NULL)
+            XFree(data);
+        return NULL;
+    }
+    fetched += nitems;
+    icons_bytes_saved += (total - fetched) * 4;
+    g_debug("_NET_WM_ICON %ux%u of window 0x%lx: fetched %ld of %ld bytes,"
+            " %" G_GUINT64_FORMAT " bytes saved in total", max_w, max_h,
+            win, fetched * 4, total * 4, icons_bytes_saved);
+    *w_ret = max_w;
+    *h_ret = max_h;
+    return data;
+}
+
 /* Get an icon from the window manager for a task, and scale it to a specified size. */
-static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
+static GdkPixbuf * get_wm_icon(TaskDetails * details, guint required_width,
                                guint required_height, Atom source,
-                               Atom * current_source, TaskButton * tb)
+                               TaskButton * tb)
 {
     /* The result. */
     GdkPixbuf * pixmap = NULL;
@@ -801,8 +1063,20 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
     int result = -1;
     Display *xdisplay = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
     GdkScreen *screen = gtk_widget_get_screen(GTK_WIDGET(tb));
+    Window task_win = details->win;
+    Atom * current_source = &details->image_source;
 
-    if ((source == None) || (source == a_NET_WM_ICON))
+    if ((source == None) && (details->icon_src != NULL)
+        && (details->icon_src_largest
+            || ((guint)gdk_pixbuf_get_width(details->icon_src) >= required_width
+                && (guint)gdk_pixbuf_get_height(details->icon_src) >= required_height)))
+    {
+        /* Property wasn't changed since last fetch, reuse the image. */
+        pixmap = g_object_ref(details->icon_src);
+        possible_source = a_NET_WM_ICON;
+        result = Success;
+    }
+    else if ((source == None) || (source == a_NET_WM_ICON))
     {
         /* Important Notes:
          * According to freedesktop.org document:
@@ -816,108 +1090,29 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
          * padded in the upper 4 bytes).
          */
 
-        /* Get the window property _NET_WM_ICON, if possible. */
-        Atom type = None;
-        int format;
-        gulong nitems;
-        gulong bytes_after;
-        gulong * data = NULL;
-        result = XGetWindowProperty(
-            xdisplay,
-            task_win,
-            a_NET_WM_ICON,
-            0, G_MAXLONG,
-            False, XA_CARDINAL,
-            &type, &format, &nitems, &bytes_after, (void *) &data);
-
-        /* Inspect the result to see if it is usable.  If not, and we got data, free it. */
-        if ((type != XA_CARDINAL) || (nitems <= 0))
-        {
-            if (data != NULL)
-                XFree(data);
-            result = -1;
-        }
+        /* Get the best image from window property _NET_WM_ICON, if possible. */
+        guint w, h;
+        gboolean largest;
+        gulong * data = get_wm_icon_image(xdisplay, task_win, required_width,
+                                          required_height, &w, &h, &largest);
 
-        /* If the result is usable, extract the icon from it. */
-        if (result == Success)
+        /* If an icon was extracted, find or convert it into a pixbuf. */
+        if (data != NULL)
         {
-            /* Get the largest icon available, unless there is one that is the desired size. */
-            /* FIXME: should we try to find an icon whose size is closest to
-             * required_width and required_height to reduce unnecessary resizing? */
-            gulong * pdata = data;
-            gulong * pdata_end = data + nitems;
-            gulong * max_icon = NULL;
-            gulong max_w = 0;
-            gulong max_h = 0;
-            while ((pdata + 2) < pdata_end)
-            {
-                /* Extract the width and height. */
-                guint w = pdata[0];
-                guint h = pdata[1];
-                gulong size = w * h;
-                pdata += 2;
-
-                /* Bounds check the icon. Also check for invalid width and height,
-                   see http://bugs.debian.org/cgi-bin/bugreport.cgi?bug=801319 */
-                if (size == 0 || w > 1024 || h > 1024 || pdata + size > pdata_end)
-                    break;
-
-                /* Rare special case: the desired size is the same as icon size. */
-                if ((required_width == w) && (required_height == h))
-                {
-                    max_icon = pdata;
-                    max_w = w;
-                    max_h = h;
-                    break;
-                }
-
-                /* If the icon is the largest so far, capture it. */
-                if ((w > max_w) && (h > max_h))
-                {
-                    max_icon = pdata;
-                    max_w = w;
-                    max_h = h;
-                }
-                pdata += size;
-            }
-
-            /* If an icon was extracted, convert it to a pixbuf.
-             * Its size is max_w and max_h. */
-            if (max_icon != NULL)
-            {
-                /* Allocate enough space for the pixel data. */
-                gulong len = max_w * max_h;
-                guchar * pixdata = g_new(guchar, len * 4);
-
-                /* Loop to convert the pixel data. */
-                guchar * p = pixdata;
-                gulong i;
-                for (i = 0; i < len; p += 4, i += 1)
-                {
-                    guint argb = max_icon[i];
-                    guint rgba = (argb << 8) | (argb >> 24);
-                    p[0] = rgba >> 24;
-                    p[1] = (rgba >> 16) & 0xff;
-                    p[2] = (rgba >> 8) & 0xff;
-                    p[3] = rgba & 0xff;
-                }
-
-                /* Initialize a pixmap with the pixel data. */
-                pixmap = gdk_pixbuf_new_from_data(
-                    pixdata,
-                    GDK_COLORSPACE_RGB,
-                    TRUE, 8,    /* has_alpha, bits_per_sample */
-                    max_w, max_h, max_w * 4,
-                    (GdkPixbufDestroyNotify) g_free,
-                    NULL);
-                possible_source = a_NET_WM_ICON;
-            }
-        else
-            result = -1;
+            pixmap = icons_cache_lookup(data, w, h);
+            possible_source = a_NET_WM_ICON;
+            result = Success;
+            /* remember the image so it can be reused on resize */
+            if (details->icon_src)
+                g_object_unref(details->icon_src);
+            details->icon_src = g_object_ref(pixmap);
+            details->icon_src_largest = largest;
 
             /* Free the X property data. */
             XFree(data);
         }
+        else
+            result = -1;
     }
 
     /* No icon available from _NET_WM_ICON.  Next try WM_HINTS, but do not overwrite _NET_WM_ICON. */
@@ -1038,6 +1233,12 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
         GdkPixbuf * ret;
 
         *current_source = possible_source;
+        if (possible_source != a_NET_WM_ICON && details->icon_src)
+        {
+            /* icon comes from other source now */
+            g_object_unref(details->icon_src);
+            details->icon_src = NULL;
+        }
         if (tb->flags.disable_taskbar_upscale)
         {
             guint w = gdk_pixbuf_get_width (pixmap);
@@ -1045,8 +1246,12 @@ static GdkPixbuf * get_wm_icon(Window task_win, guint required_width,
             if (w <= required_width || h <= required_height)
                 return pixmap;
         }
-        ret = gdk_pixbuf_scale_simple(pixmap, required_width, required_height,
-                                      GDK_INTERP_BILINEAR);
+        if (possible_source == a_NET_WM_ICON)
+            /* share scaled image with other windows */
+            ret = icons_cache_get_scaled(pixmap, required_width, required_height);
+        else
+            ret = gdk_pixbuf_scale_simple(pixmap, required_width, required_height,
+                                          GDK_INTERP_BILINEAR);
         g_object_unref(pixmap);
         return ret;
     }
@@ -1063,14 +1268,14 @@ static void _task_update_icon(TaskButton *task, TaskDetails *details, Atom sourc
     /* Get the icon from the window's hints. */
     if (details != NULL && pixbuf == NULL)
     {
-        pixbuf = get_wm_icon(details->win, task->icon_size, task->icon_size,
-                             source, &details->image_source, task);
+        pixbuf = get_wm_icon(details, task->icon_size, task->icon_size,
+                             source, task);
         if (pixbuf)
         {
             /* replace old cached image */
             if (details->icon)
                 g_object_unref(details->icon);
-            details->icon = g_object_ref_sink(pixbuf);
+            details->icon = pixbuf;
         }
         else
             /* use cached icon if available */
@@ -1402,6 +1607,25 @@ static void task_button_size_allocate(GtkWidget *widget, GtkAllocation *alloc)
             map_xwindow_animation(widget, ((TaskDetails *)l->data)->win, alloc);
 }
 
+static void task_button_parent_set(GtkWidget *widget, GtkWidget *prev_parent)
+{
+    TaskButton *tb = PANEL_TASK_BUTTON(widget);
+    GHashTable *index;
+    GList *l;
+
+    /* move all our windows from index of old parent into the new one */
+    index = task_index_get(prev_parent, FALSE);
+    if (index)
+        for (l = tb->details; l; l = l->next)
+            if (g_hash_table_lookup(index, GUINT_TO_POINTER(((TaskDetails *)l->data)->win)) == l->data)
+                g_hash_table_remove(index, GUINT_TO_POINTER(((TaskDetails *)l->data)->win));
+    for (l = tb->details; l; l = l->next)
+        task_index_add(tb, l->data);
+
+    if (GTK_WIDGET_CLASS(task_button_parent_class)->parent_set)
+        GTK_WIDGET_CLASS(task_button_parent_class)->parent_set(widget, prev_parent);
+}
+
 static void task_button_class_init(TaskButtonClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
@@ -1414,6 +1638,7 @@ static void task_button_class_init(TaskButtonClass *klass)
     widget_class->leave_notify_event = task_button_leave_notify_event;
     widget_class->scroll_event = task_button_scroll_event;
     widget_class->size_allocate = task_button_size_allocate;
+    widget_class->parent_set = task_button_parent_set;
 
     /**
      * Signal TaskButton::menu-built is emitted when GtkMenu is built
@@ -1496,14 +1721,21 @@ TaskButton *task_button_new(Window win, gint desk, gint desks, LXPanel *panel,
 
 gboolean task_button_has_window(TaskButton *button, Window win)
 {
-    GList *l;
-
     g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button), FALSE);
 
-    for (l = button->details; l; l = l->next)
-        if (((TaskDetails *)l->data)->win == win)
-            return TRUE;
-    return FALSE;
+    return (task_details_lookup(button, win) != NULL);
+}
+
+/* looks up the window among all buttons in the container */
+TaskButton *task_button_lookup(GtkWidget *parent, Window win)
+{
+    GHashTable *index = task_index_get(parent, FALSE);
+    TaskDetails *details;
+
+    if (index == NULL)
+        return NULL;
+    details = g_hash_table_lookup(index, GUINT_TO_POINTER(win));
+    return details ? details->button : NULL;
 }
 
 /* removes windows from button, that are missing in list */
@@ -1526,6 +1758,7 @@ void task_button_update_windows_list(TaskButton *button, Window *list, gint n)
         if (i >= n) /* not found, remove details now */
         {
             button->details = g_list_delete_link(button->details, l);
+            task_index_remove(button, details);
             free_task_details(details);
             if (button->last_focused == details)
                 button->last_focused = NULL;
@@ -1831,6 +2064,7 @@ gboolean task_button_add_window(TaskButton *button, Window win, const char *cl)
     /* fetch task details */
     details = task_details_for_window(button, win);
     button->details = g_list_append(button->details, details);
+    task_index_add(button, details);
     /* redraw label on the button if need */
     if (details->visible)
     {
@@ -1853,10 +2087,8 @@ gboolean task_button_drop_window(TaskButton *button, Window win, gboolean leave_
 
     if (leave_last && g_list_length(button->details) <= 1)
         return FALSE;
-    for (l = button->details; l; l = l->next)
-        if (((TaskDetails *)l->data)->win == win)
-            break;
-    if (l == NULL) /* not our window */
+    details = task_details_lookup(button, win);
+    if (details == NULL) /* not our window */
         return FALSE;
     if (g_list_length(button->details) == 1)
     {
@@ -1864,8 +2096,8 @@ gboolean task_button_drop_window(TaskButton *button, Window win, gboolean leave_
         gtk_widget_destroy(GTK_WIDGET(button));
         return TRUE;
     }
-    details = l->data;
-    button->details = g_list_delete_link(button->details, l);
+    button->details = g_list_remove(button->details, details);
+    task_index_remove(button, details);
     was_last_focused = (button->last_focused == details);
     if (was_last_focused)
         button->last_focused = NULL;
@@ -1888,7 +2120,7 @@ gboolean task_button_drop_window(TaskButton *button, Window win, gboolean leave_
 TaskButton *task_button_split(TaskButton *button)
 {
     TaskButton *sibling;
-    GList *llast;
+    GList *llast, *l;
 
     g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button), NULL);
 
@@ -1904,6 +2136,9 @@ TaskButton *task_button_split(TaskButton *button)
     llast = g_list_last(button->details);
     sibling->details = g_list_remove_link(button->details, llast);
     button->details = llast;
+    /* sibling has no parent yet, index will be updated when it gets one */
+    for (l = sibling->details; l; l = l->next)
+        ((TaskDetails *)l->data)->button = sibling;
     if (button->last_focused != llast->data)
     {
         /* focused item migrated to sibling */
@@ -1936,11 +2171,15 @@ TaskButton *task_button_split(TaskButton *button)
 /* merges buttons if they are the same class */
 gboolean task_button_merge(TaskButton *button, TaskButton *sibling)
 {
+    GList *l;
+
     g_return_val_if_fail(PANEL_IS_TASK_BUTTON(button) && PANEL_IS_TASK_BUTTON(sibling), FALSE);
 
     if (g_strcmp0(button->res_class, sibling->res_class) != 0)
         return FALSE;
     /* move data lists from sibling appending to button */
+    for (l = sibling->details; l; l = l->next)
+        task_index_add(button, l->data);
     button->details = g_list_concat(button->details, sibling->details);
     sibling->details = NULL;
     /* update visibility */
@@ -66,6 +66,8 @@ TaskButton *task_button_new(Window win, gint desk, gint desks, LXPanel *panel,
                             const char *cl, TaskShowFlags flags);
 
 gboolean task_button_has_window(TaskButton *button, Window win);
+/* looks up button containing window, should be called on button parent widget */
+TaskButton *task_button_lookup(GtkWidget *parent, Window win);
 /* removes windows from button, that are missing in list */
 void task_button_update_windows_list(TaskButton *button, Window *list, gint n);
 /* returns TRUE if found and updated */
@@ -31,6 +31,9 @@
 
 #include "plugin.h"
 #include "misc.h"
+#include "ticker.h"
+#include "sysfs.h"
+#include "graph.h"
 
 #include "dbg.h"
 
@@ -47,20 +50,28 @@
 #define MAX_NUM_SENSORS 10
 #define MAX_AUTOMATIC_CRITICAL_TEMP 150 /* in degrees Celsius */
 
+#define UPDATE_PERIOD 3000 /* ms */
+#define HISTORY_SIZE 100 /* samples, 5 minutes */
+#define GRAPH_MIN_TEMP 20 /* bottom of history graph, in degrees Celsius */
+#define BORDER_SIZE 2
+
 #if !GLIB_CHECK_VERSION(2, 40, 0)
 # define g_info(...) g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, __VA_ARGS__)
 #endif
 
-typedef gint (*GetTempFunc)(char const *);
+/* sysfs readers get place to keep opened attribute file */
+typedef gint (*GetTempFunc)(char const *, LXPanelSysfsAttr **);
 
 typedef struct thermal {
     LXPanel *panel;
     config_setting_t *settings;
     GtkWidget *namew;
+    GtkWidget *graph;           /* history of the hottest sensor */
     GString *tip;
     int warning1;
     int warning2;
-    int not_custom_levels, auto_sensor;
+    int not_custom_levels, auto_sensor, show_graph;
+    int critical_min;           /* top of history graph */
     char *sensor,
          *str_cl_normal,
          *str_cl_warning1,
@@ -74,13 +85,24 @@ typedef struct thermal {
     char *sensor_name[MAX_NUM_SENSORS];
     GetTempFunc get_temperature[MAX_NUM_SENSORS];
     GetTempFunc get_critical[MAX_NUM_SENSORS];
+    LXPanelSysfsAttr *temperature_attr[MAX_NUM_SENSORS];
     gint temperature[MAX_NUM_SENSORS];
     gint critical[MAX_NUM_SENSORS];
+    /* ring of last readings of all sensors, for tooltip statistics */
+    gint history[MAX_NUM_SENSORS][HISTORY_SIZE];
+    int history_len;
+    int history_pos;            /* where next readings go */
 } thermal;
 
+/* Sensors rarely come and go, so directories are scanned once and the result
+   is shared by all instances of plugin. It is scanned again only when user
+   applies settings, in case a driver was loaded meanwhile. */
+static thermal found_sensors;
+static gboolean sensors_scanned = FALSE;
+
 
 static gint
-proc_get_critical(char const* sensor_path){
+proc_get_critical(char const* sensor_path, LXPanelSysfsAttr **unused){
     FILE *state;
     char buf[ 256 ], sstmp [ 100 ];
     char* pstr;
@@ -112,85 +134,72 @@ proc_get_critical(char const* sensor_path){
 }
 
 static gint
-proc_get_temperature(char const* sensor_path){
-    FILE *state;
-    char buf[ 256 ], sstmp [ 100 ];
-    char* pstr;
+proc_get_temperature(char const* sensor_path, LXPanelSysfsAttr **attr){
+    const char *pstr;
 
     if(sensor_path == NULL) return -1;
 
-    snprintf(sstmp,sizeof(sstmp),"%s%s",sensor_path,PROC_THERMAL_TEMPF);
-
-    if (!(state = fopen( sstmp, "r"))) {
-        g_warning("thermal: cannot open %s", sstmp);
+    /* procfs file is short so it can be read the same way as sysfs one */
+    if (*attr == NULL)
+        *attr = lxpanel_sysfs_attr_new(sensor_path, PROC_THERMAL_TEMPF);
+    pstr = lxpanel_sysfs_attr_read(*attr);
+    if (pstr == NULL) {
+        g_warning("thermal: cannot read %s%s", sensor_path, PROC_THERMAL_TEMPF);
         return -1;
     }
 
-    while( fgets(buf, 256, state) &&
-            ! ( pstr = strstr(buf, "temperature:") ) );
+    pstr = strstr(pstr, "temperature:");
     if( pstr )
     {
         pstr += 12;
         while( *pstr && *pstr == ' ' )
             ++pstr;
 
-        pstr[strlen(pstr)-3] = '\0';
-        fclose(state);
+        /* atoi() stops at " C" */
         return atoi(pstr);
     }
 
-    fclose(state);
     return -1;
 }
 
-static gint _get_reading(const char *path, gboolean quiet)
+static gint _get_reading(LXPanelSysfsAttr **attr, const char *path, gboolean quiet)
 {
-    FILE *state;
-    char buf[256];
-    char* pstr;
+    gint64 value;
 
-    if (!(state = fopen(path, "r"))) {
+    if (*attr == NULL)
+        *attr = lxpanel_sysfs_attr_new(NULL, path);
+    if (!lxpanel_sysfs_attr_read_int(*attr, &value)) {
         if (!quiet)
-            g_warning("thermal: cannot open %s", path);
+            g_warning("thermal: cannot read %s", path);
         return -1;
     }
-
-    while( fgets(buf, 256, state) &&
-            ! ( pstr = buf ) );
-    if( pstr )
-    {
-        fclose(state);
-        return atoi(pstr)/1000;
-    }
-
-    fclose(state);
-    return -1;
+    return value / 1000;
 }
 
 static gint
-sysfs_get_critical(char const* sensor_path){
+sysfs_get_critical(char const* sensor_path, LXPanelSysfsAttr **attr){
     char sstmp [ 100 ];
 
     if(sensor_path == NULL) return -1;
 
     snprintf(sstmp,sizeof(sstmp),"%s%s",sensor_path,SYSFS_THERMAL_TRIP);
 
-    return _get_reading(sstmp, TRUE);
+    return _get_reading(attr, sstmp, TRUE);
 }
 
 static gint
-sysfs_get_temperature(char const* sensor_path){
+sysfs_get_temperature(char const* sensor_path, LXPanelSysfsAttr **attr){
     char sstmp [ 100 ];
 
     if(sensor_path == NULL) return -1;
 
     snprintf(sstmp,sizeof(sstmp),"%s%s",sensor_path,SYSFS_THERMAL_TEMPF);
 
-    return _get_reading(sstmp, FALSE);
+    return _get_reading(attr, sstmp, FALSE);
 }
 
 static gint
-hwmon_get_critical(char const* sensor_path)
+hwmon_get_critical(char const* sensor_path, LXPanelSysfsAttr **attr)
 {
     char sstmp [ 100 ];
     int spl;
@@ -203,15 +212,15 @@ hwmon_get_critical(char const* sensor_path)
 
     snprintf(sstmp, sizeof(sstmp), "%.*s_crit", spl, sensor_path);
 
-    return _get_reading(sstmp, TRUE);
+    return _get_reading(attr, sstmp, TRUE);
 }
 
 static gint
-hwmon_get_temperature(char const* sensor_path)
+hwmon_get_temperature(char const* sensor_path, LXPanelSysfsAttr **attr)
 {
     if(sensor_path == NULL) return -1;
 
-    return _get_reading(sensor_path, FALSE);
+    return _get_reading(attr, sensor_path, FALSE);
 }
 
 static gint get_temperature(thermal *th, gint *warn)
@@ -219,8 +228,13 @@ static gint get_temperature(thermal *th, gint *warn)
     gint max = -273;
     gint cur, i, w = 0;
 
+    /* read all sensors first, then evaluate */
+    for(i = 0; i < th->numsensors; i++)
+        th->temperature[i] = th->get_temperature[i](th->sensor_array[i], &th->temperature_attr[i]);
+
     for(i = 0; i < th->numsensors; i++){
-        cur = th->get_temperature[i](th->sensor_array[i]);
+        cur = th->temperature[i];
+        th->history[i][th->history_pos] = cur;
         if (w == 2) ; /* already warning2 */
         else if (th->not_custom_levels &&
                  th->critical[i] > 0 && cur >= th->critical[i] - 5)
@@ -237,20 +251,26 @@ static gint get_temperature(thermal *th, gint *warn)
             w = 1;
         if (cur > max)
             max = cur;
-        th->temperature[i] = cur;
     }
+    th->history_pos = (th->history_pos + 1) % HISTORY_SIZE;
+    if (th->history_len < HISTORY_SIZE)
+        th->history_len++;
     *warn = w;
 
     return max;
 }
 
+/* Trip points don't change so they are read once, files aren't kept open. */
 static gint get_critical(thermal *th)
 {
     gint min = MAX_AUTOMATIC_CRITICAL_TEMP;
     gint i;
+    LXPanelSysfsAttr *attr;
 
     for(i = 0; i < th->numsensors; i++){
-        th->critical[i] = th->get_critical[i](th->sensor_array[i]);
+        attr = NULL;
+        th->critical[i] = th->get_critical[i](th->sensor_array[i], &attr);
+        lxpanel_sysfs_attr_free(attr);
         if (th->critical[i] > 0 && th->critical[i] < min)
             min = th->critical[i];
     }
@@ -258,19 +278,78 @@ static gint get_critical(thermal *th)
     return min;
 }
 
+/* Minimum, maximum, and average of readings of sensor in history. */
+static gboolean get_history_stats(thermal *th, int sensor, gint *min, gint *max, gint *avg)
+{
+    int k, n = 0, sum = 0;
+
+    *min = G_MAXINT;
+    *max = G_MININT;
+    for (k = 0; k < th->history_len; k++)
+    {
+        gint value = th->history[sensor][k];
+        if (value == -1)
+            continue;
+        *min = MIN(*min, value);
+        *max = MAX(*max, value);
+        sum += value;
+        n++;
+    }
+    if (n == 0)
+        return FALSE;
+    *avg = sum / n;
+    return TRUE;
+}
+
+/* Draws a column of history graph, in color of warning level. */
+static void draw_sample(cairo_t *cr, gint x, gint height, const gfloat *values,
+                        guint n_values, gpointer user_data)
+{
+    thermal *th = user_data;
+    GdkColor *color;
+
+    if (values[0] <= 0.0)
+        return;
+    if (values[1] >= 2)
+        color = &th->cl_warning2;
+    else if (values[1] >= 1)
+        color = &th->cl_warning1;
+    else
+        color = &th->cl_normal;
+    gdk_cairo_set_source_color(cr, color);
+    cairo_rectangle(cr, x, height - values[0] * height, 1, values[0] * height);
+    cairo_fill(cr);
+}
+
+static void update_graph(thermal *th, gint temp, gint warn)
+{
+    gfloat *sample = panel_graph_new_sample(PANEL_GRAPH(th->graph));
+    gint top = MAX(th->critical_min, th->warning2);
+
+    if (sample == NULL)
+        return;
+    if (temp == -1 || top <= GRAPH_MIN_TEMP)
+        sample[0] = 0.0;
+    else
+        sample[0] = CLAMP((gfloat)(temp - GRAPH_MIN_TEMP) / (top - GRAPH_MIN_TEMP), 0.0, 1.0);
+    sample[1] = warn;
+    panel_graph_commit_sample(PANEL_GRAPH(th->graph));
+}
+
 static void
 update_display(thermal *th)
 {
     char buffer [60];
     int i;
-    int temp;
+    int temp, warn;
+    gint min, max, avg;
     GdkColor color;
     gchar *separator;
 
-    temp = get_temperature(th, &i);
-    if (i >= 2)
+    temp = get_temperature(th, &warn);
+    if (warn >= 2)
         color = th->cl_warning2;
-    else if (i >= 1)
+    else if (warn >= 1)
         color = th->cl_warning1;
     else
         color = th->cl_normal;
@@ -283,20 +362,23 @@ update_display(thermal *th)
                  gcolor2rgb24(&color), temp);
         gtk_label_set_markup (GTK_LABEL(th->namew), buffer) ;
     }
+    if (th->show_graph)
+        update_graph(th, temp, warn);
 
     g_string_truncate(th->tip, 0);
     separator = "";
     for (i = 0; i < th->numsensors; i++){
         g_string_append_printf(th->tip, "%s%s:\t%2d°C", separator, th->sensor_name[i], th->temperature[i]);
+        if (th->history_len > 1 && get_history_stats(th, i, &min, &max, &avg))
+            g_string_append_printf(th->tip, _("\t(min %d, avg %d, max %d)"), min, avg, max);
         separator = "\n";
     }
     gtk_widget_set_tooltip_text(th->namew, th->tip->str);
+    gtk_widget_set_tooltip_text(th->graph, th->tip->str);
 }
 
 static gboolean update_display_timeout(gpointer user_data)
 {
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
     update_display(user_data);
     return TRUE; /* repeat later */
 }
@@ -315,6 +397,7 @@ add_sensor(thermal* th, char const* sensor_path, const char *sensor_name,
     th->sensor_name[th->numsensors] = g_strdup(sensor_name);
     th->get_critical[th->numsensors] = get_crit;
     th->get_temperature[th->numsensors] = get_temp;
+    th->temperature_attr[th->numsensors] = NULL;
     th->numsensors++;
 
     g_debug("thermal: Added sensor %s", sensor_path);
@@ -422,24 +505,42 @@ remove_all_sensors(thermal *th)
     {
         g_free(th->sensor_array[i]);
         g_free(th->sensor_name[i]);
+        lxpanel_sysfs_attr_free(th->temperature_attr[i]);
     }
 
     th->numsensors = 0;
+    th->history_len = th->history_pos = 0;
 }
 
 static void
-check_sensors( thermal *th )
+check_sensors( thermal *th, gboolean rescan )
 {
-    // FIXME: scan in opposite order
-    find_sensors(th, PROC_THERMAL_DIRECTORY, NULL, proc_get_temperature, proc_get_critical);
-    find_sensors(th, SYSFS_THERMAL_DIRECTORY, SYSFS_THERMAL_SUBDIR_PREFIX, sysfs_get_temperature, sysfs_get_critical);
-    if (th->numsensors == 0)
-        find_hwmon_sensors(th);
-    g_info("thermal: Found %d sensors", th->numsensors);
+    int i;
+
+    if (rescan && sensors_scanned)
+    {
+        remove_all_sensors(&found_sensors);
+        sensors_scanned = FALSE;
+    }
+    if (!sensors_scanned)
+    {
+        thermal *found = &found_sensors;
+
+        // FIXME: scan in opposite order
+        find_sensors(found, PROC_THERMAL_DIRECTORY, NULL, proc_get_temperature, proc_get_critical);
+        find_sensors(found, SYSFS_THERMAL_DIRECTORY, SYSFS_THERMAL_SUBDIR_PREFIX, sysfs_get_temperature, sysfs_get_critical);
+        if (found->numsensors == 0)
+            find_hwmon_sensors(found);
+        g_info("thermal: Found %d sensors", found->numsensors);
+        sensors_scanned = TRUE;
+    }
+    for (i = 0; i < found_sensors.numsensors; i++)
+        add_sensor(th, found_sensors.sensor_array[i], found_sensors.sensor_name[i],
+                   found_sensors.get_temperature[i], found_sensors.get_critical[i]);
 }
 
 
-static gboolean applyConfig(gpointer p)
+static void thermal_apply(GtkWidget *p, gboolean rescan)
 {
     thermal *th = lxpanel_plugin_get_data(p);
     int critical;
@@ -452,7 +553,7 @@ static gboolean applyConfig(gpointer p)
     remove_all_sensors(th);
     /* FIXME: support wildcards in th->sensor */
     if(th->sensor == NULL) th->auto_sensor = TRUE;
-    if(th->auto_sensor) check_sensors(th);
+    if(th->auto_sensor) check_sensors(th, rescan);
     else if (strncmp(th->sensor, "/sys/", 5) != 0)
         add_sensor(th, th->sensor, th->sensor, proc_get_temperature, proc_get_critical);
     else if (strncmp(th->sensor, "/sys/class/hwmon/", 17) != 0)
@@ -461,6 +562,7 @@ static gboolean applyConfig(gpointer p)
         add_sensor(th, th->sensor, th->sensor, hwmon_get_temperature, hwmon_get_critical);
 
     critical = get_critical(th);
+    th->critical_min = critical;
 
     if(th->not_custom_levels){
         th->warning1 = critical - 10;
@@ -477,7 +579,22 @@ static gboolean applyConfig(gpointer p)
     config_group_set_int(th->settings, "Warning2Temp", th->warning2);
     config_group_set_int(th->settings, "AutomaticSensor", th->auto_sensor);
     config_group_set_string(th->settings, "Sensor", th->sensor);
-    RET(FALSE);
+    config_group_set_int(th->settings, "ShowHistory", th->show_graph);
+
+    /* sensors might change so start history again */
+    panel_graph_set_n_values(PANEL_GRAPH(th->graph), 0);
+    panel_graph_set_n_values(PANEL_GRAPH(th->graph), 2);
+    if (th->show_graph)
+        gtk_widget_show(th->graph);
+    else
+        gtk_widget_hide(th->graph);
+    RET();
+}
+
+static gboolean applyConfig(gpointer p)
+{
+    thermal_apply(p, TRUE);
+    return FALSE;
 }
 
 static void
@@ -492,7 +609,7 @@ thermal_destructor(gpointer user_data)
   g_free(th->str_cl_normal);
   g_free(th->str_cl_warning1);
   g_free(th->str_cl_warning2);
-  g_source_remove(th->timer);
+  lxpanel_tick_remove(th->timer);
   g_free(th);
   RET();
 }
@@ -501,7 +618,7 @@ static GtkWidget *
 thermal_constructor(LXPanel *panel, config_setting_t *settings)
 {
     thermal *th;
-    GtkWidget *p;
+    GtkWidget *p, *box;
     const char *tmp;
 
     ENTER;
@@ -513,8 +630,16 @@ thermal_constructor(LXPanel *panel, config_setting_t *settings)
     lxpanel_plugin_set_data(p, th, thermal_destructor);
     gtk_widget_set_has_window(p, FALSE);
 
+    box = gtk_hbox_new(FALSE, 2);
+    gtk_container_add(GTK_CONTAINER(p), box);
+    gtk_widget_show(box);
+
     th->namew = gtk_label_new("ww");
-    gtk_container_add(GTK_CONTAINER(p), th->namew);
+    gtk_box_pack_start(GTK_BOX(box), th->namew, FALSE, FALSE, 0);
+
+    th->graph = panel_graph_new(2, BORDER_SIZE, draw_sample, th);
+    gtk_widget_set_size_request(th->graph, 30, -1);
+    gtk_box_pack_start(GTK_BOX(box), th->graph, FALSE, FALSE, 0);
 
     th->tip = g_string_new(NULL);
 
@@ -537,6 +662,7 @@ thermal_constructor(LXPanel *panel, config_setting_t *settings)
         th->sensor = g_strdup(tmp);
     config_setting_lookup_int(settings, "Warning1Temp", &th->warning1);
     config_setting_lookup_int(settings, "Warning2Temp", &th->warning2);
+    config_setting_lookup_int(settings, "ShowHistory", &th->show_graph);
 
     if(!th->str_cl_normal)
         th->str_cl_normal = g_strdup("#00ff00");
@@ -545,12 +671,12 @@ thermal_constructor(LXPanel *panel, config_setting_t *settings)
     if(!th->str_cl_warning2)
         th->str_cl_warning2 = g_strdup("#ff0000");
 
-    applyConfig(p);
+    thermal_apply(p, FALSE);
 
     gtk_widget_show(th->namew);
 
     update_display(th);
-    th->timer = g_timeout_add_seconds(3, (GSourceFunc) update_display_timeout, (gpointer)th);
+    th->timer = lxpanel_tick_add(p, UPDATE_PERIOD, update_display_timeout, th);
 
     RET(p);
 }
@@ -571,6 +697,7 @@ static GtkWidget *config(LXPanel *panel, GtkWidget *p)
             _("Automatic temperature levels"), &th->not_custom_levels, CONF_TYPE_BOOL, // FIXME: if off, disable two below
             _("Warning1 temperature"), &th->warning1, CONF_TYPE_INT,
             _("Warning2 temperature"), &th->warning2, CONF_TYPE_INT,
+            _("Show history graph"), &th->show_graph, CONF_TYPE_BOOL,
             NULL);
 
     RET(dialog);
@@ -28,61 +28,172 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+/* Containers with fewer children are just scanned, indexes don't pay off */
+#define CONF_INDEX_MIN_SIZE 8
+/* Number of settings allocated at once */
+#define CONF_BLOCK_SIZE 128
 
 struct _config_setting_t
 {
     config_setting_t *next;
     config_setting_t *parent;
+    PanelConf *conf; /* config the setting is allocated from */
     PanelConfType type;
     PanelConfSaveHook hook;
     gpointer hook_data;
-    char *name;
+    const char *name; /* interned in conf->strings */
     union {
         gint num; /* for integer or boolean */
-        gchar *str; /* for string */
-        config_setting_t *first; /* for group or list */
+        struct { /* for string */
+            gchar *str;
+            gboolean str_allocated; /* FALSE if str is in conf->buffers */
+        };
+        struct { /* for group or list */
+            config_setting_t *first;
+            config_setting_t *last;
+            guint n_children;
+            GHashTable *members; /* name -> first such child, built on demand */
+            GPtrArray *elems; /* index -> child, built on demand */
+        };
     };
 };
 
+typedef struct {
+    char *data;
+    size_t size; /* size of mapping or 0 if data is allocated */
+} ConfBuffer;
+
 struct _PanelConf
 {
     config_setting_t *root;
+    GStringChunk *strings; /* names of settings */
+    GSList *blocks; /* arrays of CONF_BLOCK_SIZE settings, first is in use */
+    guint block_used; /* number of settings taken from blocks->data */
+    config_setting_t *free_list; /* settings to reuse, linked by next */
+    GSList *buffers; /* contents of files read, string values point there */
+    guint dirty : 1; /* changed since read or written */
+    guint has_hooks : 1; /* settings saved by hooks can change any time */
 };
 
-static config_setting_t *_config_setting_t_new(config_setting_t *parent, int index,
-                                               const char *name, PanelConfType type)
+static config_setting_t *_config_setting_alloc(PanelConf *conf)
 {
     config_setting_t *s;
-    s = g_slice_new0(config_setting_t);
-    s->type = type;
-    s->name = g_strdup(name);
-    if (parent == NULL || (parent->type != PANEL_CONF_TYPE_GROUP && parent->type != PANEL_CONF_TYPE_LIST))
-        return s;
-    s->parent = parent;
-    if (parent->first == NULL || index == 0)
+
+    if (conf->free_list != NULL)
     {
-        s->next = parent->first;
-        parent->first = s;
+        s = conf->free_list;
+        conf->free_list = s->next;
     }
     else
     {
-        for (parent = parent->first; parent->next && index != 1; parent = parent->next)
-            index--;
-        /* FIXME: check if index is out of range? */
-        s->next = parent->next;
-        parent->next = s;
+        if (conf->blocks == NULL || conf->block_used == CONF_BLOCK_SIZE)
+        {
+            conf->blocks = g_slist_prepend(conf->blocks,
+                                           g_new(config_setting_t, CONF_BLOCK_SIZE));
+            conf->block_used = 0;
+        }
+        s = (config_setting_t *)conf->blocks->data + conf->block_used++;
     }
+    memset(s, 0, sizeof(config_setting_t));
+    s->conf = conf;
+    return s;
+}
+
+static void _config_setting_drop_index(config_setting_t *setting)
+{
+    if (setting->members)
+        g_hash_table_destroy(setting->members);
+    setting->members = NULL;
+    if (setting->elems)
+        g_ptr_array_free(setting->elems, TRUE);
+    setting->elems = NULL;
+}
+
+/* inserts setting into parent after prev, or as first one if prev is NULL */
+static void _config_setting_link(config_setting_t *setting, config_setting_t *parent,
+                                 config_setting_t *prev)
+{
+    setting->parent = parent;
+    if (prev == NULL)
+    {
+        setting->next = parent->first;
+        parent->first = setting;
+    }
+    else
+    {
+        setting->next = prev->next;
+        prev->next = setting;
+    }
+    parent->n_children++;
+    parent->conf->dirty = TRUE;
+    if (setting->next != NULL)
+    {
+        /* indexes of following children are changed */
+        _config_setting_drop_index(parent);
+        return;
+    }
+    /* appending keeps indexes valid, update them */
+    parent->last = setting;
+    if (parent->members && !g_hash_table_lookup(parent->members, setting->name))
+        g_hash_table_insert(parent->members, (gpointer)setting->name, setting);
+    if (parent->elems)
+        g_ptr_array_add(parent->elems, setting);
+}
+
+static void _config_setting_unlink(config_setting_t *setting)
+{
+    config_setting_t *parent = setting->parent, *prev = NULL;
+
+    if (parent->first == setting)
+        parent->first = setting->next;
+    else
+    {
+        prev = parent->first;
+        while (prev->next != NULL && prev->next != setting)
+            prev = prev->next;
+        g_assert(prev->next != NULL);
+        prev->next = setting->next;
+    }
+    if (parent->last == setting)
+        parent->last = prev;
+    parent->n_children--;
+    parent->conf->dirty = TRUE;
+    _config_setting_drop_index(parent);
+    setting->next = NULL;
+    setting->parent = NULL;
+}
+
+static config_setting_t *_config_setting_t_new(PanelConf *conf, config_setting_t *parent,
+                                               const char *name, PanelConfType type)
+{
+    config_setting_t *s;
+    s = _config_setting_alloc(conf);
+    s->type = type;
+    if (name)
+        s->name = g_string_chunk_insert_const(conf->strings, name);
+    if (parent == NULL || (parent->type != PANEL_CONF_TYPE_GROUP && parent->type != PANEL_CONF_TYPE_LIST))
+        return s;
+    _config_setting_link(s, parent, parent->last);
     return s;
 }
 
 /* frees data, not removes from parent */
 static void _config_setting_t_free(config_setting_t *setting)
 {
-    g_free(setting->name);
+    PanelConf *conf = setting->conf;
+
     switch (setting->type)
     {
     case PANEL_CONF_TYPE_STRING:
-        g_free(setting->str);
+        if (setting->str_allocated)
+            g_free(setting->str);
         break;
     case PANEL_CONF_TYPE_GROUP:
     case PANEL_CONF_TYPE_LIST:
@@ -92,11 +203,14 @@ static void _config_setting_t_free(config_setting_t *setting)
             setting->first = s->next;
             _config_setting_t_free(s);
         }
+        _config_setting_drop_index(setting);
         break;
     case PANEL_CONF_TYPE_INT:
         break;
     }
-    g_slice_free(config_setting_t, setting);
+    /* name stays in conf->strings, it may be shared with other settings */
+    setting->next = conf->free_list;
+    conf->free_list = setting;
 }
 
 /* the same as above but removes from parent */
@@ -105,16 +219,7 @@ static void _config_setting_t_remove(config_setting_t *setting)
     g_return_if_fail(setting->parent);
     g_return_if_fail(setting->parent->type == PANEL_CONF_TYPE_GROUP || setting->parent->type == PANEL_CONF_TYPE_LIST);
     /* remove from parent */
-    if (setting->parent->first == setting)
-        setting->parent->first = setting->next;
-    else
-    {
-        config_setting_t *s = setting->parent->first;
-        while (s->next != NULL && s->next != setting)
-            s = s->next;
-        g_assert(s->next != NULL);
-        s->next = setting->next;
-    }
+    _config_setting_unlink(setting);
     /* free the data */
     _config_setting_t_free(setting);
 }
@@ -122,6 +227,18 @@ static void _config_setting_t_remove(config_setting_t *setting)
 static config_setting_t * _config_setting_get_member(const config_setting_t * setting, const char * name)
 {
     config_setting_t *s;
+
+    if (setting->members == NULL && setting->n_children >= CONF_INDEX_MIN_SIZE)
+    {
+        /* the index is a cache, so it is fine to build it on const setting */
+        GHashTable *members = g_hash_table_new(g_str_hash, g_str_equal);
+        for (s = setting->first; s; s = s->next)
+            if (!g_hash_table_lookup(members, s->name))
+                g_hash_table_insert(members, (gpointer)s->name, s);
+        ((config_setting_t *)setting)->members = members;
+    }
+    if (setting->members)
+        return g_hash_table_lookup(setting->members, name);
     for (s = setting->first; s; s = s->next)
         if (g_strcmp0(s->name, name) == 0)
             break;
@@ -141,41 +258,143 @@ static config_setting_t * _config_setting_try_add(config_setting_t * parent,
     if (parent->type == PANEL_CONF_TYPE_GROUP &&
         (s = _config_setting_get_member(parent, name)))
         return (s->type == type) ? s : NULL;
-    return _config_setting_t_new(parent, -1, name, type);
+    return _config_setting_t_new(parent->conf, parent, name, type);
 }
 
 PanelConf *config_new(void)
 {
-    PanelConf *c = g_slice_new(PanelConf);
-    c->root = _config_setting_t_new(NULL, -1, NULL, PANEL_CONF_TYPE_GROUP);
+    PanelConf *c = g_slice_new0(PanelConf);
+    c->strings = g_string_chunk_new(4096);
+    c->root = _config_setting_t_new(c, NULL, NULL, PANEL_CONF_TYPE_GROUP);
     return c;
 }
 
 void config_destroy(PanelConf * config)
 {
+    GSList *l;
+
+    /* free strings and indexes allocated outside of config */
     _config_setting_t_free(config->root);
+    for (l = config->blocks; l; l = l->next)
+        g_free(l->data);
+    g_slist_free(config->blocks);
+    for (l = config->buffers; l; l = l->next)
+    {
+        ConfBuffer *b = l->data;
+        if (b->size)
+            munmap(b->data, b->size);
+        else
+            g_free(b->data);
+        g_slice_free(ConfBuffer, b);
+    }
+    g_slist_free(config->buffers);
+    g_string_chunk_free(config->strings);
     g_slice_free(PanelConf, config);
 }
 
-gboolean config_read_file(PanelConf * config, const char * filename)
+/* Returns contents of file terminated by '\0'. It is kept until config is
+   destroyed because string values point into it. */
+static char *_config_load_file(PanelConf *config, const char *filename)
 {
-    FILE *f = fopen(filename, "r");
-    size_t size;
-    char *buff, *c, *name, *end, *p;
+    struct stat st;
+    ConfBuffer *b;
+    char *data = MAP_FAILED;
+    size_t page = sysconf(_SC_PAGESIZE), size, i;
+    ssize_t len;
+    int fd;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0)
+    {
+        i = errno;
+        close(fd);
+        errno = i;
+        return NULL;
+    }
+    size = st.st_size;
+    b = g_slice_new(ConfBuffer);
+    /* the rest of last page after end of file is zeroed by mmap() and that
+       terminates the data, so file of exact number of pages is read */
+    if (size % page != 0)
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+    {
+        /* get private copy of every page now, an editor may truncate the
+           file later and then access to a shared page would crash */
+        for (i = 0; i < size; i += page)
+            ((volatile char *)data)[i] = data[i];
+        b->size = size;
+    }
+    else
+    {
+        data = g_malloc(size + 1);
+        for (i = 0; i < size; i += len)
+        {
+            len = read(fd, data + i, size - i);
+            if (len < 0 && errno == EINTR)
+                len = 0;
+            else if (len <= 0)
+                break;
+        }
+        data[i] = '\0';
+        b->size = 0;
+    }
+    close(fd);
+    b->data = data;
+    config->buffers = g_slist_prepend(config->buffers, b);
+    return data;
+}
+
+/* Warns and returns TRUE to continue if error is NULL, otherwise fills it
+   and returns FALSE. */
+static gboolean _config_report(PanelConfError *error, const char *filename,
+                               PanelConfErrorCode code, guint line, guint column,
+                               const char *message)
+{
+    if (error == NULL)
+    {
+        g_warning("config: %s:%u:%u: %s", filename, line, column, message);
+        return TRUE;
+    }
+    error->code = code;
+    error->line = line;
+    error->column = column;
+    error->message = message;
+    return FALSE;
+}
+
+#define REPORT(_code,_pos,_message) do { \
+    if (!_config_report(error, filename, _code, line, (_pos) - line_start + 1, _message)) \
+        return FALSE; \
+} while (0)
+
+/* Parses the file in place, names and values are terminated by '\0' right
+   there. Stops on the first error if error isn't NULL. */
+static gboolean _config_read(PanelConf * config, const char * filename,
+                             PanelConfError * error)
+{
+    char *buff, *c, *name, *end, *p, *line_start;
     config_setting_t *s, *parent;
+    guint line = 1;
+    long num;
+    gboolean was_dirty = config->dirty;
 
-    if (f == NULL)
+    buff = _config_load_file(config, filename);
+    if (buff == NULL)
+    {
+        if (error)
+        {
+            error->code = PANEL_CONF_ERROR_IO;
+            error->line = error->column = 0;
+            error->message = g_strerror(errno);
+        }
         return FALSE;
-    fseek(f, 0L, SEEK_END);
-    size = ftell(f);
-    rewind(f);
-    buff = g_malloc(size + 1);
-    size = fread(buff, 1, size, f);
-    fclose(f);
-    buff[size] = '\0';
+    }
     name = NULL;
     parent = config->root;
-    for (c = buff; *c; )
+    for (c = line_start = buff; *c; )
     {
         switch(*c)
         {
@@ -187,8 +406,12 @@ _skip_all:
                 break;
             /* continue with EOL */
         case '\n':
+            if (name)
+                REPORT(PANEL_CONF_ERROR_SYNTAX, name, "statement without value");
             name = NULL;
             c++;
+            line++;
+            line_start = c;
             break;
         case ' ':
         case '\t':
@@ -201,14 +424,17 @@ _skip_all:
                 *c++ = '\0';
             else
             {
-                g_warning("config: invalid scalar definition");
+                REPORT(PANEL_CONF_ERROR_SYNTAX, c, "value without name");
                 goto _skip_all;
             }
             while (*c == ' ' || *c == '\t')
                 c++; /* skip spaces after '=' */
-            if (name == NULL || *c == '\0' || *c == '\n') /* invalid statement */
+            if (*c == '\0' || *c == '\n') /* empty value, ignore it */
+            {
+                name = NULL;
                 break;
-            size = strtol(c, &end, 10);
+            }
+            num = strtol(c, &end, 10);
             while (*end == ' ' || *end == '\t')
                 end++; /* skip trailing spaces */
             if (*end == '\0' || *end == '\n')
@@ -216,11 +442,12 @@ _skip_all:
                 s = _config_setting_try_add(parent, name, PANEL_CONF_TYPE_INT);
                 if (s)
                 {
-                    s->num = (int)size;
+                    s->num = (int)num;
                     /* g_debug("config loader: got new int %s: %d", name, s->num); */
                 }
                 else
-                    g_warning("config: duplicate setting '%s' conflicts, ignored", name);
+                    REPORT(PANEL_CONF_ERROR_CONFLICT, name, "duplicate setting conflicts, ignored");
+                name = NULL;
             }
             else if (c[0] == '"')
             {
@@ -242,7 +469,8 @@ _skip_all:
                     goto _make_string;
                 }
                 else /* incomplete string */
-                    g_warning("config: unfinished string setting '%s', ignored", name);
+                    REPORT(PANEL_CONF_ERROR_UNFINISHED_STRING, c - 1, "unfinished string, ignored");
+                name = NULL;
             }
             else
             {
@@ -253,12 +481,22 @@ _make_string:
                 s = _config_setting_try_add(parent, name, PANEL_CONF_TYPE_STRING);
                 if (s)
                 {
-                    g_free(s->str);
-                    s->str = g_strndup(c, p - c);
+                    if (s->str_allocated)
+                        g_free(s->str);
+                    /* keep the value in the buffer until it is changed */
+                    s->str = c;
+                    s->str_allocated = FALSE;
                     /* g_debug("config loader: got new string %s: %s", name, s->str); */
                 }
                 else
-                    g_warning("config: duplicate setting '%s' conflicts, ignored", name);
+                    REPORT(PANEL_CONF_ERROR_CONFLICT, name, "duplicate setting conflicts, ignored");
+                name = NULL;
+                if (p == end && *p == '\n') /* unquoted value ends with line */
+                {
+                    line++;
+                    line_start = end = p + 1;
+                }
+                *p = '\0';
             }
             c = end;
             break;
@@ -271,17 +509,19 @@ _make_string:
             }
             else
                 s = NULL;
-            c++;
             if (s)
             {
                 parent = s;
                 /* g_debug("config loader: group '%s' added", name); */
             }
             else
-                g_warning("config: invalid group '%s' in config file ignored", name);
+                REPORT(PANEL_CONF_ERROR_INVALID_GROUP, name ? name : c, "invalid group ignored");
+            c++;
             name = NULL;
             break;
         case '}':
+            if (parent == config->root)
+                REPORT(PANEL_CONF_ERROR_UNBALANCED, c, "unexpected '}' ignored");
             c++;
             if (parent->parent)
                 parent = parent->parent; /* go up, to anonymous list */
@@ -295,10 +535,27 @@ _make_string:
             c++;
         }
     }
-    g_free(buff);
+    if (parent != config->root)
+        REPORT(PANEL_CONF_ERROR_UNBALANCED, c, "missing '}' at end of file");
+    /* settings just read are the same as in the file */
+    config->dirty = was_dirty;
     return TRUE;
 }
 
+#undef REPORT
+
+gboolean config_read_file(PanelConf * config, const char * filename)
+{
+    return _config_read(config, filename, NULL);
+}
+
+gboolean config_read_file_checked(PanelConf * config, const char * filename,
+                                  PanelConfError * error)
+{
+    g_return_val_if_fail(error != NULL, FALSE);
+    return _config_read(config, filename, error);
+}
+
 #define SETTING_INDENT "  "
 
 static void _config_write_setting(const config_setting_t *setting, GString *buf,
@@ -378,18 +635,76 @@ static void _config_write_setting(const config_setting_t *setting, GString *buf,
 
 gboolean config_write_file(PanelConf * config, const char * filename)
 {
-    FILE *f = fopen(filename, "w");
+    char *real = realpath(filename, NULL);
+    char *path, *tmp;
+    struct stat st;
+    FILE *f;
     GString *str;
-    if (f == NULL)
+    gboolean ok;
+    int fd, err;
+
+    /* replace the file a symlink points to, not the symlink itself */
+    path = g_strdup(real ? real : filename);
+    free(real);
+    /* '~' in the name makes panel loader skip it as a backup file */
+    tmp = g_strconcat(path, "~XXXXXX", NULL);
+
+    /* write a new file and then replace the old one, so the file is never
+       seen half written and an editor which has it open isn't disturbed */
+    fd = g_mkstemp(tmp);
+    if (fd < 0)
+    {
+        err = errno;
+        g_free(tmp);
+        g_free(path);
+        errno = err;
         return FALSE;
+    }
+    if (fchmod(fd, g_stat(path, &st) == 0 ? (st.st_mode & 07777) : 0644) < 0 ||
+        (f = fdopen(fd, "w")) == NULL)
+    {
+        err = errno;
+        close(fd);
+        g_unlink(tmp);
+        g_free(tmp);
+        g_free(path);
+        errno = err;
+        return FALSE;
+    }
     fputs("# lxpanel <profile> config file. Manually editing is not recommended.\n"
           "# Use preference dialog in lxpanel to adjust config when you can.\n\n", f);
     str = g_string_sized_new(128);
     _config_write_setting(config_setting_get_member(config->root, ""), str, NULL, f);
-    /* FIXME: handle errors */
-    fclose(f);
     g_string_free(str, TRUE);
-    return TRUE;
+    /* data should reach the disk before rename, or a crash may leave
+       an empty file in place of the config */
+    ok = (fflush(f) == 0 && fsync(fd) == 0);
+    err = errno;
+    if (fclose(f) != 0 && ok)
+    {
+        ok = FALSE;
+        err = errno;
+    }
+    if (ok && g_rename(tmp, path) != 0)
+    {
+        ok = FALSE;
+        err = errno;
+    }
+    if (ok)
+        config->dirty = FALSE;
+    else
+        g_unlink(tmp);
+    g_free(tmp);
+    g_free(path);
+    /* report the error of the call which failed, not of the cleanup */
+    if (!ok)
+        errno = err;
+    return ok;
+}
+
+gboolean config_is_dirty(const PanelConf * config)
+{
+    return config->dirty || config->has_hooks;
 }
 
 /* it is used for old plugins only */
@@ -421,6 +736,18 @@ config_setting_t * config_setting_get_elem(const config_setting_t * setting, uns
     config_setting_t *s;
     g_return_val_if_fail(setting, NULL);
     g_return_val_if_fail(setting->type == PANEL_CONF_TYPE_LIST || setting->type == PANEL_CONF_TYPE_GROUP, NULL);
+    if (index >= setting->n_children)
+        return NULL;
+    if (setting->elems == NULL && setting->n_children >= CONF_INDEX_MIN_SIZE)
+    {
+        /* the index is a cache, so it is fine to build it on const setting */
+        GPtrArray *elems = g_ptr_array_sized_new(setting->n_children);
+        for (s = setting->first; s; s = s->next)
+            g_ptr_array_add(elems, s);
+        ((config_setting_t *)setting)->elems = elems;
+    }
+    if (setting->elems)
+        return g_ptr_array_index(setting->elems, index);
     for (s = setting->first; s && index > 0; s = s->next)
         index--;
     return s;
@@ -501,59 +828,10 @@ config_setting_t * config_setting_add(config_setting_t * parent, const char * na
             return s;
         _config_setting_t_remove(s);
     }
-    return _config_setting_t_new(parent, -1, name, type);
+    return _config_setting_t_new(parent->conf, parent, name, type);
 }
 
 
-static void remove_from_parent(config_setting_t * setting)
-{
-    config_setting_t *s;
-
-    if (setting->parent->first == setting) {
-        setting->parent->first = setting->next;
-        goto _isolate_setting;
-    }
-
-    for (s = setting->parent->first; s->next; s = s->next)
-        if (s->next == setting)
-            break;
-    g_assert(s->next);
-    s->next = setting->next;
-
-_isolate_setting:
-    setting->next = NULL;
-    setting->parent = NULL;
-}
-
-static void append_to_parent(config_setting_t * setting, config_setting_t * parent)
-{
-    config_setting_t *s;
-
-    setting->parent = parent;
-    if (parent->first == NULL) {
-        parent->first = setting;
-        return;
-    }
-
-    s = parent->first;
-    while (s->next)
-        s = s->next;
-    s->next = setting;
-}
-
-static void insert_after(config_setting_t * setting, config_setting_t * parent,
-        config_setting_t * prev)
-{
-    setting->parent = parent;
-    if (prev == NULL) {
-        setting->next = parent->first;
-        parent->first = setting;
-    } else {
-        setting->next = prev->next;
-        prev->next = setting;
-    }
-}
-
 gboolean config_setting_move_member(config_setting_t * setting, config_setting_t * parent, const char * name)
 {
     config_setting_t *s;
@@ -561,19 +839,23 @@ gboolean config_setting_move_member(config_setting_t * setting, config_setting_t
     g_return_val_if_fail(setting && setting->parent, FALSE);
     if (parent == NULL || name == NULL || parent->type != PANEL_CONF_TYPE_GROUP)
         return FALSE;
+    /* settings are allocated from their config, cannot move them away */
+    g_return_val_if_fail(parent->conf == setting->conf, FALSE);
     s = _config_setting_get_member(parent, name);
     if (s) /* we cannot rename/move to this name, it exists already */
         return (s == setting);
     if (setting->parent == parent) /* it's just renaming thing */
         goto _rename;
-    remove_from_parent(setting); /* remove from old parent */
-    append_to_parent(setting, parent); /* add to new parent */
+    _config_setting_unlink(setting); /* remove from old parent */
+    _config_setting_link(setting, parent, parent->last); /* add to new parent */
     /* rename if need */
     if (g_strcmp0(setting->name, name) != 0)
     {
 _rename:
-        g_free(setting->name);
-        setting->name = g_strdup(name);
+        /* names index of parent is keyed by old name */
+        _config_setting_drop_index(parent);
+        setting->conf->dirty = TRUE;
+        setting->name = g_string_chunk_insert_const(setting->conf->strings, name);
     }
     return TRUE;
 }
@@ -587,6 +869,7 @@ gboolean config_setting_move_elem(config_setting_t * setting, config_setting_t *
         return FALSE;
     if (setting->type != PANEL_CONF_TYPE_GROUP) /* we support only list of groups now */
         return FALSE;
+    g_return_val_if_fail(parent->conf == setting->conf, FALSE);
     /* let check the place */
     if (index != 0)
     {
@@ -611,11 +894,11 @@ _out_of_range:
     }
     else if (parent->first == setting) /* it is already there */
         return TRUE;
-    remove_from_parent(setting); /* remove from old parent */
+    _config_setting_unlink(setting); /* remove from old parent */
     /* add to new parent */
     if (index == 0)
         g_assert(prev == NULL);
-    insert_after(setting, parent, prev);
+    _config_setting_link(setting, parent, prev);
     /* don't rename  */
     return TRUE;
 }
@@ -624,6 +907,8 @@ gboolean config_setting_set_int(config_setting_t * setting, int value)
 {
     if (!setting || setting->type != PANEL_CONF_TYPE_INT)
         return FALSE;
+    if (setting->num != value)
+        setting->conf->dirty = TRUE;
     setting->num = value;
     return TRUE;
 }
@@ -632,8 +917,13 @@ gboolean config_setting_set_string(config_setting_t * setting, const char * valu
 {
     if (!setting || setting->type != PANEL_CONF_TYPE_STRING)
         return FALSE;
-    g_free(setting->str);
+    if (g_strcmp0(setting->str, value) == 0)
+        return TRUE;
+    setting->conf->dirty = TRUE;
+    if (setting->str_allocated)
+        g_free(setting->str);
     setting->str = g_strdup(value);
+    setting->str_allocated = TRUE;
     return TRUE;
 }
 
@@ -663,6 +953,102 @@ gboolean config_setting_destroy(config_setting_t * setting)
     return TRUE;
 }
 
+gboolean config_setting_equal(const config_setting_t * a, const config_setting_t * b)
+{
+    const config_setting_t *sa, *sb;
+
+    g_return_val_if_fail(a && b, FALSE);
+    if (a->type != b->type || g_strcmp0(a->name, b->name) != 0)
+        return FALSE;
+    /* what hook saves is unknown */
+    if (a->hook || b->hook)
+        return FALSE;
+    switch (a->type)
+    {
+    case PANEL_CONF_TYPE_INT:
+        return a->num == b->num;
+    case PANEL_CONF_TYPE_STRING:
+        return g_strcmp0(a->str, b->str) == 0;
+    case PANEL_CONF_TYPE_GROUP:
+    case PANEL_CONF_TYPE_LIST:
+        if (a->n_children != b->n_children)
+            return FALSE;
+        for (sa = a->first, sb = b->first; sa; sa = sa->next, sb = sb->next)
+            if (!config_setting_equal(sa, sb))
+                return FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean config_setting_includes(const config_setting_t * a, const config_setting_t * b)
+{
+    const config_setting_t *sa, *sb;
+
+    g_return_val_if_fail(a && b, FALSE);
+    if (a->type != b->type || g_strcmp0(a->name, b->name) != 0)
+        return FALSE;
+    if (a->hook || b->hook)
+        return FALSE;
+    switch (a->type)
+    {
+    case PANEL_CONF_TYPE_INT:
+        return a->num == b->num;
+    case PANEL_CONF_TYPE_STRING:
+        return g_strcmp0(a->str, b->str) == 0;
+    case PANEL_CONF_TYPE_GROUP:
+        for (sb = b->first; sb; sb = sb->next)
+        {
+            sa = _config_setting_get_member(a, sb->name);
+            if (sa == NULL)
+            {
+                /* plugin may have no config at all instead of empty one */
+                if (sb->type == PANEL_CONF_TYPE_GROUP && sb->n_children == 0)
+                    continue;
+                return FALSE;
+            }
+            if (!config_setting_includes(sa, sb))
+                return FALSE;
+        }
+        return TRUE;
+    case PANEL_CONF_TYPE_LIST:
+        /* order and number of elements matter */
+        if (a->n_children != b->n_children)
+            return FALSE;
+        for (sa = a->first, sb = b->first; sa; sa = sa->next, sb = sb->next)
+            if (!config_setting_includes(sa, sb))
+                return FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+config_setting_t * config_setting_copy(config_setting_t * parent, const config_setting_t * src)
+{
+    config_setting_t *s, *sub;
+
+    g_return_val_if_fail(parent && src, NULL);
+    if (parent->type != PANEL_CONF_TYPE_GROUP && parent->type != PANEL_CONF_TYPE_LIST)
+        return NULL;
+    s = _config_setting_t_new(parent->conf, parent, src->name, src->type);
+    switch (src->type)
+    {
+    case PANEL_CONF_TYPE_INT:
+        s->num = src->num;
+        break;
+    case PANEL_CONF_TYPE_STRING:
+        s->str = g_strdup(src->str);
+        s->str_allocated = TRUE;
+        break;
+    case PANEL_CONF_TYPE_GROUP:
+    case PANEL_CONF_TYPE_LIST:
+        for (sub = src->first; sub; sub = sub->next)
+            config_setting_copy(s, sub);
+        break;
+    }
+    return s;
+}
+
 PanelConfType config_setting_type(const config_setting_t * setting)
 {
     return setting->type;
@@ -673,4 +1059,6 @@ void config_setting_set_save_hook(config_setting_t * setting, PanelConfSaveHook
 {
     setting->hook = hook;
     setting->hook_data = user_data;
+    if (hook)
+        setting->conf->has_hooks = TRUE;
 }
@@ -45,12 +45,36 @@ typedef enum
     PANEL_CONF_TYPE_LIST
 } PanelConfType;
 
+typedef enum
+{
+    PANEL_CONF_ERROR_IO, /* file cannot be read */
+    PANEL_CONF_ERROR_SYNTAX, /* statement without name or value */
+    PANEL_CONF_ERROR_UNFINISHED_STRING, /* no closing quote in line */
+    PANEL_CONF_ERROR_CONFLICT, /* setting exists already with other type */
+    PANEL_CONF_ERROR_INVALID_GROUP, /* group cannot be added */
+    PANEL_CONF_ERROR_UNBALANCED /* extra or missing '}' */
+} PanelConfErrorCode;
+
+typedef struct
+{
+    PanelConfErrorCode code;
+    guint line; /* counted from 1, 0 for PANEL_CONF_ERROR_IO */
+    guint column; /* in bytes, counted from 1 */
+    const char *message; /* static string, not translated */
+} PanelConfError;
+
 typedef void (*PanelConfSaveHook)(const config_setting_t * setting, FILE * f, gpointer user_data);
 
 PanelConf *config_new(void);
 void config_destroy(PanelConf * config);
 gboolean config_read_file(PanelConf * config, const char * filename);
+/* stops on the first error instead of warning and skipping the statement,
+   the config is left partially read then */
+gboolean config_read_file_checked(PanelConf * config, const char * filename,
+                                  PanelConfError * error);
 gboolean config_write_file(PanelConf * config, const char * filename);
+/* TRUE if config was changed since it was read or written last time */
+gboolean config_is_dirty(const PanelConf * config);
 char * config_setting_to_string(const config_setting_t * setting);
 
 config_setting_t * config_root_setting(const PanelConf * config);
@@ -78,6 +102,15 @@ gboolean config_setting_remove(config_setting_t * parent, const char * name);
 gboolean config_setting_remove_elem(config_setting_t * parent, unsigned int index);
 gboolean config_setting_destroy(config_setting_t * setting);
 
+/* compares names and contents, settings with save hook are never equal */
+gboolean config_setting_equal(const config_setting_t * a, const config_setting_t * b);
+/* the same but settings which are in a only are ignored, and an empty group
+   in b matches a missing one, so defaults a plugin added don't count */
+gboolean config_setting_includes(const config_setting_t * a, const config_setting_t * b);
+/* appends copy of src to parent, which may be in another config; doesn't
+   check for conflicts in group and doesn't copy save hooks */
+config_setting_t * config_setting_copy(config_setting_t * parent, const config_setting_t * src);
+
 #define config_group_set_int(_group,_name,_value) \
         config_setting_set_int(config_setting_add(_group, _name, \
                                                   PANEL_CONF_TYPE_INT), \
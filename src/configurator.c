@@ -39,11 +39,13 @@
 
 #include "private.h"
 #include "misc.h"
+#include "ticker.h"
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <glib/gi18n.h>
 #include <libfm/fm-gtk.h>
 
@@ -59,6 +61,11 @@ enum{
 static void save_global_config();
 
 static char* logout_cmd = NULL;
+static char* saved_logout_cmd = NULL; /* value last loaded or saved */
+static gboolean global_config_saved = FALSE;
+
+/* delay of saving after lxpanel_config_save() call, in seconds */
+#define CONFIG_SAVE_DELAY 2
 
 /* macros to update config */
 #define UPDATE_GLOBAL_INT(panel,name,val) do { \
@@ -616,6 +623,16 @@ static void on_stretch_render(GtkTreeViewColumn * column, GtkCellRenderer * rend
         NULL);
 }
 
+static void on_wakeups_render(GtkTreeViewColumn * column, GtkCellRenderer * renderer, GtkTreeModel * model, GtkTreeIter * iter, gpointer data)
+{
+    /* Show how many times periodic updates of the plugin were done. */
+    GtkWidget * pl;
+    char text[16];
+    gtk_tree_model_get(model, iter, COL_DATA, &pl, -1);
+    g_snprintf(text, sizeof(text), "%u", lxpanel_tick_get_wakeups(pl));
+    g_object_set(renderer, "text", text, NULL);
+}
+
 static void init_plugin_list( LXPanel* p, GtkTreeView* view, GtkWidget* label )
 {
     GtkListStore* list;
@@ -644,6 +661,13 @@ static void init_plugin_list( LXPanel* p, GtkTreeView* view, GtkWidget* label )
     gtk_tree_view_column_set_cell_data_func(col, render, on_stretch_render, NULL, NULL);
     gtk_tree_view_append_column( view, col );
 
+    render = gtk_cell_renderer_text_new();
+    col = gtk_tree_view_column_new_with_attributes(
+            _("Wakeups"), render, NULL );
+    gtk_tree_view_column_set_expand( col, FALSE );
+    gtk_tree_view_column_set_cell_data_func(col, render, on_wakeups_render, NULL, NULL);
+    gtk_tree_view_append_column( view, col );
+
     list = gtk_list_store_new( N_COLS, G_TYPE_STRING, G_TYPE_BOOLEAN, G_TYPE_POINTER );
     plugins = p->priv->box ? gtk_container_get_children(GTK_CONTAINER(p->priv->box)) : NULL;
     for( l = plugins; l; l = l->next )
@@ -1394,24 +1418,51 @@ void panel_config_save( Panel* p )
 {
     gchar *fname;
 
-    fname = _user_config_file_name("panels", p->name);
-    /* existance of 'panels' dir ensured in main() */
+    if (p->config_save_queued)
+    {
+        g_source_remove(p->config_save_queued);
+        p->config_save_queued = 0;
+    }
+    /* home may be on network, don't write file if nothing was changed */
+    if (config_is_dirty(p->config))
+    {
+        fname = _user_config_file_name("panels", p->name);
+        /* existance of 'panels' dir ensured in main() */
 
-    if (!config_write_file(p->config, fname)) {
-        g_warning("can't open for write %s:", fname);
+        if (!config_write_file(p->config, fname)) {
+            g_warning("can't write %s: %s", fname, g_strerror(errno));
+            g_free( fname );
+            return;
+        }
         g_free( fname );
-        return;
     }
-    g_free( fname );
 
     /* save the global config file */
     save_global_config();
     p->config_changed = 0;
 }
 
+static gboolean panel_config_save_timeout(gpointer user_data)
+{
+    Panel *p = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    p->config_save_queued = 0;
+    panel_config_save(p);
+    return FALSE;
+}
+
 void lxpanel_config_save(LXPanel *p)
 {
-    panel_config_save(p->priv);
+    Panel *panel = p->priv;
+
+    /* plugins save config on each little change, write them all at once */
+    panel->config_changed = 1;
+    if (panel->config_save_queued == 0)
+        panel->config_save_queued = g_timeout_add_seconds(CONFIG_SAVE_DELAY,
+                                                          panel_config_save_timeout,
+                                                          panel);
 }
 
 void logout(void)
@@ -1747,6 +1798,8 @@ void load_global_config()
         GList *apps, *l;
 
         logout_cmd = g_key_file_get_string( kf, COMMAND_GROUP, "Logout", NULL );
+        saved_logout_cmd = g_strdup(logout_cmd);
+        global_config_saved = TRUE;
         /* check for terminal setting on upgrade */
         if (fm_config->terminal == NULL)
         {
@@ -1790,21 +1843,30 @@ void load_global_config()
 
 static void save_global_config()
 {
-    char* file = _user_config_file_name("config", NULL);
-    FILE* f = fopen( file, "w" );
-    if( f )
+    char* file;
+    char* contents;
+
+    if (global_config_saved && g_strcmp0(logout_cmd, saved_logout_cmd) == 0)
+        return;
+    file = _user_config_file_name("config", NULL);
+    contents = g_strdup_printf("[" COMMAND_GROUP "]\n%s%s%s",
+                               logout_cmd ? "Logout=" : "",
+                               logout_cmd ? logout_cmd : "",
+                               logout_cmd ? "\n" : "");
+    if (g_file_set_contents(file, contents, -1, NULL))
     {
-        fprintf( f, "[" COMMAND_GROUP "]\n");
-        if( logout_cmd )
-            fprintf( f, "Logout=%s\n", logout_cmd );
-        fclose( f );
+        g_free(saved_logout_cmd);
+        saved_logout_cmd = g_strdup(logout_cmd);
+        global_config_saved = TRUE;
     }
+    g_free(contents);
     g_free(file);
 }
 
 void free_global_config()
 {
     g_free( logout_cmd );
+    g_free( saved_logout_cmd );
 }
 
 /* this is dirty and should be removed later */
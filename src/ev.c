@@ -55,9 +55,16 @@ struct _FbEv {
     int current_desktop;
     int number_of_desktops;
     char **desktop_names;
+    int desktop_names_n;
     Window active_window;
     Window *client_list;
+    int client_list_n;
     Window *client_list_stacking;
+    int client_list_stacking_n;
+
+    guint valid;                /* bits (1 << signal) for properties in cache */
+    guint hits[LAST_SIGNAL];    /* statistics: requests served from cache */
+    guint misses[LAST_SIGNAL];  /* statistics: requests fetched from X server */
 
     Window   xroot;
     Atom     id;
@@ -73,15 +80,18 @@ static void fb_ev_class_init (FbEvClass *klass);
 static void fb_ev_init (FbEv *monitor);
 static void fb_ev_finalize (GObject *object);
 
-static void ev_current_desktop(FbEv *ev, gpointer p);
-static void ev_active_window(FbEv *ev, gpointer p);
-static void ev_number_of_desktops(FbEv *ev, gpointer p);
-static void ev_desktop_names(FbEv *ev, gpointer p);
-static void ev_client_list(FbEv *ev, gpointer p);
-static void ev_client_list_stacking(FbEv *ev, gpointer p);
-
 static guint signals [LAST_SIGNAL] = { 0 };
 
+/* root window properties cached for each signal, for debug messages */
+static const char *prop_names [LAST_SIGNAL] = {
+    [EV_CURRENT_DESKTOP] = "_NET_CURRENT_DESKTOP",
+    [EV_NUMBER_OF_DESKTOPS] = "_NET_NUMBER_OF_DESKTOPS",
+    [EV_DESKTOP_NAMES] = "_NET_DESKTOP_NAMES",
+    [EV_ACTIVE_WINDOW] = "_NET_ACTIVE_WINDOW",
+    [EV_CLIENT_LIST_STACKING] = "_NET_CLIENT_LIST_STACKING",
+    [EV_CLIENT_LIST] = "_NET_CLIENT_LIST"
+};
+
 
 GType
 fb_ev_get_type (void)
@@ -172,23 +182,17 @@ fb_ev_class_init (FbEvClass *klass)
               g_cclosure_marshal_VOID__VOID,
               G_TYPE_NONE, 0);
     object_class->finalize = fb_ev_finalize;
-
-    klass->current_desktop = ev_current_desktop;
-    klass->active_window = ev_active_window;
-    klass->number_of_desktops = ev_number_of_desktops;
-    klass->desktop_names = ev_desktop_names;
-    klass->client_list = ev_client_list;
-    klass->client_list_stacking = ev_client_list_stacking;
 }
 
 static void
 fb_ev_init (FbEv *ev)
 {
-    ev->number_of_desktops = -1;
-    ev->current_desktop = -1;
+    ev->number_of_desktops = 0;
+    ev->current_desktop = 0;
     ev->active_window = None;
     ev->client_list_stacking = NULL;
     ev->client_list = NULL;
+    ev->valid = 0;
 }
 
 
@@ -201,98 +205,77 @@ fb_ev_new()
 static void
 fb_ev_finalize (GObject *object)
 {
-    //FbEv *ev;
+    FbEv *ev = FB_EV (object);
+    int i;
 
-    //ev = FB_EV (object);
-    //XFreeGC(ev->dpy, ev->gc);
+    for (i = 0; i < LAST_SIGNAL; i++)
+        fb_ev_invalidate(ev, i);
 }
 
+/* Drops cached property which corresponds to the signal, it should be
+ * called when the property change is received from X server. */
 void
-fb_ev_emit(FbEv *ev, int signal)
+fb_ev_invalidate(FbEv *ev, int signal)
 {
-    DBG("signal=%d\n", signal);
-    g_assert(signal >=0 && signal < LAST_SIGNAL);
-    DBG("\n");
-    if( signal == EV_ACTIVE_WINDOW )
+    g_return_if_fail(signal >= 0 && signal < LAST_SIGNAL);
+    ev->valid &= ~(1U << signal);
+    switch (signal)
     {
-        Window* win = None;
-        ev->active_window = None;
-        win = (Window*)get_xaproperty (GDK_ROOT_WINDOW(), a_NET_ACTIVE_WINDOW, XA_WINDOW, 0);
-        if (win) {
-            ev->active_window = *win;
-            /* g_debug( "WIN: %p", *win ); */
-            XFree (win);
+    case EV_DESKTOP_NAMES:
+        if (ev->desktop_names) {
+            g_strfreev (ev->desktop_names);
+            ev->desktop_names = NULL;
+        }
+        break;
+    case EV_CLIENT_LIST:
+        if (ev->client_list) {
+            XFree(ev->client_list);
+            ev->client_list = NULL;
         }
+        break;
+    case EV_CLIENT_LIST_STACKING:
+        if (ev->client_list_stacking) {
+            XFree(ev->client_list_stacking);
+            ev->client_list_stacking = NULL;
+        }
+        break;
     }
-    g_signal_emit(ev, signals [signal], 0);
-}
-
-void fb_ev_emit_destroy(FbEv *ev, Window win)
-{
-    g_signal_emit(ev, signals [EV_DESTROY_WINDOW], 0, win );
-}
-
-static void
-ev_current_desktop(FbEv *ev, gpointer p)
-{
-    ENTER;
-    ev->current_desktop = -1;
-    RET();
-}
-
-static void
-ev_active_window(FbEv *ev, gpointer p)
-{
-    ENTER;
-//    ev->active_window = None;		// Wrecks fb_ev_active window
-    RET();
-}
-
-static void
-ev_number_of_desktops(FbEv *ev, gpointer p)
-{
-    ENTER;
-    ev->number_of_desktops = -1;
-    RET();
 }
 
-static void
-ev_desktop_names(FbEv *ev, gpointer p)
+/* Returns TRUE if property is in cache, otherwise marks it as cached and
+ * returns FALSE so the caller should fetch it from X server. */
+static gboolean
+fb_ev_cached(FbEv *ev, int signal)
 {
-    ENTER;
-    if (ev->desktop_names) {
-        g_strfreev (ev->desktop_names);
-        ev->desktop_names = NULL;
+    if (ev->valid & (1U << signal)) {
+        ev->hits[signal]++;
+        return TRUE;
     }
-    RET();
+    ev->valid |= (1U << signal);
+    ev->misses[signal]++;
+    g_debug("FbEv: fetching %s, %u hits and %u misses", prop_names[signal],
+            ev->hits[signal], ev->misses[signal]);
+    return FALSE;
 }
-static void
-ev_client_list(FbEv *ev, gpointer p)
+
+void
+fb_ev_emit(FbEv *ev, int signal)
 {
-    ENTER;
-    if (ev->client_list) {
-        XFree(ev->client_list);
-        ev->client_list = NULL;
-    }
-    RET();
+    DBG("signal=%d\n", signal);
+    g_assert(signal >=0 && signal < LAST_SIGNAL);
+    g_signal_emit(ev, signals [signal], 0);
 }
 
-static void
-ev_client_list_stacking(FbEv *ev, gpointer p)
+void fb_ev_emit_destroy(FbEv *ev, Window win)
 {
-    ENTER;
-    if (ev->client_list_stacking) {
-        XFree(ev->client_list_stacking);
-        ev->client_list_stacking = NULL;
-    }
-    RET();
+    g_signal_emit(ev, signals [EV_DESTROY_WINDOW], 0, win );
 }
 
 int
 fb_ev_current_desktop(FbEv *ev)
 {
     ENTER;
-    if (ev->current_desktop == -1) {
+    if (!fb_ev_cached(ev, EV_CURRENT_DESKTOP)) {
         gulong *data;
 
         data = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_CURRENT_DESKTOP, XA_CARDINAL, 0);
@@ -309,7 +292,7 @@ int
 fb_ev_number_of_desktops(FbEv *ev)
 {
     ENTER;
-     if (ev->number_of_desktops == -1) {
+    if (!fb_ev_cached(ev, EV_NUMBER_OF_DESKTOPS)) {
         gulong *data;
 
         data = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_NUMBER_OF_DESKTOPS, XA_CARDINAL, 0);
@@ -323,18 +306,50 @@ fb_ev_number_of_desktops(FbEv *ev)
 
 }
 
+char **fb_ev_desktop_names(FbEv *ev, int *n)
+{
+    if (!fb_ev_cached(ev, EV_DESKTOP_NAMES))
+        ev->desktop_names = get_utf8_property_list(GDK_ROOT_WINDOW(),
+                                                   a_NET_DESKTOP_NAMES,
+                                                   &ev->desktop_names_n);
+    if (n)
+        *n = ev->desktop_names ? ev->desktop_names_n : 0;
+    return ev->desktop_names;
+}
+
 Window *fb_ev_active_window(FbEv *ev)
 {
+    if (!fb_ev_cached(ev, EV_ACTIVE_WINDOW)) {
+        Window *win;
+
+        ev->active_window = None;
+        win = (Window*)get_xaproperty (GDK_ROOT_WINDOW(), a_NET_ACTIVE_WINDOW, XA_WINDOW, 0);
+        if (win) {
+            ev->active_window = *win;
+            XFree (win);
+        }
+    }
     return &ev->active_window;
 }
 
-Window *fb_ev_client_list(FbEv *ev)
+Window *fb_ev_client_list(FbEv *ev, int *n)
 {
+    if (!fb_ev_cached(ev, EV_CLIENT_LIST))
+        ev->client_list = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_CLIENT_LIST,
+                                          XA_WINDOW, &ev->client_list_n);
+    if (n)
+        *n = ev->client_list ? ev->client_list_n : 0;
     return ev->client_list;
 }
 
-Window *fb_ev_client_list_stacking(FbEv *ev)
+Window *fb_ev_client_list_stacking(FbEv *ev, int *n)
 {
+    if (!fb_ev_cached(ev, EV_CLIENT_LIST_STACKING))
+        ev->client_list_stacking = get_xaproperty (GDK_ROOT_WINDOW(),
+                                                   a_NET_CLIENT_LIST_STACKING,
+                                                   XA_WINDOW,
+                                                   &ev->client_list_stacking_n);
+    if (n)
+        *n = ev->client_list_stacking ? ev->client_list_stacking_n : 0;
     return ev->client_list_stacking;
 }
-
@@ -70,12 +70,16 @@ FbEv *fb_ev_new(void);
 void fb_ev_notify_changed_ev(FbEv *ev);
 void fb_ev_emit(FbEv *ev, int signal);
 void fb_ev_emit_destroy(FbEv *ev, Window win);
+void fb_ev_invalidate(FbEv *ev, int signal);
 
+/* Root window properties are fetched once after each change and shared.
+ * Returned data is owned by FbEv and valid until the next change. */
 extern int fb_ev_current_desktop(FbEv *ev);
 extern int fb_ev_number_of_desktops(FbEv *ev);
+extern char **fb_ev_desktop_names(FbEv *ev, int *n);
 extern Window *fb_ev_active_window(FbEv *ev);
-extern Window *fb_ev_client_list(FbEv *ev);
-extern Window *fb_ev_client_list_stacking(FbEv *ev);
+extern Window *fb_ev_client_list(FbEv *ev, int *n);
+extern Window *fb_ev_client_list_stacking(FbEv *ev, int *n);
 
 /* it is created in the main.c */
 extern FbEv *fbev;
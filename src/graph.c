@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "graph.h"
+
+struct _PanelGraph
+{
+    GtkDrawingArea parent;
+    cairo_surface_t *surface;       /* column X shows sample X of ring */
+    gint width, height;             /* size of surface, without border */
+    gint border;
+    guint n_values;                 /* number of values in each sample */
+    gfloat *samples;                /* ring buffer of width * n_values */
+    guint cursor;                   /* place for new sample, the oldest one */
+    PanelGraphDrawFunc draw_column;
+    gpointer user_data;
+};
+
+struct _PanelGraphClass
+{
+    GtkDrawingAreaClass parent_class;
+};
+
+G_DEFINE_TYPE(PanelGraph, panel_graph, GTK_TYPE_DRAWING_AREA)
+
+/* Reallocate ring buffer for new width or number of values in a sample.
+ * Samples are preserved if the latter didn't change. */
+static void panel_graph_ring_resize(PanelGraph *g, guint new_width, guint new_n)
+{
+    gfloat *new_samples = g_new0(gfloat, new_width * new_n);
+    guint width = g->width, n = new_n;
+
+    if (g->samples != NULL && new_n == g->n_values)
+    {
+        if (new_width > width)
+        {
+            /* New allocation is larger.
+             * Introduce new "oldest" samples of zero following the cursor. */
+            memcpy(&new_samples[0], &g->samples[0],
+                   g->cursor * n * sizeof(gfloat));
+            memcpy(&new_samples[(new_width - width + g->cursor) * n],
+                   &g->samples[g->cursor * n],
+                   (width - g->cursor) * n * sizeof(gfloat));
+        }
+        else if (g->cursor <= new_width)
+        {
+            /* New allocation is smaller, but still larger than the cursor.
+             * Discard the oldest samples following the cursor. */
+            memcpy(&new_samples[0], &g->samples[0],
+                   g->cursor * n * sizeof(gfloat));
+            memcpy(&new_samples[g->cursor * n],
+                   &g->samples[(width - new_width + g->cursor) * n],
+                   (new_width - g->cursor) * n * sizeof(gfloat));
+            if (g->cursor == new_width)
+                g->cursor = 0;
+        }
+        else
+        {
+            /* New allocation is smaller, and also smaller than the cursor.
+             * Discard all oldest samples following the cursor and additional
+             * samples at the beginning of the buffer. */
+            memcpy(&new_samples[0],
+                   &g->samples[(g->cursor - new_width) * n],
+                   new_width * n * sizeof(gfloat));
+            g->cursor = 0;
+        }
+    }
+    else
+        g->cursor = 0;
+    g_free(g->samples);
+    g->samples = new_samples;
+    g->n_values = new_n;
+}
+
+/* Fill column at x with background and draw sample into it. */
+static inline void panel_graph_draw_column(PanelGraph *g, cairo_t *cr,
+                                           GdkColor *bg, guint x)
+{
+    cairo_rectangle(cr, x, 0, 1, g->height);
+    gdk_cairo_set_source_color(cr, bg);
+    cairo_fill(cr);
+    if (g->n_values > 0)
+        g->draw_column(cr, x, g->height, &g->samples[x * g->n_values],
+                       g->n_values, g->user_data);
+}
+
+void panel_graph_redraw(PanelGraph *g)
+{
+    GtkStyle *style;
+    cairo_t *cr;
+    gint x;
+
+    g_return_if_fail(PANEL_IS_GRAPH(g));
+
+    if (g->surface == NULL)
+        return;
+    style = gtk_widget_get_style(GTK_WIDGET(g));
+    cr = cairo_create(g->surface);
+    cairo_set_line_width(cr, 1.0);
+    for (x = 0; x < g->width; x++)
+        panel_graph_draw_column(g, cr, &style->black, x);
+    cairo_destroy(cr);
+    gtk_widget_queue_draw(GTK_WIDGET(g));
+}
+
+static void panel_graph_resize(PanelGraph *g, gint width, gint height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    if (g->surface != NULL && width == g->width && height == g->height)
+        return;
+    if (g->samples == NULL || width != g->width)
+        panel_graph_ring_resize(g, width, g->n_values);
+    g->width = width;
+    g->height = height;
+    if (g->surface)
+        cairo_surface_destroy(g->surface);
+    g->surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+    panel_graph_redraw(g);
+}
+
+static void panel_graph_size_allocate(GtkWidget *widget, GtkAllocation *allocation)
+{
+    PanelGraph *g = PANEL_GRAPH(widget);
+
+    GTK_WIDGET_CLASS(panel_graph_parent_class)->size_allocate(widget, allocation);
+    panel_graph_resize(g, allocation->width - g->border * 2,
+                       allocation->height - g->border * 2);
+}
+
+/* Paint surface so the oldest sample is on the left: the surface is
+ * repeated and shifted left by the cursor, so it wraps around. */
+static void panel_graph_paint(PanelGraph *g, cairo_t *cr)
+{
+    if (g->surface == NULL)
+        return;
+    cairo_set_source_surface(cr, g->surface, g->border - (gint)g->cursor,
+                             g->border);
+    cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_REPEAT);
+    cairo_rectangle(cr, g->border, g->border, g->width, g->height);
+    cairo_fill(cr);
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean panel_graph_draw(GtkWidget *widget, cairo_t *cr)
+{
+    panel_graph_paint(PANEL_GRAPH(widget), cr);
+    return FALSE;
+}
+
+static void panel_graph_style_updated(GtkWidget *widget)
+{
+    if (GTK_WIDGET_CLASS(panel_graph_parent_class)->style_updated)
+        GTK_WIDGET_CLASS(panel_graph_parent_class)->style_updated(widget);
+    panel_graph_redraw(PANEL_GRAPH(widget));
+}
+#else
+static gboolean panel_graph_expose_event(GtkWidget *widget, GdkEventExpose *event)
+{
+    cairo_t *cr = gdk_cairo_create(gtk_widget_get_window(widget));
+
+    gdk_cairo_region(cr, event->region);
+    cairo_clip(cr);
+    panel_graph_paint(PANEL_GRAPH(widget), cr);
+    cairo_destroy(cr);
+    return FALSE;
+}
+
+static void panel_graph_style_set(GtkWidget *widget, GtkStyle *previous_style)
+{
+    if (GTK_WIDGET_CLASS(panel_graph_parent_class)->style_set)
+        GTK_WIDGET_CLASS(panel_graph_parent_class)->style_set(widget, previous_style);
+    panel_graph_redraw(PANEL_GRAPH(widget));
+}
+#endif
+
+static void panel_graph_finalize(GObject *object)
+{
+    PanelGraph *g = PANEL_GRAPH(object);
+
+    if (g->surface)
+        cairo_surface_destroy(g->surface);
+    g_free(g->samples);
+
+    G_OBJECT_CLASS(panel_graph_parent_class)->finalize(object);
+}
+
+static void panel_graph_class_init(PanelGraphClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->finalize = panel_graph_finalize;
+    widget_class->size_allocate = panel_graph_size_allocate;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    widget_class->draw = panel_graph_draw;
+    widget_class->style_updated = panel_graph_style_updated;
+#else
+    widget_class->expose_event = panel_graph_expose_event;
+    widget_class->style_set = panel_graph_style_set;
+#endif
+}
+
+static void panel_graph_init(PanelGraph *self)
+{
+}
+
+GtkWidget *panel_graph_new(guint n_values, gint border,
+                           PanelGraphDrawFunc draw, gpointer user_data)
+{
+    PanelGraph *g;
+
+    g_return_val_if_fail(draw != NULL, NULL);
+
+    g = g_object_new(PANEL_TYPE_GRAPH, NULL);
+    g->n_values = n_values;
+    g->border = border;
+    g->draw_column = draw;
+    g->user_data = user_data;
+    return GTK_WIDGET(g);
+}
+
+void panel_graph_set_n_values(PanelGraph *g, guint n_values)
+{
+    g_return_if_fail(PANEL_IS_GRAPH(g));
+
+    if (n_values == g->n_values)
+        return;
+    if (g->surface != NULL)
+    {
+        panel_graph_ring_resize(g, g->width, n_values);
+        panel_graph_redraw(g);
+    }
+    else
+        g->n_values = n_values;
+}
+
+guint panel_graph_get_n_values(PanelGraph *g)
+{
+    g_return_val_if_fail(PANEL_IS_GRAPH(g), 0);
+    return g->n_values;
+}
+
+gfloat *panel_graph_new_sample(PanelGraph *g)
+{
+    g_return_val_if_fail(PANEL_IS_GRAPH(g), NULL);
+
+    if (g->samples == NULL)
+        return NULL;
+    return &g->samples[g->cursor * g->n_values];
+}
+
+void panel_graph_commit_sample(PanelGraph *g)
+{
+    GtkStyle *style;
+    cairo_t *cr;
+
+    g_return_if_fail(PANEL_IS_GRAPH(g));
+
+    if (g->samples == NULL || g->surface == NULL)
+        return;
+
+    /* Only the column of the new sample is drawn. */
+    style = gtk_widget_get_style(GTK_WIDGET(g));
+    cr = cairo_create(g->surface);
+    cairo_set_line_width(cr, 1.0);
+    panel_graph_draw_column(g, cr, &style->black, g->cursor);
+    cairo_destroy(cr);
+
+    /* Increment and wrap cursor. */
+    g->cursor++;
+    if (g->cursor >= (guint)g->width)
+        g->cursor = 0;
+
+    gtk_widget_queue_draw(GTK_WIDGET(g));
+}
+
+const gfloat *panel_graph_get_last_sample(PanelGraph *g)
+{
+    g_return_val_if_fail(PANEL_IS_GRAPH(g), NULL);
+
+    if (g->samples == NULL)
+        return NULL;
+    return &g->samples[(((g->cursor > 0) ? g->cursor : (guint)g->width) - 1) * g->n_values];
+}
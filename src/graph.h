@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GRAPH_H__
+#define __GRAPH_H__ 1
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define PANEL_TYPE_GRAPH               (panel_graph_get_type())
+#define PANEL_GRAPH(obj)               (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+                                        PANEL_TYPE_GRAPH, PanelGraph))
+#define PANEL_IS_GRAPH(obj)            (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+                                        PANEL_TYPE_GRAPH))
+
+extern GType panel_graph_get_type   (void) G_GNUC_CONST;
+
+typedef struct _PanelGraph           PanelGraph;
+typedef struct _PanelGraphClass      PanelGraphClass;
+
+/**
+ * PanelGraphDrawFunc
+ * @cr: cairo context to draw with
+ * @x: left coordinate of the column
+ * @height: height of the column
+ * @values: values of the sample
+ * @n_values: number of elements in @values
+ * @user_data: data passed to panel_graph_new()
+ *
+ * Draws a sample as a column 1 pixel wide at @x, from 0 to @height. The
+ * column is already filled with background color when it is called.
+ *
+ * Since: 0.9.3
+ */
+typedef void (*PanelGraphDrawFunc)(cairo_t *cr, gint x, gint height,
+                                   const gfloat *values, guint n_values,
+                                   gpointer user_data);
+
+/**
+ * panel_graph_new
+ * @n_values: number of values in each sample
+ * @border: size of border around graph
+ * @draw: function to draw a sample
+ * @user_data: data to pass to @draw
+ *
+ * Creates a widget which shows history of samples, one sample per pixel,
+ * the newest on the right. Samples are kept in a ring buffer of the graph
+ * width and drawn into a surface in the same order, so adding a sample
+ * draws only its column and the surface is then painted from the ring
+ * cursor with wrap. Whole graph is drawn only when its size or style is
+ * changed, or panel_graph_redraw() is called.
+ *
+ * Returns: (transfer full): a new #PanelGraph widget.
+ *
+ * Since: 0.9.3
+ */
+extern GtkWidget *panel_graph_new(guint n_values, gint border,
+                                  PanelGraphDrawFunc draw, gpointer user_data);
+
+/**
+ * panel_graph_set_n_values
+ * @graph: a graph
+ * @n_values: new number of values in each sample
+ *
+ * Changes format of samples. If @n_values differs from the current one
+ * then history is discarded.
+ *
+ * Since: 0.9.3
+ */
+extern void panel_graph_set_n_values(PanelGraph *graph, guint n_values);
+
+/**
+ * panel_graph_get_n_values
+ * @graph: a graph
+ *
+ * Returns: number of values in each sample of @graph.
+ *
+ * Since: 0.9.3
+ */
+extern guint panel_graph_get_n_values(PanelGraph *graph);
+
+/**
+ * panel_graph_new_sample
+ * @graph: a graph
+ *
+ * Retrieves place in the ring buffer where values of a new sample should
+ * be written. Sample is shown after panel_graph_commit_sample() call.
+ *
+ * Returns: (transfer none): array of values or %NULL if @graph isn't
+ * allocated yet.
+ *
+ * Since: 0.9.3
+ */
+extern gfloat *panel_graph_new_sample(PanelGraph *graph);
+
+/**
+ * panel_graph_commit_sample
+ * @graph: a graph
+ *
+ * Draws the sample written into place returned by panel_graph_new_sample()
+ * and advances the ring buffer.
+ *
+ * Since: 0.9.3
+ */
+extern void panel_graph_commit_sample(PanelGraph *graph);
+
+/**
+ * panel_graph_get_last_sample
+ * @graph: a graph
+ *
+ * Returns: (transfer none): values of the newest sample or %NULL if
+ * @graph isn't allocated yet.
+ *
+ * Since: 0.9.3
+ */
+extern const gfloat *panel_graph_get_last_sample(PanelGraph *graph);
+
+/**
+ * panel_graph_redraw
+ * @graph: a graph
+ *
+ * Draws the whole graph again, e.g. after colors were changed.
+ *
+ * Since: 0.9.3
+ */
+extern void panel_graph_redraw(PanelGraph *graph);
+
+G_END_DECLS
+
+#endif
@@ -42,6 +42,7 @@ static const char usage[] =
         "run\t\t\tshow run dialog\n"
         "config\t\t\tshow configuration dialog\n"
         "restart\t\t\trestart lxpanel\n"
+        "reload\t\t\tapply changes in config files\n"
         "exit\t\t\texit lxpanel\n"
         "command <plugin> <cmd>\tsend a command to a plugin\n\n";
 
@@ -59,6 +60,8 @@ static int get_cmd( const char* cmd )
         return LXPANEL_CMD_EXIT;
     else if( ! strcmp( cmd, "command") )
         return LXPANEL_CMD_COMMAND;
+    else if( ! strcmp( cmd, "reload") )
+        return LXPANEL_CMD_RELOAD;
     return -1;
 }
 
@@ -39,11 +39,15 @@
 #include <glib/gi18n.h>
 #include <stdlib.h>
 #include <glib/gstdio.h>
+#if GLIB_CHECK_VERSION(2, 30, 0)
+#include <glib-unix.h>
+#endif
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 #include <locale.h>
+#include <signal.h>
 #include <string.h>
 #include <gdk/gdkx.h>
 #include <libfm/fm-gtk.h>
@@ -81,6 +85,68 @@ void restart(void)
     RET();
 }
 
+#if GLIB_CHECK_VERSION(2, 30, 0)
+/* Config is written with a delay after a change and session may kill the
+   panel right then, so write it now and leave the main loop as usual. */
+static gboolean quit_on_signal(gpointer unused)
+{
+    GSList *l;
+
+    for (l = all_panels; l; l = l->next)
+    {
+        Panel *p = ((LXPanel*)l->data)->priv;
+
+        if (p->config_save_queued)
+            panel_config_save(p);
+    }
+    gtk_main_quit();
+    return TRUE;
+}
+#endif
+
+/* Applies changes in user config files of panels without restart, so
+   plugins with unchanged config and all caches are kept. */
+static void reload(void)
+{
+    char *panel_dir = _user_config_file_name("panels", NULL);
+    GSList *panels, *l;
+    GDir *dir;
+    const gchar *name;
+    char *file;
+    LXPanel *p;
+
+    /* panels list is changed if panel is recreated */
+    panels = g_slist_copy(all_panels);
+    for (l = panels; l; l = l->next)
+    {
+        p = l->data;
+        file = g_build_filename(panel_dir, p->priv->name, NULL);
+        if (g_file_test(file, G_FILE_TEST_EXISTS))
+            _lxpanel_reload(p, file);
+        g_free(file);
+    }
+    g_slist_free(panels);
+
+    /* start panels which were added */
+    dir = g_dir_open(panel_dir, 0, NULL);
+    if (dir) while ((name = g_dir_read_name(dir)) != NULL)
+    {
+        for (l = all_panels; l; l = l->next)
+            if (strcmp(((LXPanel *)l->data)->priv->name, name) == 0)
+                break;
+        if (l != NULL || strchr(name, '~') != NULL)
+            continue;
+        file = g_build_filename(panel_dir, name, NULL);
+        p = panel_new(file, name);
+        if (p)
+            all_panels = g_slist_prepend(all_panels, p);
+        g_free(file);
+    }
+    if (dir)
+        g_dir_close(dir);
+    g_free(panel_dir);
+}
+
 static void process_client_msg ( XClientMessageEvent* ev )
 {
     int cmd = ev->data.b[0];
@@ -127,6 +193,9 @@ static void process_client_msg ( XClientMessageEvent* ev )
         case LXPANEL_CMD_RESTART:
             restart();
             break;
+        case LXPANEL_CMD_RELOAD:
+            reload();
+            break;
         case LXPANEL_CMD_EXIT:
             gtk_main_quit();
             break;
@@ -168,7 +237,10 @@ static void process_client_msg ( XClientMessageEvent* ev )
                 plugins = gtk_container_get_children(GTK_CONTAINER(p->priv->box));
                 for (pl = plugins; pl; pl = pl->next)
                 {
-                    if (init == PLUGIN_CLASS(pl->data))
+                    /* with deferred start plugin may be still a placeholder */
+                    if (init == PLUGIN_CLASS(pl->data) ||
+                        (_lxpanel_is_placeholder(pl->data) &&
+                         strcmp(gtk_widget_get_name(pl->data), plugin_type) == 0))
                     {
                         plugin = pl->data;
                         break;
@@ -211,8 +283,8 @@ static void process_client_msg ( XClientMessageEvent* ev )
                             config_setting_destroy(cfg);
                     }
                 }
-                /* send the command */
-                else if (plugin && init->control)
+                /* send the command, placeholder has no handler yet */
+                else if (plugin && init->control && !_lxpanel_is_placeholder(plugin))
                     init->control(plugin, command);
             } while(0);
             g_free(plugin_type);
@@ -220,6 +292,71 @@ static void process_client_msg ( XClientMessageEvent* ev )
     }
 }
 
+/* Root window properties changed since last processing: bits (1 << signal)
+ * of FbEv signals and a bit for the background */
+#define ROOT_BACKGROUND (1 << LAST_SIGNAL)
+
+static guint root_changes = 0;
+static guint root_changes_flush = 0;
+static guint root_events = 0; /* statistics: events received */
+static guint root_handled = 0; /* statistics: changes processed */
+
+static gboolean root_changes_process(gpointer unused)
+{
+    guint changes = root_changes;
+    GSList* l;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    root_changes = 0;
+    root_changes_flush = 0;
+
+    /* Process changes in order of dependency, not in order of events. */
+    if (changes & (1 << EV_NUMBER_OF_DESKTOPS))
+    {
+        for( l = all_panels; l; l = l->next )
+            ((LXPanel*)l->data)->priv->desknum = get_net_number_of_desktops();
+        fb_ev_emit(fbev, EV_NUMBER_OF_DESKTOPS);
+        root_handled++;
+    }
+    if (changes & (1 << EV_CURRENT_DESKTOP))
+    {
+        for( l = all_panels; l; l = l->next )
+            ((LXPanel*)l->data)->priv->curdesk = get_net_current_desktop();
+        fb_ev_emit(fbev, EV_CURRENT_DESKTOP);
+        root_handled++;
+    }
+    if (changes & (1 << EV_DESKTOP_NAMES))
+    {
+        fb_ev_emit(fbev, EV_DESKTOP_NAMES);
+        root_handled++;
+    }
+    if (changes & (1 << EV_CLIENT_LIST))
+    {
+        fb_ev_emit(fbev, EV_CLIENT_LIST);
+        root_handled++;
+    }
+    if (changes & (1 << EV_CLIENT_LIST_STACKING))
+    {
+        fb_ev_emit(fbev, EV_CLIENT_LIST_STACKING);
+        root_handled++;
+    }
+    if (changes & (1 << EV_ACTIVE_WINDOW))
+    {
+        fb_ev_emit(fbev, EV_ACTIVE_WINDOW );
+        root_handled++;
+    }
+    if (changes & ROOT_BACKGROUND)
+    {
+        for( l = all_panels; l; l = l->next )
+            _panel_queue_update_background((LXPanel*)l->data);
+        root_handled++;
+    }
+    g_debug("root window: %u of %u property events coalesced in total",
+            root_events - root_handled, root_events);
+    return FALSE;
+}
+
 static GdkFilterReturn
 panel_event_filter(GdkXEvent *xevent, GdkEvent *event, gpointer not_used)
 {
@@ -247,45 +384,34 @@ panel_event_filter(GdkXEvent *xevent, GdkEvent *event, gpointer not_used)
     win = ev->xproperty.window;
     if (win == GDK_ROOT_WINDOW())
     {
+        guint change;
+
         if (at == a_NET_CLIENT_LIST)
-        {
-            fb_ev_emit(fbev, EV_CLIENT_LIST);
-        }
+            change = 1 << EV_CLIENT_LIST;
         else if (at == a_NET_CURRENT_DESKTOP)
-        {
-            GSList* l;
-            for( l = all_panels; l; l = l->next )
-                ((LXPanel*)l->data)->priv->curdesk = get_net_current_desktop();
-            fb_ev_emit(fbev, EV_CURRENT_DESKTOP);
-        }
+            change = 1 << EV_CURRENT_DESKTOP;
         else if (at == a_NET_NUMBER_OF_DESKTOPS)
-        {
-            GSList* l;
-            for( l = all_panels; l; l = l->next )
-                ((LXPanel*)l->data)->priv->desknum = get_net_number_of_desktops();
-            fb_ev_emit(fbev, EV_NUMBER_OF_DESKTOPS);
-        }
+            change = 1 << EV_NUMBER_OF_DESKTOPS;
         else if (at == a_NET_DESKTOP_NAMES)
-        {
-            fb_ev_emit(fbev, EV_DESKTOP_NAMES);
-        }
+            change = 1 << EV_DESKTOP_NAMES;
         else if (at == a_NET_ACTIVE_WINDOW)
-        {
-            fb_ev_emit(fbev, EV_ACTIVE_WINDOW );
-        }
+            change = 1 << EV_ACTIVE_WINDOW;
         else if (at == a_NET_CLIENT_LIST_STACKING)
-        {
-            fb_ev_emit(fbev, EV_CLIENT_LIST_STACKING);
-        }
+            change = 1 << EV_CLIENT_LIST_STACKING;
         else if (at == a_XROOTPMAP_ID)
-        {
-            GSList* l;
-            for( l = all_panels; l; l = l->next )
-                _panel_queue_update_background((LXPanel*)l->data);
-        }
+            change = ROOT_BACKGROUND;
         else
             return GDK_FILTER_CONTINUE;
 
+        /* Drop the cached value at once so nobody gets it outdated, but
+         * defer the signal so repeated changes are handled only once. */
+        if (change != ROOT_BACKGROUND)
+            fb_ev_invalidate(fbev, g_bit_nth_lsf(change, -1));
+        root_events++;
+        root_changes |= change;
+        if (root_changes_flush == 0)
+            root_changes_flush = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                                                 root_changes_process, NULL, NULL);
         return GDK_FILTER_REMOVE;
     }
     return GDK_FILTER_CONTINUE;
@@ -344,6 +470,8 @@ usage()
 //    g_print(_(" --log <number> -- set log level 0-5. 0 - none 5 - chatty\n"));
 //    g_print(_(" --configure -- launch configuration utility\n"));
     g_print(_(" --profile name -- use specified profile\n"));
+    g_print(_(" --defer-plugins -- show panels first and load plugins afterwards\n"));
+    g_print(_(" --startup-trace file -- write plugins load times into file\n"));
     g_print("\n");
     g_print(_(" -h  -- same as --help\n"));
     g_print(_(" -p  -- same as --profile\n"));
@@ -538,6 +666,17 @@ int main(int argc, char *argv[], char *env[])
             } else {
                 cprofile = g_strdup(argv[i]);
             }
+        } else if (!strcmp(argv[i], "--defer-plugins")) {
+            deferred_start = TRUE;
+        } else if (!strcmp(argv[i], "--startup-trace")) {
+            i++;
+            if (i == argc) {
+                g_critical( "lxpanel: missing trace file name");
+                usage();
+                exit(1);
+            } else {
+                _lxpanel_startup_trace_open(argv[i]);
+            }
         } else {
             printf("lxpanel: unknown option - %s\n", argv[i]);
             usage();
@@ -584,6 +723,11 @@ int main(int argc, char *argv[], char *env[])
 
     if( G_UNLIKELY( ! start_all_panels() ) )
         g_warning( "Config files are not found.\n" );
+#if GLIB_CHECK_VERSION(2, 30, 0)
+    g_unix_signal_add(SIGTERM, quit_on_signal, NULL);
+    g_unix_signal_add(SIGINT, quit_on_signal, NULL);
+    g_unix_signal_add(SIGHUP, quit_on_signal, NULL);
+#endif
 /*
  * FIXME: configure??
     if (config)
@@ -593,6 +737,9 @@ int main(int argc, char *argv[], char *env[])
 
     XSelectInput (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), GDK_ROOT_WINDOW(), NoEventMask);
     gdk_window_remove_filter(gdk_get_default_root_window (), (GdkFilterFunc)panel_event_filter, NULL);
+    if (root_changes_flush != 0)
+        g_source_remove(root_changes_flush);
+    root_changes_flush = 0;
 
     /* destroy all panels */
     g_slist_foreach( all_panels, (GFunc) gtk_widget_destroy, NULL );
@@ -601,6 +748,7 @@ int main(int argc, char *argv[], char *env[])
     g_free( cfgfile );
 
     free_global_config();
+    _lxpanel_startup_trace_close();
 
     lxpanel_unload_modules();
     fm_gtk_finalize();
@@ -27,8 +27,16 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <X11/Xatom.h>
 #include <X11/cursorfont.h>
+#ifdef HAVE_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
 
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
@@ -482,6 +490,165 @@ Xclimsgwm(Window win, Atom type, Atom arg)
 }
 
 
+/* Pipelined properties requests, see lxpanel_xprop_prefetch() */
+#ifdef HAVE_XCB
+static struct {
+    xcb_connection_t *conn;
+    GHashTable *wins;                   /* Window -> index of first request + 1 */
+    Atom *props;                        /* list of requested properties */
+    guint n_props;
+    guint n;                            /* number of requests */
+    xcb_get_property_cookie_t *cookies;
+    xcb_get_property_reply_t **replies; /* NULL if not received yet or failed */
+    gboolean *received;
+} prefetch;
+
+/* Converts reply into the same form XGetWindowProperty() would return.
+   Memory is allocated with malloc() so caller can release it with XFree(). */
+static unsigned char *xprop_reply_to_xlib(xcb_get_property_reply_t *reply,
+                                          unsigned long *nitems)
+{
+    const void *value = xcb_get_property_value(reply);
+    int len = xcb_get_property_value_length(reply);
+    unsigned char *data;
+    unsigned long i, n;
+
+    switch (reply->format)
+    {
+    case 8:
+        n = len;
+        /* Xlib always adds a trailing zero */
+        data = malloc(n + 1);
+        memcpy(data, value, n);
+        data[n] = '\0';
+        break;
+    case 16:
+        n = len / 2;
+        data = malloc(n * sizeof(short) + 1);
+        for (i = 0; i < n; i++)
+            ((unsigned short *)data)[i] = ((const guint16 *)value)[i];
+        break;
+    case 32:
+        /* Xlib returns format 32 data as array of long */
+        n = len / 4;
+        data = malloc(n * sizeof(long) + 1);
+        for (i = 0; i < n; i++)
+            ((unsigned long *)data)[i] = ((const guint32 *)value)[i];
+        break;
+    default:
+        n = 0;
+        data = NULL;
+    }
+    *nitems = n;
+    return data;
+}
+#endif
+
+/* Returns TRUE if property @prop of @win was requested by prefetch, then
+   fills rest of arguments as XGetWindowProperty() does. */
+static gboolean xprop_get_prefetched(Window win, Atom prop, Atom type,
+                                     Atom *type_ret, int *format_ret,
+                                     unsigned long *items_ret,
+                                     unsigned char **prop_ret)
+{
+#ifdef HAVE_XCB
+    xcb_get_property_reply_t *reply;
+    xcb_generic_error_t *error = NULL;
+    guint i, j;
+
+    if (prefetch.wins == NULL)
+        return FALSE;
+    i = GPOINTER_TO_UINT(g_hash_table_lookup(prefetch.wins, GUINT_TO_POINTER(win)));
+    if (i == 0)
+        return FALSE;
+    for (j = 0; j < prefetch.n_props; j++)
+        if (prefetch.props[j] == prop)
+            break;
+    if (j == prefetch.n_props)
+        return FALSE;
+    i += j - 1;
+    if (!prefetch.received[i])
+    {
+        /* replies for the rest of requests are most likely arrived too */
+        prefetch.replies[i] = xcb_get_property_reply(prefetch.conn,
+                                                     prefetch.cookies[i], &error);
+        prefetch.received[i] = TRUE;
+        free(error);
+    }
+    reply = prefetch.replies[i];
+    *items_ret = 0;
+    *prop_ret = NULL;
+    if (reply == NULL) /* window was destroyed already */
+    {
+        *type_ret = None;
+        *format_ret = 0;
+    }
+    else
+    {
+        *type_ret = reply->type;
+        *format_ret = reply->format;
+        if (reply->type != None && (type == AnyPropertyType || type == reply->type))
+            *prop_ret = xprop_reply_to_xlib(reply, items_ret);
+    }
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+void lxpanel_xprop_prefetch(const Window *wins, int n_wins,
+                            const Atom *props, int n_props)
+{
+#ifdef HAVE_XCB
+    int i, j;
+
+    lxpanel_xprop_prefetch_done();
+    if (n_wins <= 0 || n_props <= 0)
+        return;
+    prefetch.conn = XGetXCBConnection(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()));
+    prefetch.wins = g_hash_table_new(g_direct_hash, NULL);
+    prefetch.props = g_memdup(props, n_props * sizeof(Atom));
+    prefetch.n_props = n_props;
+    prefetch.cookies = g_new(xcb_get_property_cookie_t, n_wins * n_props);
+    prefetch.replies = g_new0(xcb_get_property_reply_t *, n_wins * n_props);
+    prefetch.received = g_new0(gboolean, n_wins * n_props);
+    for (i = 0; i < n_wins; i++)
+    {
+        if (g_hash_table_lookup(prefetch.wins, GUINT_TO_POINTER(wins[i])))
+            continue;
+        g_hash_table_insert(prefetch.wins, GUINT_TO_POINTER(wins[i]),
+                            GUINT_TO_POINTER(prefetch.n + 1));
+        for (j = 0; j < n_props; j++)
+            prefetch.cookies[prefetch.n++] = xcb_get_property(prefetch.conn, 0,
+                                                              wins[i], props[j],
+                                                              XCB_GET_PROPERTY_TYPE_ANY,
+                                                              0, G_MAXINT32);
+    }
+    xcb_flush(prefetch.conn);
+#endif
+}
+
+void lxpanel_xprop_prefetch_done(void)
+{
+#ifdef HAVE_XCB
+    guint i;
+
+    if (prefetch.wins == NULL)
+        return;
+    for (i = 0; i < prefetch.n; i++)
+        if (prefetch.received[i])
+            free(prefetch.replies[i]);
+        else
+            xcb_discard_reply(prefetch.conn, prefetch.cookies[i].sequence);
+    g_hash_table_destroy(prefetch.wins);
+    g_free(prefetch.props);
+    g_free(prefetch.cookies);
+    g_free(prefetch.replies);
+    g_free(prefetch.received);
+    memset(&prefetch, 0, sizeof(prefetch));
+#endif
+}
+
 void *
 get_utf8_property(Window win, Atom atom)
 {
@@ -495,9 +662,12 @@ get_utf8_property(Window win, Atom atom)
 
     type = None;
     retval = NULL;
-    result = XGetWindowProperty (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, atom, 0, G_MAXLONG, False,
-          a_UTF8_STRING, &type, &format, &nitems,
-          &bytes_after, &tmp);
+    if (xprop_get_prefetched(win, atom, a_UTF8_STRING, &type, &format, &nitems, &tmp))
+        result = Success;
+    else
+        result = XGetWindowProperty (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, atom, 0, G_MAXLONG, False,
+              a_UTF8_STRING, &type, &format, &nitems,
+              &bytes_after, &tmp);
     if (result != Success || type == None)
         return NULL;
     val = (gchar *) tmp;
@@ -563,12 +733,17 @@ get_xaproperty (Window win, Atom prop, Atom type, int *nitems)
     unsigned long items_ret;
     unsigned long after_ret;
     unsigned char *prop_data;
+    int result;
 
     ENTER;
     prop_data = NULL;
-    if (XGetWindowProperty (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, prop, 0, G_MAXLONG, False,
-              type, &type_ret, &format_ret, &items_ret,
-              &after_ret, &prop_data) != Success || items_ret == 0)
+    if (xprop_get_prefetched(win, prop, type, &type_ret, &format_ret, &items_ret, &prop_data))
+        result = Success;
+    else
+        result = XGetWindowProperty (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, prop, 0, G_MAXLONG, False,
+                  type, &type_ret, &format_ret, &items_ret,
+                  &after_ret, &prop_data);
+    if (result != Success || items_ret == 0)
     {
         if( G_UNLIKELY(prop_data) )
             XFree( prop_data );
@@ -616,6 +791,17 @@ get_textproperty(Window win, Atom atom)
     char *retval;
 
     ENTER;
+    if (xprop_get_prefetched(win, atom, AnyPropertyType, &text_prop.encoding,
+                             &text_prop.format, &text_prop.nitems, &text_prop.value))
+    {
+        /* XGetTextProperty() fails on empty property too */
+        retval = NULL;
+        if (text_prop.value != NULL && text_prop.nitems > 0)
+            retval = text_property_to_utf8 (&text_prop);
+        if (text_prop.value != NULL)
+            XFree (text_prop.value);
+        RET(retval);
+    }
     if (XGetTextProperty(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), win, &text_prop, atom)) {
         DBG("format=%d enc=%d nitems=%d value=%s   \n",
               text_prop.format,
@@ -639,6 +825,9 @@ get_net_number_of_desktops()
     gulong *data;
 
     ENTER;
+    /* use shared cache if it's available */
+    if (fbev)
+        RET(fb_ev_number_of_desktops(fbev));
     data = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_NUMBER_OF_DESKTOPS,
           XA_CARDINAL, 0);
     if (!data)
@@ -657,6 +846,9 @@ get_net_current_desktop ()
     gulong *data;
 
     ENTER;
+    /* use shared cache if it's available */
+    if (fbev)
+        RET(fb_ev_current_desktop(fbev));
     data = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_CURRENT_DESKTOP, XA_CARDINAL, 0);
     if (!data)
         RET(0);
@@ -134,6 +134,35 @@ void get_net_wm_state(Window win, NetWMState *nws);
 void get_net_wm_window_type(Window win, NetWMWindowType *nwwt);
 GPid get_net_wm_pid(Window win);
 
+/**
+ * lxpanel_xprop_prefetch
+ * @wins: list of windows
+ * @n_wins: number of windows in @wins
+ * @props: list of properties to request
+ * @n_props: number of properties in @props
+ *
+ * Sends requests for each of @props on each of @wins to X server at once
+ * without waiting for replies. Until lxpanel_xprop_prefetch_done() is
+ * called, get_xaproperty(), get_utf8_property(), get_textproperty() and
+ * all getters based on them will take data from those replies instead of
+ * doing a round-trip to X server for each property. This is a no-op if
+ * lxpanel was built without XCB support.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_xprop_prefetch(const Window *wins, int n_wins,
+                                   const Atom *props, int n_props);
+
+/**
+ * lxpanel_xprop_prefetch_done
+ *
+ * Drops all replies requested by lxpanel_xprop_prefetch(), so subsequent
+ * property getters will fetch fresh data from X server.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_xprop_prefetch_done(void);
+
 /**
  * panel_handle_x_error
  * @d: X display
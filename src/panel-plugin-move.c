@@ -43,6 +43,7 @@ gboolean _lxpanel_button_release(GtkWidget *widget, GdkEventButton *event)
         }
         p->move_state = PANEL_MOVE_STOP;
         p->move_device = NULL;
+        _panel_resume_deferred(PLUGIN_PANEL(widget));
         return TRUE;
     }
     return FALSE;
@@ -90,6 +91,7 @@ gboolean _lxpanel_motion_notify(GtkWidget *widget, GdkEventMotion *event)
                 p->move_state = PANEL_MOVE_STOP;
                 p->move_device = NULL;
                 g_list_free(plugins);
+                _panel_resume_deferred(PLUGIN_PANEL(widget));
                 return TRUE;
             }
             /* grab pointer, use cursor "move" */
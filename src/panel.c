@@ -67,6 +67,8 @@ GSList* all_panels = NULL;  /* a single-linked list storing all panels */
 
 gboolean is_in_lxde = FALSE;
 
+gboolean deferred_start = FALSE; /* construct plugins after panel is mapped */
+
 static GtkWindowGroup* win_grp = NULL; /* window group used to limit the scope of model dialog. */
 
 static gulong monitors_handler = 0;
@@ -76,6 +78,9 @@ static void ah_start(LXPanel *p);
 static void ah_stop(LXPanel *p);
 static void _panel_update_background(LXPanel * p, gboolean enforce);
 
+typedef struct _DeferredPlugin DeferredPlugin;
+static void deferred_plugin_free(DeferredPlugin *dp);
+
 enum
 {
     ICON_SIZE_CHANGED,
@@ -93,7 +98,9 @@ static void lxpanel_finalize(GObject *object)
     Panel *p = self->priv;
 
     if( p->config_changed )
-        lxpanel_config_save( self );
+        panel_config_save( p );
+    if (p->config_save_queued)
+        g_source_remove(p->config_save_queued);
     config_destroy(p->config);
 
     //XFree(p->workarea);
@@ -155,6 +162,15 @@ static void panel_stop_gui(LXPanel *self)
         p->reconfigure_queued = 0;
     }
 
+    if (p->deferred_idle)
+    {
+        g_source_remove(p->deferred_idle);
+        p->deferred_idle = 0;
+    }
+    g_list_foreach(p->deferred_plugins, (GFunc)deferred_plugin_free, NULL);
+    g_list_free(p->deferred_plugins);
+    p->deferred_plugins = NULL;
+
     if (gtk_bin_get_child(GTK_BIN(self)))
     {
         gtk_widget_destroy(p->box);
@@ -1021,6 +1037,7 @@ static void ah_state_set(LXPanel *panel, PanelAHState ah_state)
             gtk_widget_show(p->box);
             gtk_widget_queue_resize(GTK_WIDGET(panel));
             gtk_window_stick(GTK_WINDOW(panel));
+            _lxpanel_tick_panel_visibility_changed();
             break;
         case AH_STATE_WAITING:
             if (p->hide_timeout)
@@ -1033,6 +1050,7 @@ static void ah_state_set(LXPanel *panel, PanelAHState ah_state)
             else
                 gtk_widget_hide(GTK_WIDGET(panel));
             p->visible = FALSE;
+            _lxpanel_tick_panel_visibility_changed();
         }
     } else if (p->autohide && p->ah_far) {
         switch (ah_state) {
@@ -1581,19 +1599,187 @@ gboolean lxpanel_image_set_icon_theme(LXPanel * p, GtkWidget * image, const gcha
     return panel_image_set_icon_theme(p->priv, image, icon);
 }
 
+/****************************************************
+ *         startup timeline and deferred plugins    *
+ ****************************************************/
+
+static FILE *startup_trace = NULL;
+static gint64 startup_time = 0;
+
+void _lxpanel_startup_trace_open(const char *file)
+{
+    startup_time = g_get_monotonic_time();
+    startup_trace = g_fopen(file, "w");
+    if (startup_trace == NULL)
+    {
+        g_warning("lxpanel: cannot write startup trace to %s: %s", file,
+                  g_strerror(errno));
+        return;
+    }
+    fputs("# start_us\tduration_us\tpanel\tevent\tplugin\n", startup_trace);
+}
+
+void _lxpanel_startup_trace_close(void)
+{
+    if (startup_trace != NULL)
+        fclose(startup_trace);
+    startup_trace = NULL;
+}
+
+/* Writes event which started at @start and ends now. */
+static void startup_trace_write(Panel *p, gint64 start, const char *event,
+                                const char *type)
+{
+    if (startup_trace == NULL)
+        return;
+    fprintf(startup_trace, "%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\t%s\t%s\n",
+            start - startup_time, g_get_monotonic_time() - start, p->name,
+            event, type ? type : "-");
+    fflush(startup_trace);
+}
+
+/* Plugins which read lots of data when constructed go last, so the rest of
+   panel becomes usable sooner. Plugins not listed have priority 0. */
+static const struct {
+    const char *type;
+    int priority;
+} deferred_priorities[] = {
+    { "space", -1 },
+    { "separator", -1 },
+    { "launchtaskbar", 1 },
+    { "taskbar", 1 },
+    { "launchbar", 1 },
+    { "dirmenu", 1 },
+    { "tray", 2 },
+    { "menu", 2 }
+};
+
+struct _DeferredPlugin {
+    GtkWidget *placeholder;     /* NULL if it was removed meanwhile */
+    int priority;
+};
+
+static void deferred_plugin_free(DeferredPlugin *dp)
+{
+    if (dp->placeholder != NULL)
+        g_object_remove_weak_pointer(G_OBJECT(dp->placeholder),
+                                     (gpointer *)&dp->placeholder);
+    g_slice_free(DeferredPlugin, dp);
+}
+
+static gint deferred_plugin_compare(gconstpointer a, gconstpointer b)
+{
+    return ((DeferredPlugin *)a)->priority - ((DeferredPlugin *)b)->priority;
+}
+
+static void panel_defer_plugin(LXPanel *panel, const char *type, config_setting_t *cfg)
+{
+    Panel *p = panel->priv;
+    DeferredPlugin *dp = g_slice_new(DeferredPlugin);
+    guint i;
+
+    dp->placeholder = _lxpanel_add_placeholder(panel, type, cfg);
+    g_object_add_weak_pointer(G_OBJECT(dp->placeholder), (gpointer *)&dp->placeholder);
+    dp->priority = 0;
+    for (i = 0; i < G_N_ELEMENTS(deferred_priorities); i++)
+        if (strcmp(deferred_priorities[i].type, type) == 0)
+            dp->priority = deferred_priorities[i].priority;
+    p->deferred_plugins = g_list_append(p->deferred_plugins, dp);
+}
+
+/* Replaces one placeholder with constructed plugin per call, so the panel
+   is redrawn and stays responsive between them. */
+static gboolean panel_construct_deferred(gpointer user_data)
+{
+    LXPanel *panel = user_data;
+    Panel *p = panel->priv;
+    DeferredPlugin *dp;
+    GtkWidget *placeholder;
+    config_setting_t *cfg;
+    gchar *type;
+    gint pos;
+    gint64 start;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    /* don't pull the plugin from under the user's pointer, the idle is
+       added again by _panel_resume_deferred() when the move ends */
+    if (p->move_state != PANEL_MOVE_STOP)
+    {
+        p->deferred_idle = 0;
+        return FALSE;
+    }
+
+    while (p->deferred_plugins != NULL)
+    {
+        dp = p->deferred_plugins->data;
+        p->deferred_plugins = g_list_delete_link(p->deferred_plugins, p->deferred_plugins);
+        placeholder = dp->placeholder;
+        deferred_plugin_free(dp);
+        if (placeholder == NULL)
+            continue;
+
+        /* configurator keeps pointers to panel children, close it */
+        if (p->pref_dialog != NULL)
+        {
+            gtk_widget_destroy(p->pref_dialog);
+            p->pref_dialog = NULL;
+        }
+        cfg = g_object_get_qdata(G_OBJECT(placeholder), lxpanel_plugin_qconf);
+        type = g_strdup(gtk_widget_get_name(placeholder));
+        gtk_container_child_get(GTK_CONTAINER(p->box), placeholder, "position", &pos, NULL);
+        gtk_widget_destroy(placeholder);
+
+        start = g_get_monotonic_time();
+        if (lxpanel_add_plugin(panel, type, cfg, pos) == NULL)
+        {
+            g_warning("lxpanel: can't load %s plugin", type);
+            startup_trace_write(p, start, "failed", type);
+            /* remove invalid data from config */
+            config_setting_destroy(cfg);
+        }
+        else
+            startup_trace_write(p, start, "plugin", type);
+        g_free(type);
+        break;
+    }
+    if (p->deferred_plugins != NULL)
+        return TRUE;
+    startup_trace_write(p, g_get_monotonic_time(), "ready", NULL);
+    p->deferred_idle = 0;
+    return FALSE;
+}
+
+/* Continues construction of deferred plugins if it was paused. */
+void _panel_resume_deferred(LXPanel *panel)
+{
+    Panel *p = panel->priv;
+
+    if (p->deferred_plugins != NULL && p->deferred_idle == 0)
+        p->deferred_idle = g_idle_add(panel_construct_deferred, panel);
+}
+
 static int
 panel_parse_plugin(LXPanel *p, config_setting_t *cfg)
 {
     const char *type = NULL;
+    gint64 start;
 
     ENTER;
     config_setting_lookup_string(cfg, "type", &type);
     DBG("plug %s\n", type);
 
+    if (type && deferred_start) {
+        panel_defer_plugin(p, type, cfg);
+        RET(1);
+    }
+    start = g_get_monotonic_time();
     if (!type || lxpanel_add_plugin(p, type, cfg, -1) == NULL) {
         g_warning( "lxpanel: can't load %s plugin", type);
+        startup_trace_write(p->priv, start, "failed", type);
         goto error;
     }
+    startup_trace_write(p->priv, start, "plugin", type);
     RET(1);
 
 error:
@@ -1668,6 +1854,7 @@ panel_start_gui(LXPanel *panel, config_setting_t *list)
     _calculate_position(panel, &rect);
     gtk_window_move(GTK_WINDOW(panel), rect.x, rect.y);
     gtk_window_present(GTK_WINDOW(panel));
+    startup_trace_write(p, g_get_monotonic_time(), "map", NULL);
 
     /* the settings that should be done after window is mapped */
 
@@ -1693,6 +1880,15 @@ panel_start_gui(LXPanel *panel, config_setting_t *list)
         else /* remove invalid data from config */
             config_setting_remove_elem(list, i);
 
+    if (p->deferred_plugins != NULL)
+    {
+        /* g_list_sort() is stable so config order is kept within priority */
+        p->deferred_plugins = g_list_sort(p->deferred_plugins, deferred_plugin_compare);
+        p->deferred_idle = g_idle_add(panel_construct_deferred, panel);
+    }
+    else
+        startup_trace_write(p, g_get_monotonic_time(), "ready", NULL);
+
     RET();
 }
 
@@ -2022,6 +2218,134 @@ LXPanel* panel_new( const char* config_file, const char* config_name )
 }
 
 
+/* Makes plugins of panel match the list of plugins in new config: plugins
+   with unchanged config are kept and moved to the new place, all others
+   are destroyed or created. Config of kept plugins stays in the same
+   place in memory as they may keep pointers into it. */
+static void panel_reload_plugins(LXPanel *panel, config_setting_t *new_list)
+{
+    Panel *p = panel->priv;
+    config_setting_t *list, *s, *cfg;
+    GList *plugins, *l;
+    GtkWidget *w;
+    const char *type;
+    gint64 start;
+    int i, pos;
+
+    list = config_setting_get_member(config_root_setting(p->config), "");
+    plugins = gtk_container_get_children(GTK_CONTAINER(p->box));
+    /* find an unchanged plugin for each new config, NULL data means taken */
+    for (i = 1, pos = 0; (s = config_setting_get_elem(new_list, i)) != NULL; i++)
+    {
+        if (strcmp(config_setting_get_name(s), "Plugin") != 0)
+            continue;
+        for (l = plugins; l; l = l->next)
+        {
+            if (l->data == NULL)
+                continue;
+            cfg = g_object_get_qdata(G_OBJECT(l->data), lxpanel_plugin_qconf);
+            /* plugin may add empty "Config" or defaults to its config */
+            if (cfg != NULL && config_setting_includes(cfg, s))
+                break;
+        }
+        if (l != NULL)
+        {
+            w = l->data;
+            l->data = NULL;
+            /* all before pos are in place already so these are moved back */
+            config_setting_move_elem(cfg, list, pos + 1);
+            gtk_box_reorder_child(GTK_BOX(p->box), w, pos);
+            pos++;
+            continue;
+        }
+        /* it is a new or changed plugin, create it with copy of config */
+        cfg = config_setting_copy(list, s);
+        config_setting_move_elem(cfg, list, pos + 1);
+        type = NULL;
+        config_setting_lookup_string(cfg, "type", &type);
+        start = g_get_monotonic_time();
+        if (type == NULL || lxpanel_add_plugin(panel, type, cfg, pos) == NULL)
+        {
+            g_warning("lxpanel: can't load %s plugin", type);
+            config_setting_destroy(cfg);
+            continue;
+        }
+        startup_trace_write(p, start, "plugin", type);
+        pos++;
+    }
+    /* remove plugins which aren't in new config anymore */
+    for (l = plugins; l; l = l->next)
+    {
+        if (l->data == NULL)
+            continue;
+        cfg = g_object_get_qdata(G_OBJECT(l->data), lxpanel_plugin_qconf);
+        g_object_set_qdata(G_OBJECT(l->data), lxpanel_plugin_qconf, NULL);
+        config_setting_destroy(cfg);
+        gtk_widget_destroy(l->data);
+    }
+    g_list_free(plugins);
+}
+
+void _lxpanel_reload(LXPanel *panel, const char *file)
+{
+    Panel *p = panel->priv;
+    PanelConf *config;
+    PanelConfError error;
+    config_setting_t *list, *new_list;
+    gint64 start = g_get_monotonic_time();
+    char *name;
+
+    config = config_new();
+    if (!config_read_file_checked(config, file, &error))
+    {
+        g_warning("lxpanel: %s:%u:%u: %s, panel is not reloaded", file,
+                  error.line, error.column, error.message);
+        config_destroy(config);
+        return;
+    }
+    /* file has priority over unsaved changes */
+    if (p->config_save_queued)
+    {
+        g_source_remove(p->config_save_queued);
+        p->config_save_queued = 0;
+    }
+    p->config_changed = 0;
+
+    list = config_setting_get_member(config_root_setting(p->config), "");
+    new_list = config_setting_get_member(config_root_setting(config), "");
+    if (p->box != NULL && list != NULL && new_list != NULL &&
+        config_setting_equal(config_setting_get_elem(list, 0),
+                             config_setting_get_elem(new_list, 0)))
+    {
+        if (p->pref_dialog != NULL)
+        {
+            /* configurator keeps pointers to plugins, close it */
+            gtk_widget_destroy(p->pref_dialog);
+            p->pref_dialog = NULL;
+        }
+        panel_reload_plugins(panel, new_list);
+        startup_trace_write(p, start, "reload", NULL);
+        g_debug("panel '%s' reloaded in %" G_GINT64_FORMAT " us", p->name,
+                g_get_monotonic_time() - start);
+        config_destroy(config);
+        return;
+    }
+    config_destroy(config);
+
+    /* global settings are changed, recreate the panel but it still is
+       much faster than restart since all caches are kept */
+    all_panels = g_slist_remove(all_panels, panel);
+    name = g_strdup(p->name);
+    gtk_widget_destroy(GTK_WIDGET(panel));
+    panel = panel_new(file, name);
+    if (panel != NULL)
+        all_panels = g_slist_prepend(all_panels, panel);
+    g_debug("panel '%s' recreated in %" G_GINT64_FORMAT " us", name,
+            g_get_monotonic_time() - start);
+    g_free(name);
+}
+
+
 GtkOrientation panel_get_orientation(LXPanel *panel)
 {
     return panel->priv->orientation;
@@ -2094,7 +2418,11 @@ gboolean _class_is_present(const LXPanelPluginInit *init)
             continue;
         plugins = gtk_container_get_children(GTK_CONTAINER(panel->priv->box));
         for (p = plugins; p; p = p->next)
-            if (PLUGIN_CLASS(p->data) == init)
+            /* placeholder of deferred plugin is found by type name */
+            if (PLUGIN_CLASS(p->data) == init ||
+                (_lxpanel_is_placeholder(p->data) &&
+                 g_hash_table_lookup(lxpanel_get_all_types(),
+                                     gtk_widget_get_name(p->data)) == init))
             {
                 g_list_free(plugins);
                 return TRUE;
@@ -591,6 +591,47 @@ GtkWidget *lxpanel_add_plugin(LXPanel *p, const char *name, config_setting_t *cf
     return widget;
 }
 
+/* Placeholders hold slots of plugins which aren't constructed yet. They have
+   no callbacks so code which walks panel children can safely skip them. */
+static LXPanelPluginInit _placeholder_init = {
+    .name = N_("Loading...")
+};
+
+GtkWidget *_lxpanel_add_placeholder(LXPanel *p, const char *name, config_setting_t *cfg)
+{
+    const LXPanelPluginInit *init;
+    GtkWidget *widget;
+    config_setting_t *s;
+    gint expand = 0, padding = 0;
+
+    /* don't load modules here, only built-in types are known yet */
+    init = _find_plugin(name);
+    if (init != NULL && !init->expand_available)
+        expand = 0;
+    else if ((s = config_setting_get_member(cfg, "expand")))
+        expand = config_setting_get_int(s);
+    else if (init != NULL)
+        expand = init->expand_default;
+    s = config_setting_get_member(cfg, "padding");
+    if (s)
+        padding = config_setting_get_int(s);
+    widget = gtk_event_box_new();
+    gtk_event_box_set_visible_window(GTK_EVENT_BOX(widget), FALSE);
+    gtk_widget_set_name(widget, name);
+    gtk_box_pack_start(GTK_BOX(p->priv->box), widget, expand, TRUE, padding);
+    gtk_widget_show(widget);
+    g_object_set_qdata(G_OBJECT(widget), lxpanel_plugin_qconf, cfg);
+    g_object_set_qdata(G_OBJECT(widget), lxpanel_plugin_qinit, &_placeholder_init);
+    g_object_set_qdata_full(G_OBJECT(widget), lxpanel_plugin_qsize,
+                            g_new0(GdkRectangle, 1), g_free);
+    return widget;
+}
+
+gboolean _lxpanel_is_placeholder(GtkWidget *plugin)
+{
+    return (PLUGIN_CLASS(plugin) == &_placeholder_init);
+}
+
 /* transfer none - note that not all fields are valid there */
 GHashTable *lxpanel_get_all_types(void)
 {
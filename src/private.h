@@ -170,6 +170,10 @@ struct _Panel {
     GtkWidget * move_plugin;            /* widgets involved in movement */
     PanelPluginMoveData move_before;
     PanelPluginMoveData move_after;
+
+    GList * deferred_plugins;           /* placeholders to construct */
+    guint deferred_idle;
+    guint config_save_queued;           /* lxpanel_config_save() timeout */
 };
 
 typedef struct {
@@ -234,6 +238,8 @@ void lxpanel_unload_modules(void);
 
 GHashTable *lxpanel_get_all_types(void); /* transfer none */
 void _lxpanel_remove_plugin(LXPanel *p, GtkWidget *plugin); /* no destroy dialog */
+GtkWidget *_lxpanel_add_placeholder(LXPanel *p, const char *name, config_setting_t *cfg);
+gboolean _lxpanel_is_placeholder(GtkWidget *plugin);
 
 extern GQuark lxpanel_plugin_qinit; /* access to LXPanelPluginInit data */
 #define PLUGIN_CLASS(_i) ((LXPanelPluginInit*)g_object_get_qdata(G_OBJECT(_i),lxpanel_plugin_qinit))
@@ -256,8 +262,20 @@ void _panel_set_panel_configuration_changed(LXPanel *p);
 void _panel_queue_update_background(LXPanel *p);
 void _panel_emit_icon_size_changed(LXPanel *p);
 void _panel_emit_font_changed(LXPanel *p);
+void _panel_resume_deferred(LXPanel *p);
+
+void _lxpanel_tick_panel_visibility_changed(void);
+
+/* startup mode, set from command line */
+extern gboolean deferred_start;
+void _lxpanel_startup_trace_open(const char *file);
+void _lxpanel_startup_trace_close(void);
+
+/* applies changes in config file to the running panel */
+void _lxpanel_reload(LXPanel *panel, const char *file);
 
 void panel_configure(LXPanel* p, int sel_page);
+void panel_config_save(Panel *p); /* saves now if changed */
 gboolean panel_edge_available(Panel* p, int edge, gint monitor);
 gboolean _panel_edge_can_strut(LXPanel *panel, int edge, gint monitor, gulong *size);
 void restart(void);
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#endif
+
+#include "sysfs.h"
+
+struct _LXPanelSysfsAttr
+{
+    char *path;
+    int fd;                     /* kept open between reads */
+    gboolean missing;           /* open() failed with ENOENT */
+    char buf[128];              /* contents of last read */
+};
+
+typedef struct {
+    guint id;
+    char *subsystem;
+    LXPanelSysfsUeventFunc func;    /* NULL if removed while dispatching */
+    gpointer user_data;
+} SysfsUeventWatch;
+
+static GList *uevent_watches = NULL;
+static guint uevent_last_id = 0;
+static guint uevent_source = 0;
+static int uevent_fd = -1;
+static gboolean uevent_dispatching = FALSE;
+
+LXPanelSysfsAttr *lxpanel_sysfs_attr_new(const char *dir, const char *name)
+{
+    LXPanelSysfsAttr *attr;
+
+    g_return_val_if_fail(name != NULL, NULL);
+
+    attr = g_slice_new(LXPanelSysfsAttr);
+    attr->path = dir ? g_build_filename(dir, name, NULL) : g_strdup(name);
+    attr->fd = -1;
+    attr->missing = FALSE;
+    attr->buf[0] = '\0';
+    return attr;
+}
+
+void lxpanel_sysfs_attr_free(LXPanelSysfsAttr *attr)
+{
+    if (attr == NULL)
+        return;
+    if (attr->fd >= 0)
+        close(attr->fd);
+    g_free(attr->path);
+    g_slice_free(LXPanelSysfsAttr, attr);
+}
+
+const char *lxpanel_sysfs_attr_read(LXPanelSysfsAttr *attr)
+{
+    ssize_t len;
+
+    g_return_val_if_fail(attr != NULL, NULL);
+
+    if (attr->missing)
+    {
+        errno = ENOENT;
+        return NULL;
+    }
+    if (attr->fd < 0)
+    {
+        attr->fd = open(attr->path, O_RDONLY | O_CLOEXEC);
+        if (attr->fd < 0)
+        {
+            if (errno == ENOENT)
+                attr->missing = TRUE;
+            return NULL;
+        }
+    }
+    /* sysfs regenerates contents on each read at offset 0 */
+    while ((len = pread(attr->fd, attr->buf, sizeof(attr->buf) - 1, 0)) < 0)
+    {
+        if (errno == EINTR)
+            continue;
+        if (errno == ENODEV)
+        {
+            /* device is gone, file is dead now even if it comes back */
+            close(attr->fd);
+            attr->fd = -1;
+            errno = ENODEV;
+        }
+        return NULL;
+    }
+    while (len > 0 && g_ascii_isspace(attr->buf[len - 1]))
+        len--;
+    attr->buf[len] = '\0';
+    return attr->buf;
+}
+
+gboolean lxpanel_sysfs_attr_read_int(LXPanelSysfsAttr *attr, gint64 *value)
+{
+    const char *str = lxpanel_sysfs_attr_read(attr);
+    char *end;
+    gint64 v;
+
+    if (str == NULL || *str == '\0')
+        return FALSE;
+    v = g_ascii_strtoll(str, &end, 10);
+    if (end == str)
+        return FALSE;
+    *value = v;
+    return TRUE;
+}
+
+static void sysfs_uevent_close(void)
+{
+    if (uevent_source != 0)
+        g_source_remove(uevent_source);
+    uevent_source = 0;
+    if (uevent_fd >= 0)
+        close(uevent_fd);
+    uevent_fd = -1;
+}
+
+static void sysfs_uevent_dispatch(const char *action, const char *devpath,
+                                  const char *subsystem)
+{
+    GList *l;
+
+    for (l = uevent_watches; l; l = l->next)
+    {
+        SysfsUeventWatch *w = l->data;
+        if (w->func != NULL &&
+            (subsystem == NULL || strcmp(w->subsystem, subsystem) == 0))
+            w->func(action, devpath, w->user_data);
+    }
+}
+
+#ifdef __linux__
+static gboolean sysfs_uevent_event(GIOChannel *source, GIOCondition cond,
+                                   gpointer unused)
+{
+    /* kernel never sends more than UEVENT_BUFFER_SIZE (2048) bytes */
+    char buf[4096];
+    struct sockaddr_nl addr;
+    struct iovec iov = { buf, sizeof(buf) - 1 };
+    struct msghdr msg;
+    const char *action, *devpath, *subsystem, *p, *end;
+    GList *l, *next;
+    ssize_t len;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+
+    uevent_dispatching = TRUE;
+    for (;;)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &addr;
+        msg.msg_namelen = sizeof(addr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        len = recvmsg(uevent_fd, &msg, MSG_DONTWAIT);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS)
+            {
+                /* socket buffer overflowed, state of devices is unknown */
+                sysfs_uevent_dispatch(NULL, NULL, NULL);
+                continue;
+            }
+            break;
+        }
+        /* accept only messages sent by kernel */
+        if (len == 0 || addr.nl_pid != 0)
+            continue;
+        buf[len] = '\0';
+        /* "action@devpath" header followed by KEY=value strings */
+        action = devpath = subsystem = NULL;
+        end = buf + len;
+        for (p = buf + strlen(buf) + 1; p < end; p += strlen(p) + 1)
+        {
+            if (strncmp(p, "ACTION=", 7) == 0)
+                action = p + 7;
+            else if (strncmp(p, "DEVPATH=", 8) == 0)
+                devpath = p + 8;
+            else if (strncmp(p, "SUBSYSTEM=", 10) == 0)
+                subsystem = p + 10;
+        }
+        if (action && devpath && subsystem)
+            sysfs_uevent_dispatch(action, devpath, subsystem);
+    }
+    uevent_dispatching = FALSE;
+
+    /* Free watches removed by callbacks. */
+    for (l = uevent_watches; l; l = next)
+    {
+        SysfsUeventWatch *w = l->data;
+        next = l->next;
+        if (w->func == NULL)
+        {
+            uevent_watches = g_list_delete_link(uevent_watches, l);
+            g_free(w->subsystem);
+            g_slice_free(SysfsUeventWatch, w);
+        }
+    }
+    if (uevent_watches == NULL || (cond & (G_IO_ERR | G_IO_HUP)))
+    {
+        if (uevent_watches != NULL)
+            g_warning("sysfs: uevent socket was closed");
+        sysfs_uevent_close();
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+guint lxpanel_sysfs_watch_uevents(const char *subsystem,
+                                  LXPanelSysfsUeventFunc func,
+                                  gpointer user_data)
+{
+#ifdef __linux__
+    SysfsUeventWatch *w;
+
+    g_return_val_if_fail(subsystem != NULL && func != NULL, 0);
+
+    if (uevent_fd < 0)
+    {
+        struct sockaddr_nl addr;
+        GIOChannel *channel;
+
+        uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+                           NETLINK_KOBJECT_UEVENT);
+        if (uevent_fd < 0)
+            return 0;
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = 1; /* kernel events, not ones sent by udev */
+        if (bind(uevent_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            g_warning("sysfs: could not bind uevent socket: %s",
+                      g_strerror(errno));
+            sysfs_uevent_close();
+            return 0;
+        }
+        channel = g_io_channel_unix_new(uevent_fd);
+        uevent_source = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                       sysfs_uevent_event, NULL);
+        g_io_channel_unref(channel);
+    }
+    w = g_slice_new(SysfsUeventWatch);
+    w->id = ++uevent_last_id;
+    w->subsystem = g_strdup(subsystem);
+    w->func = func;
+    w->user_data = user_data;
+    uevent_watches = g_list_append(uevent_watches, w);
+    return w->id;
+#else
+    return 0;
+#endif
+}
+
+void lxpanel_sysfs_unwatch_uevents(guint id)
+{
+    GList *l;
+
+    for (l = uevent_watches; l; l = l->next)
+    {
+        SysfsUeventWatch *w = l->data;
+        if (w->id == id && w->func != NULL)
+        {
+            if (uevent_dispatching)
+                /* it will be freed after dispatching */
+                w->func = NULL;
+            else
+            {
+                uevent_watches = g_list_delete_link(uevent_watches, l);
+                g_free(w->subsystem);
+                g_slice_free(SysfsUeventWatch, w);
+                if (uevent_watches == NULL)
+                    sysfs_uevent_close();
+            }
+            return;
+        }
+    }
+}
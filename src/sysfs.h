@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __SYSFS_H__
+#define __SYSFS_H__ 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * LXPanelSysfsAttr:
+ *
+ * A sysfs attribute file which is kept open and read again with pread()
+ * each time, so periodic reads don't open, allocate, or close anything.
+ */
+typedef struct _LXPanelSysfsAttr LXPanelSysfsAttr;
+
+/**
+ * lxpanel_sysfs_attr_new
+ * @dir: (allow-none): directory of attribute
+ * @name: attribute file name, or full path if @dir is %NULL
+ *
+ * Creates a reader for the attribute. The file is opened on the first
+ * read. If it doesn't exist then it isn't tried again.
+ *
+ * Returns: (transfer full): a new reader.
+ *
+ * Since: 0.9.3
+ */
+extern LXPanelSysfsAttr *lxpanel_sysfs_attr_new(const char *dir, const char *name);
+
+/**
+ * lxpanel_sysfs_attr_free
+ * @attr: (allow-none): a reader
+ *
+ * Closes the file and frees the reader.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_sysfs_attr_free(LXPanelSysfsAttr *attr);
+
+/**
+ * lxpanel_sysfs_attr_read
+ * @attr: a reader
+ *
+ * Reads the attribute. Trailing whitespace is stripped. Values longer than
+ * 127 bytes are truncated. If the device was removed then %NULL is
+ * returned with errno set to %ENODEV and the file is opened again on the
+ * next read, so the same device can be found again if it comes back.
+ *
+ * Returns: (transfer none): contents of the attribute, valid until the
+ * next read, or %NULL on error.
+ *
+ * Since: 0.9.3
+ */
+extern const char *lxpanel_sysfs_attr_read(LXPanelSysfsAttr *attr);
+
+/**
+ * lxpanel_sysfs_attr_read_int
+ * @attr: a reader
+ * @value: (out): location to store the value
+ *
+ * Reads the attribute as a decimal integer.
+ *
+ * Returns: %TRUE if @value was read.
+ *
+ * Since: 0.9.3
+ */
+extern gboolean lxpanel_sysfs_attr_read_int(LXPanelSysfsAttr *attr, gint64 *value);
+
+/**
+ * LXPanelSysfsUeventFunc
+ * @action: what happened, e.g. "add", "remove", or "change"
+ * @devpath: path of device in sysfs, without "/sys"
+ * @user_data: data passed to lxpanel_sysfs_watch_uevents()
+ *
+ * Receives a kernel uevent. If @action is %NULL then some events were lost
+ * and receiver should check state of all devices it needs.
+ */
+typedef void (*LXPanelSysfsUeventFunc)(const char *action, const char *devpath,
+                                       gpointer user_data);
+
+/**
+ * lxpanel_sysfs_watch_uevents
+ * @subsystem: subsystem of devices, e.g. "power_supply"
+ * @func: function to call on each event
+ * @user_data: data to pass to @func
+ *
+ * Adds a receiver for kernel uevents of devices in @subsystem, so receiver
+ * doesn't need to poll devices to find out they are changed. The events
+ * are received from NETLINK_KOBJECT_UEVENT socket, no udev is required.
+ *
+ * Returns: watch id or 0 if uevents aren't supported by the system.
+ *
+ * Since: 0.9.3
+ */
+extern guint lxpanel_sysfs_watch_uevents(const char *subsystem,
+                                         LXPanelSysfsUeventFunc func,
+                                         gpointer user_data);
+
+/**
+ * lxpanel_sysfs_unwatch_uevents
+ * @id: watch id
+ *
+ * Removes the watch added by lxpanel_sysfs_watch_uevents(). It is safe to
+ * call this from the watch callback.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_sysfs_unwatch_uevents(guint id);
+
+G_END_DECLS
+
+#endif
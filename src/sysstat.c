@@ -0,0 +1,836 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+
+#include "sysstat.h"
+#include "ticker.h"
+
+//#define DEBUG
+#include "dbg.h"
+
+/* Samples read within this time are given to subscribers again, so the
+ * ones which are due in the same wakeup share the sample, us */
+#define SYSSTAT_FRESH_TIME (LXPANEL_TICK_SLOT * 1000 / 2)
+
+typedef struct {
+    guint id;
+    LXPanelSysStatFlags what;   /* statistics the subscriber needs */
+    guint tick;                 /* update in shared scheduler */
+    LXPanelSysStatFunc func;
+    gpointer user_data;
+} SysStatSubscriber;
+
+typedef struct {
+    guint id;
+    LXPanelSysStatLinkFunc func;    /* NULL if removed while dispatching */
+    gpointer user_data;
+} SysStatLinkWatch;
+
+typedef struct {
+    const char *path;
+    int fd;                     /* kept open between reads */
+    char *buf;                  /* persistent buffer for contents */
+    gsize size;
+    gboolean failed;            /* to not flood log with warnings */
+} SysStatFile;
+
+typedef struct {
+    char *data;
+    gsize size;
+} SysStatNlBuffer;
+
+static GList *subscribers = NULL;
+static guint last_id = 0;
+static LXPanelSysStatFlags fresh = 0;   /* statistics read at fresh_time */
+static gint64 fresh_time = 0;
+static gboolean dispatching = FALSE;
+
+static SysStatFile proc_stat = { "/proc/stat", -1, NULL, 0, FALSE };
+static SysStatFile proc_meminfo = { "/proc/meminfo", -1, NULL, 0, FALSE };
+static SysStatFile proc_net_dev = { "/proc/net/dev", -1, NULL, 0, FALSE };
+
+static LXPanelSysStat sample;
+static LXPanelCpuTicks *cores = NULL;   /* per-core counters for sample */
+static guint cores_alloc = 0;
+static LXPanelIfaceStat *ifaces = NULL; /* interfaces for sample */
+static guint ifaces_alloc = 0;
+static int ioctl_fd = -1;               /* for /proc/net/dev fallback */
+
+#ifdef __linux__
+static int nl_fd = -1;                  /* rtnetlink socket for dumps */
+static guint32 nl_seq = 0;
+static gboolean nl_failed = FALSE;      /* use /proc/net/dev then */
+static SysStatNlBuffer nl_buf = { NULL, 0 };
+#endif
+
+static GList *link_watches = NULL;
+static guint link_source = 0;
+static int link_fd = -1;                /* rtnetlink socket for link and address groups */
+static gboolean link_dispatching = FALSE;
+#ifdef __linux__
+/* Link watchers may request a dump, so events need a buffer of their own */
+static SysStatNlBuffer link_buf = { NULL, 0 };
+#endif
+
+/* Reads the whole file into its buffer using pread() at offset 0 on the same
+ * descriptor each time, so there is no open() or stdio overhead. Returns
+ * length of data or -1 on error. The data are always terminated by NUL. */
+static gssize sysstat_file_read(SysStatFile *file)
+{
+    gssize len;
+
+    if (file->fd < 0)
+    {
+        file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+        if (file->fd < 0)
+        {
+            if (!file->failed)
+                g_warning("sysstat: could not open %s: %s", file->path,
+                          g_strerror(errno));
+            file->failed = TRUE;
+            return -1;
+        }
+    }
+    if (file->buf == NULL)
+    {
+        file->size = 4096;
+        file->buf = g_malloc(file->size);
+    }
+    while ((len = pread(file->fd, file->buf, file->size - 1, 0)) == (gssize)file->size - 1)
+    {
+        /* buffer is too small for the whole file, retry with a larger one */
+        file->size *= 2;
+        file->buf = g_realloc(file->buf, file->size);
+    }
+    if (len < 0)
+    {
+        if (!file->failed)
+            g_warning("sysstat: could not read %s: %s", file->path,
+                      g_strerror(errno));
+        file->failed = TRUE;
+        return -1;
+    }
+    file->buf[len] = '\0';
+    return len;
+}
+
+static void sysstat_file_close(SysStatFile *file)
+{
+    if (file->fd >= 0)
+        close(file->fd);
+    file->fd = -1;
+    g_free(file->buf);
+    file->buf = NULL;
+    file->size = 0;
+}
+
+/* Parses decimal number after optional spaces, returns pointer after it or
+ * NULL if there is no number */
+static inline const char *sysstat_parse_u64(const char *p, guint64 *value)
+{
+    guint64 v = 0;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p < '0' || *p > '9')
+        return NULL;
+    while (*p >= '0' && *p <= '9')
+        v = v * 10 + (guint)(*p++ - '0');
+    *value = v;
+    return p;
+}
+
+/* Parses "cpu  user nice system idle iowait irq softirq steal ..." line.
+ * Kernels before 2.6.11 have less fields, they are left zero then. */
+static gboolean sysstat_parse_cpu(const char *p, LXPanelCpuTicks *cpu)
+{
+    guint64 *fields = &cpu->user;
+    guint i;
+
+    memset(cpu, 0, sizeof(LXPanelCpuTicks));
+    for (i = 0; i < sizeof(LXPanelCpuTicks) / sizeof(guint64); i++)
+    {
+        p = sysstat_parse_u64(p, &fields[i]);
+        if (p == NULL)
+            break;
+    }
+    return (i >= 4);
+}
+
+/* Parses /proc/stat right in the file buffer. Memory is allocated only when
+ * a core with greater number than ever before appears. */
+static void sysstat_read_cpu(gboolean need_cores)
+{
+    const char *p;
+    guint64 n;
+
+    if (sysstat_file_read(&proc_stat) < 0)
+        return;
+    /* summary line is always the first one */
+    p = proc_stat.buf;
+    if (strncmp(p, "cpu ", 4) == 0 && sysstat_parse_cpu(p + 4, &sample.cpu))
+        sample.valid |= LXPANEL_SYSSTAT_CPU;
+    if (!need_cores)
+        return;
+
+    /* "cpuN ..." lines follow it */
+    while ((p = strchr(p, '\n')) != NULL && strncmp(++p, "cpu", 3) == 0)
+    {
+        const char *fields = sysstat_parse_u64(p + 3, &n);
+        if (fields == NULL || n >= G_MAXUINT16)
+            continue;
+        if (n >= cores_alloc)
+        {
+            guint old_alloc = cores_alloc;
+            cores_alloc = MAX(n + 1, cores_alloc * 2);
+            cores = g_renew(LXPanelCpuTicks, cores, cores_alloc);
+            memset(&cores[old_alloc], 0,
+                   (cores_alloc - old_alloc) * sizeof(LXPanelCpuTicks));
+        }
+        if (sysstat_parse_cpu(fields, &cores[n]) && n >= sample.n_cores)
+            sample.n_cores = n + 1;
+    }
+    sample.cores = cores;
+    if (sample.n_cores > 0)
+        sample.valid |= LXPANEL_SYSSTAT_CPU_CORES;
+}
+
+static void sysstat_read_mem(void)
+{
+    static const struct {
+        const char *name;
+        gsize len;
+        gsize offset;
+    } keys[] = {
+        { "MemTotal:", 9, G_STRUCT_OFFSET(LXPanelSysStat, mem_total) },
+        { "MemFree:", 8, G_STRUCT_OFFSET(LXPanelSysStat, mem_free) },
+        { "Buffers:", 8, G_STRUCT_OFFSET(LXPanelSysStat, mem_buffers) },
+        { "Cached:", 7, G_STRUCT_OFFSET(LXPanelSysStat, mem_cached) }
+    };
+    const guint all_keys = (1 << G_N_ELEMENTS(keys)) - 1;
+    const char *p;
+    guint readmask = 0, i;
+
+    if (sysstat_file_read(&proc_meminfo) < 0)
+        return;
+    for (p = proc_meminfo.buf; *p && readmask != all_keys; p++)
+    {
+        for (i = 0; i < G_N_ELEMENTS(keys); i++)
+        {
+            if (strncmp(p, keys[i].name, keys[i].len) == 0)
+            {
+                p = sysstat_parse_u64(p + keys[i].len,
+                                      G_STRUCT_MEMBER_P(&sample, keys[i].offset));
+                if (p != NULL)
+                    readmask |= (1 << i);
+                break;
+            }
+        }
+        /* skip to the end of line */
+        if (p != NULL)
+            p = strchr(p, '\n');
+        if (p == NULL)
+            break;
+    }
+    if (readmask == all_keys)
+        sample.valid |= LXPANEL_SYSSTAT_MEM;
+    else if (!proc_meminfo.failed)
+    {
+        g_warning("sysstat: couldn't read all values from /proc/meminfo: "
+                  "readmask %x", readmask);
+        proc_meminfo.failed = TRUE;
+    }
+}
+
+/* Returns place for the next interface in the sample. */
+static LXPanelIfaceStat *sysstat_iface_next(void)
+{
+    if (sample.n_ifaces >= ifaces_alloc)
+    {
+        ifaces_alloc = MAX(16, ifaces_alloc * 2);
+        ifaces = g_renew(LXPanelIfaceStat, ifaces, ifaces_alloc);
+    }
+    return &ifaces[sample.n_ifaces];
+}
+
+#ifdef __linux__
+/* Receives one datagram from netlink socket into buf, growing it if the
+ * datagram doesn't fit. Returns length or -1 on error. */
+static int sysstat_nl_recv(int fd, SysStatNlBuffer *buf, int flags)
+{
+    gssize len;
+
+    len = recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC | flags);
+    if (len < 0)
+        return -1;
+    if ((gsize)len > buf->size || buf->data == NULL)
+    {
+        buf->size = MAX((gsize)len, 16384);
+        buf->data = g_realloc(buf->data, buf->size);
+    }
+    return recv(fd, buf->data, buf->size, flags);
+}
+
+static void sysstat_nl_free(SysStatNlBuffer *buf)
+{
+    g_free(buf->data);
+    buf->data = NULL;
+    buf->size = 0;
+}
+
+/* Parses RTM_NEWLINK or RTM_DELLINK message. */
+static gboolean sysstat_parse_link(struct nlmsghdr *nh, LXPanelIfaceStat *ifs)
+{
+    struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    struct rtattr *rta;
+    int len;
+    gboolean has_stats64 = FALSE;
+
+    if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg)))
+        return FALSE;
+    memset(ifs, 0, sizeof(LXPanelIfaceStat));
+    ifs->index = ifi->ifi_index;
+    ifs->flags = ifi->ifi_flags;
+    ifs->type = ifi->ifi_type;
+    len = IFLA_PAYLOAD(nh);
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        switch (rta->rta_type)
+        {
+        case IFLA_IFNAME:
+            g_strlcpy(ifs->name, RTA_DATA(rta),
+                      MIN(sizeof(ifs->name), RTA_PAYLOAD(rta)));
+            break;
+        case IFLA_ADDRESS:
+            ifs->hwaddr_len = MIN(sizeof(ifs->hwaddr), RTA_PAYLOAD(rta));
+            memcpy(ifs->hwaddr, RTA_DATA(rta), ifs->hwaddr_len);
+            break;
+        case IFLA_STATS64:
+            if (RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64))
+            {
+                struct rtnl_link_stats64 st;
+                /* attribute data are only 4-byte aligned */
+                memcpy(&st, RTA_DATA(rta), sizeof(st));
+                ifs->rx_packets = st.rx_packets;
+                ifs->tx_packets = st.tx_packets;
+                ifs->rx_bytes = st.rx_bytes;
+                ifs->tx_bytes = st.tx_bytes;
+                has_stats64 = TRUE;
+            }
+            break;
+        case IFLA_STATS:
+            /* 32-bit counters, used only if there are no 64-bit ones */
+            if (!has_stats64 && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats))
+            {
+                struct rtnl_link_stats *st = RTA_DATA(rta);
+                ifs->rx_packets = st->rx_packets;
+                ifs->tx_packets = st->tx_packets;
+                ifs->rx_bytes = st->rx_bytes;
+                ifs->tx_bytes = st->tx_bytes;
+            }
+            break;
+        }
+    }
+    return (ifs->name[0] != '\0');
+}
+
+/* Reads all interfaces with a single RTM_GETLINK dump. */
+static gboolean sysstat_read_net_netlink(void)
+{
+    struct {
+        struct nlmsghdr nh;
+        struct ifinfomsg ifi;
+    } req;
+    struct nlmsghdr *nh;
+    int len;
+
+    if (nl_fd < 0)
+    {
+        nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (nl_fd < 0)
+            return FALSE;
+    }
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nh.nlmsg_type = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++nl_seq;
+    req.ifi.ifi_family = AF_UNSPEC;
+    if (send(nl_fd, &req, req.nh.nlmsg_len, 0) < 0)
+        return FALSE;
+
+    sample.n_ifaces = 0;
+    for (;;)
+    {
+        len = sysstat_nl_recv(nl_fd, &nl_buf, 0);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        for (nh = (struct nlmsghdr *)nl_buf.data; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+        {
+            /* skip remains of previous dump if it failed */
+            if (nh->nlmsg_seq != nl_seq)
+                continue;
+            if (nh->nlmsg_type == NLMSG_DONE)
+                return TRUE;
+            if (nh->nlmsg_type == NLMSG_ERROR)
+            {
+                struct nlmsgerr *err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return FALSE;
+            }
+            if (nh->nlmsg_type == RTM_NEWLINK &&
+                sysstat_parse_link(nh, sysstat_iface_next()))
+                sample.n_ifaces++;
+        }
+    }
+}
+#endif
+
+/* Retrieves flags and hardware type and address which /proc/net/dev lacks. */
+static void sysstat_iface_ioctls(LXPanelIfaceStat *ifs)
+{
+    struct ifreq ifr;
+
+    if (ioctl_fd < 0)
+        ioctl_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (ioctl_fd < 0)
+        return;
+    memset(&ifr, 0, sizeof(ifr));
+    g_strlcpy(ifr.ifr_name, ifs->name, sizeof(ifr.ifr_name));
+    if (ioctl(ioctl_fd, SIOCGIFFLAGS, &ifr) == 0)
+        ifs->flags = (unsigned short)ifr.ifr_flags;
+#ifdef SIOCGIFHWADDR
+    if (ioctl(ioctl_fd, SIOCGIFHWADDR, &ifr) == 0)
+    {
+        ifs->type = ifr.ifr_hwaddr.sa_family;
+        ifs->hwaddr_len = 6;
+        memcpy(ifs->hwaddr, ifr.ifr_hwaddr.sa_data, 6);
+    }
+#endif
+}
+
+/* Parses /proc/net/dev: two header lines and then for each interface
+ * "name: rx_bytes rx_packets errs drop fifo frame compressed multicast
+ * tx_bytes tx_packets ..." */
+static gboolean sysstat_read_net_proc(void)
+{
+    const char *p, *name, *colon;
+    guint64 value;
+    guint i;
+
+    if (sysstat_file_read(&proc_net_dev) < 0)
+        return FALSE;
+    sample.n_ifaces = 0;
+    p = strchr(proc_net_dev.buf, '\n');
+    if (p != NULL)
+        p = strchr(p + 1, '\n');
+    while (p != NULL && *++p != '\0')
+    {
+        LXPanelIfaceStat *ifs = sysstat_iface_next();
+
+        for (name = p; *name == ' '; name++);
+        colon = strchr(name, ':');
+        if (colon == NULL)
+            break;
+        memset(ifs, 0, sizeof(LXPanelIfaceStat));
+        g_strlcpy(ifs->name, name, MIN(sizeof(ifs->name), (gsize)(colon - name + 1)));
+        for (i = 0, p = colon + 1; i < 10 && p != NULL; i++)
+        {
+            p = sysstat_parse_u64(p, &value);
+            switch (i)
+            {
+            case 0: ifs->rx_bytes = value; break;
+            case 1: ifs->rx_packets = value; break;
+            case 8: ifs->tx_bytes = value; break;
+            case 9: ifs->tx_packets = value; break;
+            }
+        }
+        if (p == NULL)
+        {
+            if (!proc_net_dev.failed)
+                g_warning("sysstat: could not parse /proc/net/dev");
+            proc_net_dev.failed = TRUE;
+            return FALSE;
+        }
+        sysstat_iface_ioctls(ifs);
+        sample.n_ifaces++;
+        p = strchr(p, '\n');
+    }
+    return TRUE;
+}
+
+static void sysstat_read_net(void)
+{
+    gboolean ok = FALSE;
+
+#ifdef __linux__
+    if (!nl_failed)
+    {
+        ok = sysstat_read_net_netlink();
+        if (!ok)
+        {
+            g_warning("sysstat: rtnetlink dump failed, using /proc/net/dev: %s",
+                      g_strerror(errno));
+            nl_failed = TRUE;
+            close(nl_fd);
+            nl_fd = -1;
+        }
+    }
+    if (nl_failed)
+#endif
+        ok = sysstat_read_net_proc();
+    sample.ifaces = ifaces;
+    if (ok)
+        sample.valid |= LXPANEL_SYSSTAT_NET;
+    else
+        sample.n_ifaces = 0;
+}
+
+static void sysstat_read(LXPanelSysStatFlags what)
+{
+    gint64 now = g_get_monotonic_time();
+
+    if (now - fresh_time > SYSSTAT_FRESH_TIME)
+    {
+        fresh = 0;
+        fresh_time = now;
+        sample.valid = 0;
+    }
+    /* per-core counters are read together with the summary ones */
+    if (what & LXPANEL_SYSSTAT_CPU_CORES)
+        what |= LXPANEL_SYSSTAT_CPU;
+    what &= ~fresh;
+    if (what == 0)
+        return;
+    fresh |= what;
+    sample.valid &= ~what;
+    if (what & (LXPANEL_SYSSTAT_CPU | LXPANEL_SYSSTAT_CPU_CORES))
+        sysstat_read_cpu(what & LXPANEL_SYSSTAT_CPU_CORES);
+    if (what & LXPANEL_SYSSTAT_MEM)
+        sysstat_read_mem();
+    if (what & LXPANEL_SYSSTAT_NET)
+        sysstat_read_net();
+}
+
+/* Releases everything when nobody needs data anymore */
+static void sysstat_close(void)
+{
+    sysstat_file_close(&proc_stat);
+    sysstat_file_close(&proc_meminfo);
+    sysstat_file_close(&proc_net_dev);
+    if (ioctl_fd >= 0)
+        close(ioctl_fd);
+    ioctl_fd = -1;
+#ifdef __linux__
+    if (nl_fd >= 0)
+        close(nl_fd);
+    nl_fd = -1;
+    sysstat_nl_free(&nl_buf);
+#endif
+    g_free(ifaces);
+    ifaces = NULL;
+    ifaces_alloc = 0;
+    sample.n_ifaces = 0;
+    sample.ifaces = NULL;
+    g_free(cores);
+    cores = NULL;
+    cores_alloc = 0;
+    sample.n_cores = 0;
+    sample.cores = NULL;
+    sample.valid = 0;
+    fresh = 0;
+}
+
+static gboolean sysstat_timeout(gpointer user_data)
+{
+    SysStatSubscriber *s = user_data;
+
+    sysstat_read(s->what);
+    dispatching = TRUE;
+    /* s may be freed by the call */
+    s->func(&sample, s->user_data);
+    dispatching = FALSE;
+    /* sample isn't used by the callback anymore */
+    if (subscribers == NULL)
+        sysstat_close();
+    return TRUE;
+}
+
+guint lxpanel_sysstat_subscribe(GtkWidget *plugin, LXPanelSysStatFlags what,
+                                guint interval, LXPanelSysStatFunc func,
+                                gpointer user_data)
+{
+    SysStatSubscriber *s;
+
+    g_return_val_if_fail(func != NULL && interval > 0, 0);
+
+    s = g_slice_new(SysStatSubscriber);
+    s->id = ++last_id;
+    s->what = what;
+    s->func = func;
+    s->user_data = user_data;
+    s->tick = lxpanel_tick_add(plugin, interval, sysstat_timeout, s);
+    subscribers = g_list_append(subscribers, s);
+    return s->id;
+}
+
+void lxpanel_sysstat_unsubscribe(guint id)
+{
+    GList *l;
+
+    for (l = subscribers; l; l = l->next)
+    {
+        SysStatSubscriber *s = l->data;
+        if (s->id == id)
+        {
+            /* it is safe to remove the tick while it is dispatched */
+            lxpanel_tick_remove(s->tick);
+            subscribers = g_list_delete_link(subscribers, l);
+            g_slice_free(SysStatSubscriber, s);
+            if (subscribers == NULL && !dispatching)
+                sysstat_close();
+            return;
+        }
+    }
+}
+
+const LXPanelSysStat *lxpanel_sysstat_read(LXPanelSysStatFlags what)
+{
+    /* the caller wants the current state, not the one of last wakeup */
+    fresh &= ~what;
+    sysstat_read(what);
+    return &sample;
+}
+
+const LXPanelIfaceStat *lxpanel_sysstat_find_iface(const LXPanelSysStat *stat,
+                                                   const char *name)
+{
+    guint i;
+
+    g_return_val_if_fail(stat != NULL && name != NULL, NULL);
+
+    if (!(stat->valid & LXPANEL_SYSSTAT_NET))
+        return NULL;
+    for (i = 0; i < stat->n_ifaces; i++)
+        if (strcmp(stat->ifaces[i].name, name) == 0)
+            return &stat->ifaces[i];
+    return NULL;
+}
+
+static void sysstat_link_close(void)
+{
+    if (link_source != 0)
+        g_source_remove(link_source);
+    link_source = 0;
+    if (link_fd >= 0)
+        close(link_fd);
+    link_fd = -1;
+#ifdef __linux__
+    sysstat_nl_free(&link_buf);
+#endif
+}
+
+static void sysstat_link_dispatch(const LXPanelIfaceStat *ifs,
+                                  LXPanelSysStatLinkEvent event)
+{
+    GList *l;
+
+    for (l = link_watches; l; l = l->next)
+    {
+        SysStatLinkWatch *w = l->data;
+        if (w->func != NULL)
+            w->func(ifs, event, w->user_data);
+    }
+}
+
+#ifdef __linux__
+/* Parses RTM_NEWADDR or RTM_DELADDR message, only interface is filled. */
+static gboolean sysstat_parse_addr(struct nlmsghdr *nh, LXPanelIfaceStat *ifs)
+{
+    struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+
+    if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa)))
+        return FALSE;
+    memset(ifs, 0, sizeof(*ifs));
+    ifs->index = ifa->ifa_index;
+    /* IFA_LABEL is IPv4 only and may be an alias, so ask the kernel */
+    return if_indextoname(ifa->ifa_index, ifs->name) != NULL;
+}
+
+static gboolean sysstat_link_event(GIOChannel *source, GIOCondition cond,
+                                   gpointer unused)
+{
+    struct nlmsghdr *nh;
+    LXPanelIfaceStat ifs;
+    GList *l, *next;
+    int len;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+
+    link_dispatching = TRUE;
+    while ((len = sysstat_nl_recv(link_fd, &link_buf, MSG_DONTWAIT)) != 0)
+    {
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS)
+            {
+                /* socket buffer overflowed, state of links is unknown */
+                sysstat_link_dispatch(NULL, LXPANEL_SYSSTAT_LINK_LOST);
+                continue;
+            }
+            break;
+        }
+        for (nh = (struct nlmsghdr *)link_buf.data; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+        {
+            if ((nh->nlmsg_type == RTM_NEWLINK || nh->nlmsg_type == RTM_DELLINK) &&
+                sysstat_parse_link(nh, &ifs))
+                sysstat_link_dispatch(&ifs, nh->nlmsg_type == RTM_DELLINK ?
+                                            LXPANEL_SYSSTAT_LINK_REMOVED :
+                                            LXPANEL_SYSSTAT_LINK_CHANGED);
+            else if ((nh->nlmsg_type == RTM_NEWADDR || nh->nlmsg_type == RTM_DELADDR) &&
+                     sysstat_parse_addr(nh, &ifs))
+                sysstat_link_dispatch(&ifs, LXPANEL_SYSSTAT_LINK_ADDRESS);
+        }
+    }
+    link_dispatching = FALSE;
+
+    /* Free watches removed by callbacks. */
+    for (l = link_watches; l; l = next)
+    {
+        SysStatLinkWatch *w = l->data;
+        next = l->next;
+        if (w->func == NULL)
+        {
+            link_watches = g_list_delete_link(link_watches, l);
+            g_slice_free(SysStatLinkWatch, w);
+        }
+    }
+    if (link_watches != NULL && (cond & (G_IO_ERR | G_IO_HUP)))
+    {
+        /* tell watchers they get nothing more, they may watch again */
+        g_warning("sysstat: rtnetlink socket was closed");
+        l = link_watches;
+        link_watches = NULL;
+        sysstat_link_close();
+        for (next = l; next; next = next->next)
+        {
+            SysStatLinkWatch *w = next->data;
+            w->func(NULL, LXPANEL_SYSSTAT_LINK_CLOSED, w->user_data);
+            g_slice_free(SysStatLinkWatch, w);
+        }
+        g_list_free(l);
+        return FALSE;
+    }
+    if (link_watches == NULL)
+    {
+        sysstat_link_close();
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+guint lxpanel_sysstat_watch_links(LXPanelSysStatLinkFunc func, gpointer user_data)
+{
+#ifdef __linux__
+    SysStatLinkWatch *w;
+
+    g_return_val_if_fail(func != NULL, 0);
+
+    if (link_fd < 0)
+    {
+        struct sockaddr_nl addr;
+        GIOChannel *channel;
+
+        link_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (link_fd < 0)
+            return 0;
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+        if (bind(link_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            g_warning("sysstat: could not bind rtnetlink socket: %s",
+                      g_strerror(errno));
+            sysstat_link_close();
+            return 0;
+        }
+        channel = g_io_channel_unix_new(link_fd);
+        link_source = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                     sysstat_link_event, NULL);
+        g_io_channel_unref(channel);
+    }
+    w = g_slice_new(SysStatLinkWatch);
+    w->id = ++last_id;
+    w->func = func;
+    w->user_data = user_data;
+    link_watches = g_list_append(link_watches, w);
+    return w->id;
+#else
+    return 0;
+#endif
+}
+
+void lxpanel_sysstat_unwatch_links(guint id)
+{
+    GList *l;
+
+    for (l = link_watches; l; l = l->next)
+    {
+        SysStatLinkWatch *w = l->data;
+        if (w->id == id && w->func != NULL)
+        {
+            if (link_dispatching)
+                /* it will be freed after dispatching */
+                w->func = NULL;
+            else
+            {
+                link_watches = g_list_delete_link(link_watches, l);
+                g_slice_free(SysStatLinkWatch, w);
+                if (link_watches == NULL)
+                    sysstat_link_close();
+            }
+            return;
+        }
+    }
+}
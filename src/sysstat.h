@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __SYSSTAT_H__
+#define __SYSSTAT_H__ 1
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/**
+ * LXPanelSysStatFlags:
+ * @LXPANEL_SYSSTAT_CPU: CPU times from /proc/stat
+ * @LXPANEL_SYSSTAT_MEM: memory usage from /proc/meminfo
+ * @LXPANEL_SYSSTAT_CPU_CORES: CPU times for each core from /proc/stat
+ * @LXPANEL_SYSSTAT_NET: state and counters of network interfaces
+ *
+ * Sets of system statistics which can be requested.
+ */
+typedef enum {
+    LXPANEL_SYSSTAT_CPU = 1 << 0,
+    LXPANEL_SYSSTAT_MEM = 1 << 1,
+    LXPANEL_SYSSTAT_CPU_CORES = 1 << 2,
+    LXPANEL_SYSSTAT_NET = 1 << 3
+} LXPanelSysStatFlags;
+
+/**
+ * LXPanelCpuTicks:
+ *
+ * CPU time counters from /proc/stat, in USER_HZ units. Counters which are
+ * not supported by the running kernel are zero.
+ */
+typedef struct {
+    guint64 user, nice, system, idle, iowait, irq, softirq, steal;
+} LXPanelCpuTicks;
+
+/**
+ * LXPanelIfaceStat:
+ * @index: interface index, 0 if unknown
+ * @name: interface name
+ * @flags: IFF_* flags of interface
+ * @type: ARPHRD_* type of interface hardware
+ * @hwaddr: hardware address
+ * @hwaddr_len: length of @hwaddr, 0 if interface has no address
+ * @rx_packets: number of received packets
+ * @tx_packets: number of transmitted packets
+ * @rx_bytes: number of received bytes
+ * @tx_bytes: number of transmitted bytes
+ *
+ * State of a network interface. All interfaces are read at once using
+ * rtnetlink dump if it is available, otherwise from /proc/net/dev.
+ */
+typedef struct {
+    int index;
+    char name[16];
+    guint flags;
+    guint type;
+    guint8 hwaddr[32];
+    guint hwaddr_len;
+    guint64 rx_packets, tx_packets, rx_bytes, tx_bytes;
+} LXPanelIfaceStat;
+
+/**
+ * LXPanelSysStat:
+ * @valid: which of statistics below were successfully read
+ * @cpu: counters summed for all CPUs
+ * @n_cores: number of elements in @cores
+ * @cores: counters for each core, indexed by core number; cores which are
+ *      offline now have their counters unchanged
+ * @mem_total: MemTotal from /proc/meminfo, in kB
+ * @mem_free: MemFree from /proc/meminfo, in kB
+ * @mem_buffers: Buffers from /proc/meminfo, in kB
+ * @mem_cached: Cached from /proc/meminfo, in kB
+ * @n_ifaces: number of elements in @ifaces
+ * @ifaces: network interfaces
+ *
+ * A sample of system statistics.
+ */
+typedef struct {
+    LXPanelSysStatFlags valid;
+    LXPanelCpuTicks cpu;
+    guint n_cores;
+    const LXPanelCpuTicks *cores;
+    guint64 mem_total;
+    guint64 mem_free;
+    guint64 mem_buffers;
+    guint64 mem_cached;
+    guint n_ifaces;
+    const LXPanelIfaceStat *ifaces;
+} LXPanelSysStat;
+
+typedef void (*LXPanelSysStatFunc)(const LXPanelSysStat *stat, gpointer user_data);
+
+/**
+ * LXPanelSysStatLinkEvent:
+ * @LXPANEL_SYSSTAT_LINK_CHANGED: interface was added or its state changed
+ * @LXPANEL_SYSSTAT_LINK_REMOVED: interface was removed
+ * @LXPANEL_SYSSTAT_LINK_ADDRESS: address was added to or removed from the
+ *      interface, only index and name of interface are valid
+ * @LXPANEL_SYSSTAT_LINK_LOST: some notifications were lost
+ * @LXPANEL_SYSSTAT_LINK_CLOSED: notifications stopped because rtnetlink
+ *      socket was closed, the watch is removed
+ *
+ * Kinds of notifications received by #LXPanelSysStatLinkFunc.
+ */
+typedef enum {
+    LXPANEL_SYSSTAT_LINK_CHANGED,
+    LXPANEL_SYSSTAT_LINK_REMOVED,
+    LXPANEL_SYSSTAT_LINK_ADDRESS,
+    LXPANEL_SYSSTAT_LINK_LOST,
+    LXPANEL_SYSSTAT_LINK_CLOSED
+} LXPanelSysStatLinkEvent;
+
+/**
+ * LXPanelSysStatLinkFunc
+ * @iface: (allow-none): new state of the interface
+ * @event: what happened to the interface
+ * @user_data: data passed to lxpanel_sysstat_watch_links()
+ *
+ * Receives change of state of a network interface. If @event is
+ * %LXPANEL_SYSSTAT_LINK_LOST then @iface is %NULL and receiver should
+ * check state of all interfaces it needs. If @event is
+ * %LXPANEL_SYSSTAT_LINK_CLOSED then @iface is %NULL too, the watch id
+ * isn't valid anymore and receiver should poll interfaces instead.
+ */
+typedef void (*LXPanelSysStatLinkFunc)(const LXPanelIfaceStat *iface,
+                                       LXPanelSysStatLinkEvent event,
+                                       gpointer user_data);
+
+/**
+ * lxpanel_sysstat_subscribe
+ * @plugin: (allow-none): plugin which needs statistics
+ * @what: statistics which subscriber needs
+ * @interval: interval between samples, in milliseconds
+ * @func: function to call with each new sample
+ * @user_data: data to pass to @func
+ *
+ * Adds a subscriber to the system statistics sampler shared by all
+ * plugins. Files in /proc are kept open and read only when some of
+ * subscribers need new sample, and subscribers which are due in the same
+ * wakeup receive the same sample. The @func is called every @interval ms
+ * until lxpanel_sysstat_unsubscribe() is called. Each subscriber is an
+ * update of @plugin in the shared scheduler, see lxpanel_tick_add(), so
+ * @interval is rounded up to a multiple of %LXPANEL_TICK_SLOT, stretched
+ * while the panel of @plugin is hidden, and counted in its wakeups.
+ *
+ * Returns: subscription id.
+ *
+ * Since: 0.9.3
+ */
+extern guint lxpanel_sysstat_subscribe(GtkWidget *plugin, LXPanelSysStatFlags what,
+                                       guint interval, LXPanelSysStatFunc func,
+                                       gpointer user_data);
+
+/**
+ * lxpanel_sysstat_unsubscribe
+ * @id: subscription id
+ *
+ * Removes the subscription made by lxpanel_sysstat_subscribe(). It is
+ * safe to call this from the subscriber callback.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_sysstat_unsubscribe(guint id);
+
+/**
+ * lxpanel_sysstat_read
+ * @what: statistics which caller needs
+ *
+ * Reads statistics immediately, e.g. to show something at startup before
+ * subscriber receives the first sample. Returned data are shared with the
+ * sampler so they are valid only until control returns to main loop.
+ *
+ * Returns: (transfer none): a sample.
+ *
+ * Since: 0.9.3
+ */
+extern const LXPanelSysStat *lxpanel_sysstat_read(LXPanelSysStatFlags what);
+
+/**
+ * lxpanel_sysstat_find_iface
+ * @stat: a sample
+ * @name: interface name
+ *
+ * Searches for interface @name in the @stat.
+ *
+ * Returns: (transfer none): interface state or %NULL if @stat has none.
+ *
+ * Since: 0.9.3
+ */
+extern const LXPanelIfaceStat *lxpanel_sysstat_find_iface(const LXPanelSysStat *stat,
+                                                          const char *name);
+
+/**
+ * lxpanel_sysstat_watch_links
+ * @func: function to call on each change
+ * @user_data: data to pass to @func
+ *
+ * Adds a receiver for rtnetlink link notifications (interface was added,
+ * removed, went up or down, got or lost an address), so receiver doesn't
+ * need to poll interface flags.
+ *
+ * Returns: watch id or 0 if notifications aren't supported by the system.
+ *
+ * Since: 0.9.3
+ */
+extern guint lxpanel_sysstat_watch_links(LXPanelSysStatLinkFunc func, gpointer user_data);
+
+/**
+ * lxpanel_sysstat_unwatch_links
+ * @id: watch id
+ *
+ * Removes the watch added by lxpanel_sysstat_watch_links(). It is safe to
+ * call this from the watch callback.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_sysstat_unwatch_links(guint id);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gdk/gdkx.h>
+#ifdef HAVE_XSS
+#include <X11/extensions/scrnsaver.h>
+#endif
+
+#include "ticker.h"
+#include "private.h"
+
+//#define DEBUG
+#include "dbg.h"
+
+/* Intervals are multiplied by these while nobody can see the result */
+#define TICK_HIDDEN_STRETCH 4
+#define TICK_BLANKED_STRETCH 8
+
+typedef struct {
+    guint id;
+    GtkWidget *plugin;          /* owner, may be NULL */
+    guint interval;             /* requested interval, ms */
+    guint period;               /* interval after stretching, ms */
+    gint64 deadline;            /* monotonic time of next call, us */
+    GSourceFunc func;           /* NULL if removed while dispatching */
+    gpointer user_data;
+} PanelTick;
+
+static GList *ticks = NULL;
+static guint last_id = 0;
+static guint timer = 0;
+static gint64 deadline = G_MAXINT64;    /* when timer fires, us */
+static gboolean timer_seconds = FALSE;  /* timer may fire up to 1/4 s early */
+static gboolean dispatching = FALSE;
+static gboolean screen_blanked = FALSE;
+static GQuark wakeups_quark = 0;
+
+/* Rounds time up to the grid of the period: whole seconds if the period is
+ * a whole number of seconds, otherwise slots. Periods are multiples of the
+ * grid step so updates stay on the grid and the ones which are due at the
+ * same time share one wakeup. */
+static gint64 tick_align(gint64 time, guint period)
+{
+    gint64 step = (period % 1000 == 0) ? G_USEC_PER_SEC : LXPANEL_TICK_SLOT * 1000;
+
+    return (time + step - 1) / step * step;
+}
+
+static guint tick_stretched_interval(PanelTick *t)
+{
+    GtkWidget *panel;
+
+    if (screen_blanked)
+        return t->interval * TICK_BLANKED_STRETCH;
+    if (t->plugin != NULL)
+    {
+        panel = gtk_widget_get_toplevel(t->plugin);
+        if (LX_IS_PANEL(panel) && !LXPANEL(panel)->priv->visible)
+            return t->interval * TICK_HIDDEN_STRETCH;
+    }
+    return t->interval;
+}
+
+static gboolean tick_timeout(gpointer unused);
+
+/* Arms the timer for the earliest deadline. */
+static void tick_reschedule(void)
+{
+    GList *l;
+    gint64 next = G_MAXINT64, delay;
+    gboolean seconds = TRUE;
+
+    for (l = ticks; l; l = l->next)
+    {
+        PanelTick *t = l->data;
+        if (t->func == NULL)
+            continue;
+        next = MIN(next, t->deadline);
+        if (t->period % 1000 != 0)
+            seconds = FALSE;
+    }
+    if (next == deadline && seconds == timer_seconds)
+        return;
+    if (timer != 0)
+        g_source_remove(timer);
+    timer = 0;
+    deadline = next;
+    if (next == G_MAXINT64)
+        return;
+    delay = MAX(next - g_get_monotonic_time(), 0);
+    DBG("next tick in %" G_GINT64_FORMAT " us\n", delay);
+    /* If all deadlines are on whole seconds then there is no need to be
+     * exact, so wake up together with timers of other processes. */
+    timer_seconds = seconds;
+    if (seconds)
+        timer = g_timeout_add_seconds((delay + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC,
+                                      tick_timeout, NULL);
+    else
+        timer = g_timeout_add((delay + 999) / 1000, tick_timeout, NULL);
+}
+
+static gboolean tick_timeout(gpointer unused)
+{
+    GList *l, *next;
+    PanelTick *t;
+    gint64 now, due;
+    guint n, added = last_id;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+
+    /* the timer is one-shot, it is armed again for the next deadline */
+    timer = 0;
+    deadline = G_MAXINT64;
+    now = g_get_monotonic_time();
+    /* g_timeout_add_seconds() rounds expiration to the nearest second */
+    due = timer_seconds ? now + G_USEC_PER_SEC / 4 : now;
+    dispatching = TRUE;
+    for (l = ticks; l; l = l->next)
+    {
+        t = l->data;
+        /* skip ticks added by callbacks, they are due a period later */
+        if (t->func == NULL || t->id > added || t->deadline > due)
+            continue;
+        t->deadline += t->period * (gint64)1000;
+        if (t->deadline <= due) /* after suspend or a long stall */
+            t->deadline = tick_align(now + t->period * (gint64)1000, t->period);
+        if (t->plugin != NULL)
+        {
+            n = GPOINTER_TO_UINT(g_object_get_qdata(G_OBJECT(t->plugin), wakeups_quark));
+            g_object_set_qdata(G_OBJECT(t->plugin), wakeups_quark, GUINT_TO_POINTER(n + 1));
+        }
+        if (!t->func(t->user_data))
+            t->func = NULL;
+    }
+    dispatching = FALSE;
+
+    /* Free ticks removed by callbacks. */
+    for (l = ticks; l; l = next)
+    {
+        next = l->next;
+        t = l->data;
+        if (t->func == NULL)
+        {
+            ticks = g_list_delete_link(ticks, l);
+            g_slice_free(PanelTick, t);
+        }
+    }
+    tick_reschedule();
+    return FALSE;
+}
+
+/* Panel visibility or screen state was changed, update stretched periods. */
+static void tick_restretch(void)
+{
+    GList *l;
+    gint64 now = g_get_monotonic_time();
+
+    for (l = ticks; l; l = l->next)
+    {
+        PanelTick *t = l->data;
+        guint new_period = tick_stretched_interval(t);
+        gint64 last;
+
+        if (new_period == t->period)
+            continue;
+        /* move the deadline from the last call, after unhiding the update
+           should be shown soon */
+        last = t->deadline - t->period * (gint64)1000;
+        t->period = new_period;
+        t->deadline = tick_align(MAX(last + new_period * (gint64)1000, now), new_period);
+    }
+    if (!dispatching)
+        tick_reschedule();
+}
+
+void _lxpanel_tick_panel_visibility_changed(void)
+{
+    tick_restretch();
+}
+
+#ifdef HAVE_XSS
+static GdkFilterReturn tick_xss_filter(GdkXEvent *xevent, GdkEvent *event,
+                                       gpointer event_base)
+{
+    XEvent *ev = (XEvent *)xevent;
+
+    if (ev->type == GPOINTER_TO_INT(event_base) + ScreenSaverNotify)
+    {
+        gboolean blanked = (((XScreenSaverNotifyEvent *)ev)->state != ScreenSaverOff);
+
+        if (blanked != screen_blanked)
+        {
+            DBG("screen is %sblanked\n", blanked ? "" : "not ");
+            screen_blanked = blanked;
+            tick_restretch();
+        }
+    }
+    return GDK_FILTER_CONTINUE;
+}
+
+/* Subscribes for screen saver state changes on the first use. */
+static void tick_xss_init(void)
+{
+    static gboolean initialized = FALSE;
+    Display *xdisplay = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+    int event_base, error_base;
+
+    if (initialized)
+        return;
+    initialized = TRUE;
+    if (!XScreenSaverQueryExtension(xdisplay, &event_base, &error_base))
+        return;
+    XScreenSaverSelectInput(xdisplay, GDK_ROOT_WINDOW(), ScreenSaverNotifyMask);
+    gdk_window_add_filter(gdk_get_default_root_window(), tick_xss_filter,
+                          GINT_TO_POINTER(event_base));
+}
+#endif
+
+guint lxpanel_tick_add(GtkWidget *plugin, guint interval,
+                       GSourceFunc func, gpointer user_data)
+{
+    PanelTick *t;
+
+    g_return_val_if_fail(func != NULL && interval > 0, 0);
+
+    if (wakeups_quark == 0)
+        wakeups_quark = g_quark_from_static_string("LXPanel::tick-wakeups");
+#ifdef HAVE_XSS
+    tick_xss_init();
+#endif
+
+    t = g_slice_new(PanelTick);
+    t->id = ++last_id;
+    t->plugin = plugin;
+    t->interval = (interval + LXPANEL_TICK_SLOT - 1) / LXPANEL_TICK_SLOT * LXPANEL_TICK_SLOT;
+    t->period = tick_stretched_interval(t);
+    t->deadline = tick_align(g_get_monotonic_time() + t->period * (gint64)1000, t->period);
+    t->func = func;
+    t->user_data = user_data;
+    ticks = g_list_append(ticks, t);
+    if (!dispatching)
+        tick_reschedule();
+    return t->id;
+}
+
+void lxpanel_tick_remove(guint id)
+{
+    GList *l;
+
+    for (l = ticks; l; l = l->next)
+    {
+        PanelTick *t = l->data;
+        if (t->id == id && t->func != NULL)
+        {
+            if (dispatching)
+                /* it will be freed after dispatching */
+                t->func = NULL;
+            else
+            {
+                ticks = g_list_delete_link(ticks, l);
+                g_slice_free(PanelTick, t);
+                tick_reschedule();
+            }
+            return;
+        }
+    }
+}
+
+guint lxpanel_tick_get_wakeups(GtkWidget *plugin)
+{
+    g_return_val_if_fail(GTK_IS_WIDGET(plugin), 0);
+
+    if (wakeups_quark == 0)
+        return 0;
+    return GPOINTER_TO_UINT(g_object_get_qdata(G_OBJECT(plugin), wakeups_quark));
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 LxDE Developers, see the file AUTHORS for details.
+ *
+ * This file is a part of LXPanel project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __TICKER_H__
+#define __TICKER_H__ 1
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/**
+ * LXPANEL_TICK_SLOT:
+ *
+ * Granularity of intervals of periodic updates, in milliseconds. All
+ * intervals are rounded up to a multiple of it.
+ */
+#define LXPANEL_TICK_SLOT 250
+
+/**
+ * lxpanel_tick_add
+ * @plugin: (allow-none): plugin which needs updates
+ * @interval: interval between updates, in milliseconds
+ * @func: function to call for each update
+ * @user_data: data to pass to @func
+ *
+ * Adds periodic update to the scheduler shared by all plugins. There is
+ * only one timer for all updates, it is armed for the earliest update
+ * which is due. Updates with intervals of whole seconds are due on whole
+ * seconds and other ones on multiples of %LXPANEL_TICK_SLOT, so updates
+ * which are due at the same time are done in the same wakeup. While all
+ * intervals are whole seconds the timer is added with
+ * g_timeout_add_seconds() so it is coalesced with timers of other
+ * processes too.
+ *
+ * The @interval is stretched while the panel of @plugin is hidden by
+ * autohide, and intervals of all updates are stretched while the screen
+ * is blanked. The @func is called until it returns %FALSE or until
+ * lxpanel_tick_remove() is called. Calls are counted for @plugin, see
+ * lxpanel_tick_get_wakeups().
+ *
+ * Returns: id of update.
+ *
+ * Since: 0.9.3
+ */
+extern guint lxpanel_tick_add(GtkWidget *plugin, guint interval,
+                              GSourceFunc func, gpointer user_data);
+
+/**
+ * lxpanel_tick_remove
+ * @id: id of update
+ *
+ * Removes the update added by lxpanel_tick_add(). It is safe to call this
+ * from the update callback.
+ *
+ * Since: 0.9.3
+ */
+extern void lxpanel_tick_remove(guint id);
+
+/**
+ * lxpanel_tick_get_wakeups
+ * @plugin: a plugin
+ *
+ * Retrieves how many times periodic updates of @plugin were called since
+ * the plugin was created.
+ *
+ * Returns: number of updates.
+ *
+ * Since: 0.9.3
+ */
+extern guint lxpanel_tick_get_wakeups(GtkWidget *plugin);
+
+G_END_DECLS
+
+#endif